@@ -2,27 +2,26 @@
 
 out vec4 FragColor;
 in vec2 TexCoord;
+in vec4 Color;
+flat in int Type;
 
 uniform sampler2D tex;
-uniform vec3 color;
-uniform float fmix;
-uniform int type;
 
 void main()
 {
-	switch (type)
+	switch (Type)
 	{
 		case 1:	// Only Colored (shape rendering)
-			FragColor = vec4(color.xyz, 1.0);
+			FragColor = Color;
 			break;
 
-		case 2:	// Texture and Color is mixed
-			FragColor = mix(texture(tex, TexCoord), vec4(color, 1.0), fmix);
+		case 2:	// Texture and Color is mixed (by the alpha)
+			FragColor = mix(texture(tex, TexCoord), vec4(Color.rgb, 1.0), Color.a);
 			break;
 
 		case 3:	// Textured with a color (text rendering)
 			vec4 sampled = vec4(1.0, 1.0, 1.0, texture(tex, TexCoord).r);
-    		FragColor = vec4(color, 1.0) * sampled;
+    		FragColor = Color * sampled;
 			break;
 
 		default: // Only Textured (texture drawing)
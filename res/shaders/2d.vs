@@ -2,15 +2,17 @@
 
 layout (location = 0) in vec2 aPos;
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aColor;
+layout (location = 3) in float aType;
 
 out vec2 TexCoord;
-uniform vec2 center;
-uniform vec2 size;
+out vec4 Color;
+flat out int Type;
 
 void main()
 {
-    float x = center.x + aPos.x * size.x;
-    float y = center.y + aPos.y * size.y;
-    gl_Position = vec4(x, y, 0.0, 1.0);
+    gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
-}
\ No newline at end of file
+	Color = aColor;
+	Type = int(aType + 0.5);
+}
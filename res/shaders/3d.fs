@@ -5,9 +5,25 @@ out vec4 FragColor;
 in vec2 TexCoord;
 
 uniform sampler2D tex;
+uniform float alpha;
+
+#ifdef INSTANCED
+flat in vec4 InstanceColor;
+
+#define color InstanceColor.rgb
+#define tmc InstanceColor.a
+#else
 uniform vec3 color;
 uniform float tmc;
+#endif
 
 void main() {
+#if defined(TEXTURED) && !defined(COLORED)
+    FragColor = texture(tex, TexCoord);
+#elif defined(COLORED) && !defined(TEXTURED)
+    FragColor = vec4(color.xyz, 1.0);
+#else
     FragColor = mix(texture(tex, TexCoord), vec4(color.xyz, 1.0), tmc);
+#endif
+    FragColor.a *= alpha;
 }
\ No newline at end of file
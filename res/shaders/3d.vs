@@ -10,12 +10,28 @@ layout(location = 2) in vec3 aNormal;
 
 out vec2 TexCoord;
 
+#ifdef INSTANCED
+layout(location = 3) in mat4 aModel; // locations 3 - 6
+layout(location = 7) in vec4 aColor; // color.rgb, tmc
+
+flat out vec4 InstanceColor;
+#else
 uniform mat4 model;
+#endif
+
 uniform mat4 view;
 uniform mat4 projection;
 
+// The same depth as the depth pre-pass (see depth.vs)
+invariant gl_Position;
+
 void main() {
     TexCoord = aTexCoord;
 
+#ifdef INSTANCED
+    InstanceColor = aColor;
+    gl_Position = projection * view * aModel * vec4(aPos.xyz, 1.0);
+#else
     gl_Position = projection * view * model * vec4(aPos.xyz, 1.0);
+#endif
 }
\ No newline at end of file
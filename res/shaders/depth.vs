@@ -0,0 +1,23 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+
+#ifdef INSTANCED
+layout(location = 3) in mat4 aModel; // locations 3 - 6
+#else
+uniform mat4 model;
+#endif
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// The same depth as the color pass (see 3d.vs)
+invariant gl_Position;
+
+void main() {
+#ifdef INSTANCED
+    gl_Position = projection * view * aModel * vec4(aPos.xyz, 1.0);
+#else
+    gl_Position = projection * view * model * vec4(aPos.xyz, 1.0);
+#endif
+}
\ No newline at end of file
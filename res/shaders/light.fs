@@ -1,6 +1,7 @@
 #version 330 core
 
 #define MAX_LIGHTS 8
+#define MAX_CASCADES 4
 
 struct Material
 {
@@ -18,29 +19,25 @@ struct Material
 	float shininess;
 };
 
+// Packed into vec4s (std140), see Light::setup()
 struct Light
 {
-	int type; // -1 - disable, 0 - Directional, 1 - Point, 2 - Spot
+	vec4 position;	// xyz: point, spot; w: type (-1 - disable, 0 - Directional, 1 - Point, 2 - Spot)
+	vec4 direction;	// xyz: dir, spot; w: cutOff (spot)
 
-	vec3 position;	// point, spot
-	vec3 direction;	// dir, spot
+	vec4 ambient;	// rgb: dir, point, spot; w: outerCutOff (spot)
+    vec4 diffuse;	// rgb: dir, point, spot; w: strength
+    vec4 specular;	// rgb: dir, point, spot; w: shadow range (point, spot)
 
-	vec3 ambient;	// dir, point, spot
-    vec3 diffuse;	// dir, point, spot
-    vec3 specular;	// dir, point, spot
-
-	float constant;		// point, spot
-	float linear;		// point, spot
-	float quadratic;	// point, spot
-
-	float cutOff;		// spot
-    float outerCutOff;	// spot
+	vec4 attenuation;	// constant, linear, quadratic (point, spot); w: shadow layer (-1 - no shadow)
 };
 
 // function prototypes
 vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
+float CalcShadow(Light light, vec3 fragPos);
+float CalcCascadeShadow(Light light, vec3 normal, vec3 fragPos);
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -49,9 +46,74 @@ in vec2 TexCoord;
 out vec4 FragColor;
 
 uniform vec3 viewPos;
-uniform Light light[MAX_LIGHTS];
 uniform Material mtl;
 
+// The shadow cubes of the point & spot lights (6 layers each), see Shadows
+uniform sampler2DArray shadowAtlas;
+
+// The cube's faces (+X, -X, +Y, -Y, +Z, -Z): forward & up, same as in shadows.h
+const vec3 faceForward[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 faceUp[6] = vec3[](vec3(0, -1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, -1, 0));
+
+// The cascaded shadows of the directional lights, see Shadows::sun() (the block is uploaded with the maps)
+uniform sampler2DArrayShadow cascadeMap;
+
+layout (std140) uniform Cascades
+{
+	mat4 cascadeMatrices[MAX_CASCADES];
+	float cascadeSplits[MAX_CASCADES]; // the cascades' far
+	int cascadeCount;				   // cascades in use (0 - no cascades)
+};
+
+uniform mat4 view;
+
+#ifdef CLUSTERED
+// Clustered shading: the lights (6 texels each) & the lights of every cluster, see Light::cluster()
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;	   // {offset, count} per cluster
+uniform usamplerBuffer clusterIndices; // light indices
+
+uniform vec3 clusterDims;  // clusters per axis
+uniform vec2 clusterRange; // near, far
+uniform vec2 screenSize;
+
+Light fetchLight(int i)
+{
+	Light l;
+	l.position = texelFetch(lightData, i * 6 + 0);
+	l.direction = texelFetch(lightData, i * 6 + 1);
+	l.ambient = texelFetch(lightData, i * 6 + 2);
+	l.diffuse = texelFetch(lightData, i * 6 + 3);
+	l.specular = texelFetch(lightData, i * 6 + 4);
+	l.attenuation = texelFetch(lightData, i * 6 + 5);
+	return l;
+}
+#else
+layout (std140) uniform Lights
+{
+	int lightCount; // lights in use (<= MAX_LIGHTS)
+	Light light[MAX_LIGHTS];
+};
+#endif
+
+vec3 CalcLight(Light l, vec3 normal, vec3 viewDir)
+{
+	switch (int(l.position.w))
+	{
+	case 0: // Directional
+		return CalcDirLight(l, normal, viewDir);
+
+	case 1: // Point
+		return CalcPointLight(l, normal, FragPos, viewDir);
+
+	case 2: // Spot
+		return CalcSpotLight(l, normal, FragPos, viewDir);
+
+	default:
+		return vec3(0.0);
+	}
+}
+
 void main()
 {
 	// properties
@@ -63,26 +125,20 @@ void main()
 	if (mtl.lit)
 	{
 		vec3 result = vec3(0.0, 0.0, 0.0);
-		for (int i = 0; i < MAX_LIGHTS; i++)
-		{
-			switch (light[i].type)
-			{
-			case 0: // Directional
-				result += CalcDirLight(light[i], norm, viewDir);
-				break;
-
-			case 1: // Point
-				result += CalcPointLight(light[i], norm, FragPos, viewDir);
-				break;
-
-			case 2: // Spot
-				result += CalcSpotLight(light[i], norm, FragPos, viewDir);
-				break;
-
-			default:
-				break;
-			}
-		}
+#ifdef CLUSTERED
+		// Find the fragment's cluster
+		float depth = -(view * vec4(FragPos, 1.0)).z;
+		ivec3 cell = ivec3(gl_FragCoord.xy / screenSize * clusterDims.xy,
+						   log(max(depth, clusterRange.x) / clusterRange.x) / log(clusterRange.y / clusterRange.x) * clusterDims.z);
+		cell = clamp(cell, ivec3(0), ivec3(clusterDims) - 1);
+
+		uvec2 cluster = texelFetch(clusterGrid, (cell.z * int(clusterDims.y) + cell.y) * int(clusterDims.x) + cell.x).rg;
+		for (uint k = 0u; k < cluster.y; k++)
+			result += CalcLight(fetchLight(int(texelFetch(clusterIndices, int(cluster.x + k)).r)), norm, viewDir);
+#else
+		for (int i = 0; i < lightCount; i++)
+			result += CalcLight(light[i], norm, viewDir);
+#endif
 
 		FragColor = vec4(result, mtl.d);
 	}
@@ -90,7 +146,7 @@ void main()
 
 vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir)
 {
-	vec3 lightDir = normalize(-light.direction);
+	vec3 lightDir = normalize(-light.direction.xyz);
 
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -100,16 +156,21 @@ vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir)
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), mtl.shininess);
 
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(mtl.diffuse, TexCoord));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(mtl.diffuse, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(mtl.specular, TexCoord));
+    vec3 ambient = light.ambient.rgb * vec3(texture(mtl.diffuse, TexCoord));
+    vec3 diffuse = light.diffuse.rgb * light.diffuse.w * diff * vec3(texture(mtl.diffuse, TexCoord));
+    vec3 specular = light.specular.rgb * light.diffuse.w * spec * vec3(texture(mtl.specular, TexCoord));
+
+	// shadow
+	float shadow = CalcCascadeShadow(light, normal, FragPos);
+	diffuse *= 1.0 - shadow;
+	specular *= 1.0 - shadow;
 
     return (ambient + diffuse + specular);
 }
 
 vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-	vec3 lightDir = normalize(light.position - fragPos);
+	vec3 lightDir = normalize(light.position.xyz - fragPos);
 
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -119,24 +180,29 @@ vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), mtl.shininess);
 
     // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));    
     
 	// combine results
-    vec3 ambient = light.ambient * vec3(texture(mtl.diffuse, TexCoord));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(mtl.diffuse, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(mtl.specular, TexCoord));
+    vec3 ambient = light.ambient.rgb * vec3(texture(mtl.diffuse, TexCoord));
+    vec3 diffuse = light.diffuse.rgb * light.diffuse.w * diff * vec3(texture(mtl.diffuse, TexCoord));
+    vec3 specular = light.specular.rgb * light.diffuse.w * spec * vec3(texture(mtl.specular, TexCoord));
     
 	ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
+
+	// shadow
+	float shadow = CalcShadow(light, fragPos);
+	diffuse *= 1.0 - shadow;
+	specular *= 1.0 - shadow;
     
 	return (ambient + diffuse + specular);
 }
 
 vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-	vec3 lightDir = normalize(light.position - fragPos);
+	vec3 lightDir = normalize(light.position.xyz - fragPos);
     
 	// diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -146,22 +212,89 @@ vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), mtl.shininess);
     
 	// attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));    
     
 	// spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction)); 
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    float theta = dot(lightDir, normalize(-light.direction.xyz)); 
+    float epsilon = light.direction.w - light.ambient.w;
+    float intensity = clamp((theta - light.ambient.w) / epsilon, 0.0, 1.0);
     
 	// combine results
-    vec3 ambient = light.ambient * vec3(texture(mtl.diffuse, TexCoord));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(mtl.diffuse, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(mtl.specular, TexCoord));
+    vec3 ambient = light.ambient.rgb * vec3(texture(mtl.diffuse, TexCoord));
+    vec3 diffuse = light.diffuse.rgb * light.diffuse.w * diff * vec3(texture(mtl.diffuse, TexCoord));
+    vec3 specular = light.specular.rgb * light.diffuse.w * spec * vec3(texture(mtl.specular, TexCoord));
     
 	ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
+
+	// shadow
+	float shadow = CalcShadow(light, fragPos);
+	diffuse *= 1.0 - shadow;
+	specular *= 1.0 - shadow;
     
 	return (ambient + diffuse + specular);
 }
+
+float CalcShadow(Light light, vec3 fragPos)
+{
+	vec3 fragToLight = fragPos - light.position.xyz;
+	float distance = length(fragToLight);
+
+	if (light.attenuation.w < 0.0 || distance >= light.specular.w)
+		return 0.0;
+
+	// select the cube's face (the major axis)
+	vec3 a = abs(fragToLight);
+	int face;
+	if (a.x >= a.y && a.x >= a.z)
+		face = fragToLight.x > 0.0 ? 0 : 1;
+	else if (a.y >= a.z)
+		face = fragToLight.y > 0.0 ? 2 : 3;
+	else
+		face = fragToLight.z > 0.0 ? 4 : 5;
+
+	// project onto the face (90 degree perspective)
+	vec3 f = faceForward[face];
+	vec3 s = normalize(cross(f, faceUp[face]));
+	vec3 u = cross(s, f);
+	vec2 uv = vec2(dot(fragToLight, s), dot(fragToLight, u)) / dot(fragToLight, f) * 0.5 + 0.5;
+
+	// the depth is the distance from the light, divided by the range (see shadow_depth.fs)
+	float closestDepth = texture(shadowAtlas, vec3(uv, light.attenuation.w + float(face))).r * light.specular.w;
+
+	float bias = 0.15;
+	return distance - bias > closestDepth ? 1.0 : 0.0;
+}
+
+float CalcCascadeShadow(Light light, vec3 normal, vec3 fragPos)
+{
+	if (light.attenuation.w < 0.0 || cascadeCount == 0)
+		return 0.0;
+
+	// select the cascade by the view depth
+	float depth = -(view * vec4(fragPos, 1.0)).z;
+	if (depth > cascadeSplits[cascadeCount - 1])
+		return 0.0;
+
+	int c = 0;
+	while (c < cascadeCount - 1 && depth > cascadeSplits[c])
+		c++;
+
+	vec3 coord = (cascadeMatrices[c] * vec4(fragPos, 1.0)).xyz * 0.5 + 0.5;
+
+	// slope scaled bias
+	float bias = max(0.002 * (1.0 - dot(normal, normalize(-light.direction.xyz))), 0.0005);
+
+	// 4 taps (each one is filtered 2x2 by the sampler)
+	vec2 texel = 1.0 / vec2(textureSize(cascadeMap, 0).xy);
+	float lit = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 offset = vec2(i % 2 == 0 ? -0.5 : 0.5, i < 2 ? -0.5 : 0.5) * texel;
+		lit += texture(cascadeMap, vec4(coord.xy + offset, float(c), coord.z - bias));
+	}
+
+	return 1.0 - lit / 4.0;
+}
\ No newline at end of file
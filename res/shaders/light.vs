@@ -14,11 +14,14 @@ uniform mat4 projection;
 
 uniform float scale;
 
+// The same depth as the depth pre-pass with a scale of 1 (see depth.vs)
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos * scale, 1.0));
     TexCoord = aTexCoord;
     Normal = mat3(transpose(inverse(model))) * aNormal;  
     
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = projection * view * model * vec4(aPos * scale, 1.0);
 }
\ No newline at end of file
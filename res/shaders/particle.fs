@@ -0,0 +1,14 @@
+#version 330 core
+
+out vec4 FragColor;
+in vec2 TexCoord;
+in vec4 Color;
+
+uniform sampler2D tex;
+uniform bool textured;
+
+void main() {
+    // Without a texture the particles are round & soft
+    vec4 sampled = textured ? texture(tex, TexCoord) : vec4(1.0, 1.0, 1.0, 1.0 - smoothstep(0.25, 0.5, length(TexCoord - 0.5)));
+    FragColor = sampled * Color;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+
+layout(location = 0) in vec2 aCorner; // the quad's corner (-0.5 - 0.5)
+layout(location = 1) in float aX;     // per particle (see Particles::allocate())
+layout(location = 2) in float aY;
+layout(location = 3) in float aZ;
+layout(location = 4) in float aSize;
+layout(location = 5) in vec4 aColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoord;
+out vec4 Color;
+
+void main() {
+    // The billboard faces the camera (the corner is moved in view-space)
+    vec4 center = view * vec4(aX, aY, aZ, 1.0);
+    gl_Position = projection * (center + vec4(aCorner * aSize, 0.0, 0.0));
+
+    TexCoord = aCorner + 0.5;
+    Color = aColor;
+}
\ No newline at end of file
@@ -17,6 +17,9 @@ uniform mat4 model;
 
 uniform bool reverse_normals;
 
+// The same depth as the depth pre-pass (see depth.vs)
+invariant gl_Position;
+
 void main()
 {
     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 cascadeMatrix; // the cascade's view-projection (see Shadows::fit())
+
+void main()
+{
+    gl_Position = cascadeMatrix * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
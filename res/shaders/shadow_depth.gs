@@ -3,6 +3,8 @@ layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
 uniform mat4 shadowMatrices[6];
+uniform int faceMask; // the faces to draw into (bit i is face i)
+uniform int layer;    // the cube's first layer in the atlas
 
 out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
@@ -10,7 +12,10 @@ void main()
 {
     for(int face = 0; face < 6; ++face)
     {
-        gl_Layer = face; // built-in variable that specifies to which face we render.
+        if ((faceMask & (1 << face)) == 0)
+            continue;
+
+        gl_Layer = layer + face; // built-in variable that specifies to which face we render.
         for(int i = 0; i < 3; ++i) // for each triangle's vertices
         {
             FragPos = gl_in[i].gl_Position;
@@ -1,9 +1,30 @@
 #version 330 core
+#ifdef LAYERED
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
 
+#ifdef LAYERED
+// Every instance is one face of the cube (see Shadows::render())
+uniform mat4 shadowMatrices[6];
+uniform int faces[6]; // the faces to draw into
+uniform int layer;    // the cube's first layer in the atlas
+
+out vec4 FragPos;
+#endif
+
 void main()
 {
+#ifdef LAYERED
+    int face = faces[gl_InstanceID];
+
+    FragPos = model * vec4(aPos, 1.0);
+    gl_Position = shadowMatrices[face] * FragPos;
+    gl_Layer = layer + face;
+#else
     gl_Position = model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+#endif
+}
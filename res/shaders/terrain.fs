@@ -0,0 +1,33 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec3 Position;
+in vec2 TexCoord;
+
+uniform sampler2D heights;
+uniform vec2 samples;
+uniform vec2 spacing;
+
+uniform sampler2D tex;
+uniform bool textured;
+uniform float tiling;
+uniform vec3 color;
+uniform vec3 light;
+
+float height(vec2 s) {
+    return texture(heights, (s + 0.5) / samples).r;
+}
+
+void main() {
+    // The normal of the heightfield (central differences, the same at every level)
+    vec2 s = TexCoord * (samples - 1.0);
+    float dx = height(s + vec2(1.0, 0.0)) - height(s - vec2(1.0, 0.0));
+    float dz = height(s + vec2(0.0, 1.0)) - height(s - vec2(0.0, 1.0));
+    vec3 normal = normalize(vec3(-dx / (2.0 * spacing.x), 1.0, -dz / (2.0 * spacing.y)));
+
+    float diffuse = 0.25 + 0.75 * max(dot(normal, normalize(light)), 0.0);
+    vec3 albedo = textured ? texture(tex, TexCoord * tiling).rgb * color : color;
+
+    FragColor = vec4(albedo * diffuse, 1.0);
+}
\ No newline at end of file
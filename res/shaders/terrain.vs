@@ -0,0 +1,36 @@
+#version 330 core
+
+layout(location = 0) in vec2 aGrid; // the vertex in the patch (0 - cells)
+layout(location = 1) in vec4 aNode; // per node: first sample (x, z), size (in samples) & level
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 camera;
+
+uniform sampler2D heights; // in world-space, one texel per sample
+uniform vec2 samples;      // the heightmap's size
+uniform vec3 origin;       // the terrain's minimum corner
+uniform vec2 spacing;      // the distance of the samples (in world-space)
+uniform float cells;       // quads per patch side
+uniform vec2 morph[16];    // the start & the end of the levels' morphing (the distance from the camera)
+
+out vec3 Position;
+out vec2 TexCoord;
+
+// The position of a sample (clamped to the heightmap)
+vec3 ground(vec2 grid) {
+    vec2 s = min(aNode.xy + grid * (aNode.z / cells), samples - 1.0);
+    float height = texture(heights, (s + 0.5) / samples).r;
+    return vec3(origin.x + s.x * spacing.x, height, origin.z + s.y * spacing.y);
+}
+
+void main() {
+    // Morph the odd vertices onto the next level's grid near the end of the level's range
+    vec2 m = morph[int(aNode.w)];
+    float k = clamp((distance(ground(aGrid), camera) - m.x) / (m.y - m.x), 0.0, 1.0);
+
+    Position = ground(aGrid - fract(aGrid * 0.5) * 2.0 * k);
+    TexCoord = (Position.xz - origin.xz) / (spacing * (samples - 1.0));
+
+    gl_Position = projection * view * vec4(Position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,823 @@
+// Skeletal Animation for the Game Engine
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <SDL2/SDL.h>
+
+#include <tools/types.h>
+#include <tools/debug.h>
+
+#include <engine/object.h>
+#include <engine/workers.h>
+
+// The steps of the quantized keys (16 bit times & values)
+#define ANIM_STEPS 65535.0f
+
+/**
+ * @brief A compressed track (one joint's translation, rotation or scale)
+ */
+struct __clip_track_t
+{
+    uint first = 0, count = 0; // the keys in the clip's arrays
+    float min[4] = {0};        // the dequantization: min + key * step
+    float step[4] = {0};
+};
+
+/**
+ * @brief A compressed animation (see animation::compress())
+ * @details The tracks keep only the keys that can't be interpolated from their neighbours,
+ * the times & the values are quantized to 16 bits (the values to their track's range)
+ */
+struct clip
+{
+    std::string name;
+    float duration = 0.0f; // in seconds
+    bool loop = true;      // repeats? (or holds the last pose)
+
+    std::vector<__clip_track_t> tracks; // translation, rotation & scale per joint
+    std::vector<uint16_t> times;        // per key (0 - the start, ANIM_STEPS - the end)
+    std::vector<uint16_t> values;       // 4 per key
+};
+
+/**
+ * @brief The local pose of a skeleton (relative to the parents)
+ * @details 12 floats per joint: translation {x, y, z, 0}, rotation {x, y, z, w} & scale {x, y, z, 0}, so every part is one SIMD register
+ */
+struct pose
+{
+    std::vector<float> joints;
+};
+
+/**
+ * @brief Animation helpers (compression, sampling, blending & skinning)
+ */
+namespace animation
+{
+#if defined(__SSE2__)
+    /**
+     * @brief The dot product of two 4D vectors (in every lane)
+     */
+    inline __m128 dot4(__m128 a, __m128 b)
+    {
+        __m128 d = _mm_mul_ps(a, b);
+        d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    /**
+     * @brief Normalize a 4D vector (a quaternion or a normal with w = 0)
+     */
+    inline __m128 normalize4(__m128 v)
+    {
+        __m128 d = dot4(v, v);
+        __m128 valid = _mm_cmpgt_ps(d, _mm_set1_ps(1e-12f));
+        return _mm_and_ps(_mm_div_ps(v, _mm_sqrt_ps(d)), valid);
+    }
+
+    /**
+     * @brief Dequantize a key
+     *
+     * @param key The key's 4 values
+     * @param t The key's track
+     */
+    inline __m128 dequantize(const uint16_t *key, const __clip_track_t &t)
+    {
+        __m128i q = _mm_loadl_epi64((const __m128i *)key);
+        q = _mm_unpacklo_epi16(q, _mm_setzero_si128());
+        return _mm_add_ps(_mm_loadu_ps(t.min), _mm_mul_ps(_mm_cvtepi32_ps(q), _mm_loadu_ps(t.step)));
+    }
+#endif
+
+    /**
+     * @brief Multiply two matrices (a * b, out can't be b)
+     *
+     * @param a The first matrix
+     * @param b The second matrix
+     * @param out The result
+     */
+    inline void multiply(const mat4 &a, const mat4 &b, mat4 &out)
+    {
+#if defined(__SSE2__)
+        __m128 b0 = _mm_loadu_ps(b.m[0]), b1 = _mm_loadu_ps(b.m[1]);
+        __m128 b2 = _mm_loadu_ps(b.m[2]), b3 = _mm_loadu_ps(b.m[3]);
+
+        for (int r = 0; r < 4; r++)
+        {
+            __m128 row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m[r][0]), b0), _mm_mul_ps(_mm_set1_ps(a.m[r][1]), b1)),
+                                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m[r][2]), b2), _mm_mul_ps(_mm_set1_ps(a.m[r][3]), b3)));
+            _mm_storeu_ps(out.m[r], row);
+        }
+#else
+        mat4 left = a;
+        out = left * b;
+#endif
+    }
+
+    /**
+     * @brief Get the rest pose of a skeleton
+     *
+     * @param rig The skeleton
+     * @param out The pose
+     */
+    void rest(const skeleton &rig, pose &out)
+    {
+        out.joints.assign(rig.joints.size() * 12, 0.0f);
+
+        for (size_t i = 0; i < rig.joints.size(); i++)
+        {
+            const joint &j = rig.joints[i];
+            float *o = &out.joints[i * 12];
+
+            o[0] = j.position.x;
+            o[1] = j.position.y;
+            o[2] = j.position.z;
+
+            o[4] = j.rotation.x;
+            o[5] = j.rotation.y;
+            o[6] = j.rotation.z;
+            o[7] = j.rotation.w;
+
+            o[8] = o[9] = o[10] = 1.0f;
+        }
+    }
+
+    /**
+     * @brief Compress an animation (key reduction & quantization)
+     *
+     * @param k The animation's keys (see loadin::anim())
+     * @param rig The animated skeleton (joints without keys keep their rest pose)
+     * @param tolerance The largest error of a removed key (in units, quaternion units for the rotations)
+     * @return The clip
+     */
+    clip compress(const keyframes &k, const skeleton &rig, float tolerance = 0.0005f)
+    {
+        clip out;
+        out.name = k.name;
+        out.duration = k.duration;
+
+        const std::vector<float> none;
+
+        for (size_t j = 0; j < rig.joints.size(); j++)
+        {
+            const joint &rj = rig.joints[j];
+            const std::vector<float> &keys = j < k.keys.size() ? k.keys[j] : none;
+            size_t n = keys.size() / 11;
+
+            for (int part = 0; part < 3; part++)
+            {
+                int width = part == 1 ? 4 : 3;
+                int offset = part == 0 ? 1 : (part == 1 ? 4 : 8);
+
+                // The part's keys ({x, y, z, w} per key)
+                std::vector<float> times, values;
+                for (size_t i = 0; i < n; i++)
+                {
+                    times.push_back(keys[i * 11]);
+                    for (int c = 0; c < 4; c++)
+                        values.push_back(c < width ? keys[i * 11 + offset + c] : 0.0f);
+                }
+
+                if (n == 0)
+                {
+                    float rest[3][4] = {{rj.position.x, rj.position.y, rj.position.z, 0.0f},
+                                        {rj.rotation.x, rj.rotation.y, rj.rotation.z, rj.rotation.w},
+                                        {1.0f, 1.0f, 1.0f, 0.0f}};
+                    times.push_back(0.0f);
+                    values.insert(values.end(), rest[part], rest[part] + 4);
+                }
+
+                // Rotations: unit length & in the previous key's hemisphere (so the interpolation takes the short way)
+                if (part == 1)
+                {
+                    for (size_t i = 0; i < times.size(); i++)
+                    {
+                        float *q = &values[i * 4];
+                        float len = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+                        float dot = i > 0 ? q[0] * q[-4] + q[1] * q[-3] + q[2] * q[-2] + q[3] * q[-1] : 1.0f;
+                        float scale = (len > 0.0f ? 1.0f / len : 0.0f) * (dot < 0.0f ? -1.0f : 1.0f);
+
+                        for (int c = 0; c < 4; c++)
+                            q[c] *= scale;
+                    }
+                }
+
+                // Key Reduction (a key is removed, if it's neighbours' interpolation is close enough to every skipped key)
+                std::vector<size_t> kept = {0};
+                for (size_t i = 1; i + 1 < times.size(); i++)
+                {
+                    size_t a = kept.back(), b = i + 1;
+                    bool needed = false;
+
+                    for (size_t m = a + 1; m < b && !needed; m++)
+                    {
+                        float f = (times[m] - times[a]) / fmaxf(times[b] - times[a], 1e-6f);
+
+                        float l[4], len = 0.0f;
+                        for (int c = 0; c < 4; c++)
+                        {
+                            l[c] = values[a * 4 + c] + (values[b * 4 + c] - values[a * 4 + c]) * f;
+                            len += l[c] * l[c];
+                        }
+
+                        for (int c = 0; c < 4; c++)
+                        {
+                            float v = part == 1 && len > 0.0f ? l[c] / sqrtf(len) : l[c];
+                            if (fabsf(v - values[m * 4 + c]) > tolerance)
+                                needed = true;
+                        }
+                    }
+
+                    if (needed)
+                        kept.push_back(i);
+                }
+                if (times.size() > 1)
+                    kept.push_back(times.size() - 1);
+
+                // A constant track needs one key
+                if (kept.size() == 2)
+                {
+                    bool constant = true;
+                    for (int c = 0; c < 4; c++)
+                        if (fabsf(values[kept[0] * 4 + c] - values[kept[1] * 4 + c]) > tolerance)
+                            constant = false;
+                    if (constant)
+                        kept.pop_back();
+                }
+
+                // Quantization (to the track's range)
+                __clip_track_t t;
+                t.first = (uint)out.times.size();
+                t.count = (uint)kept.size();
+
+                float lo[4], hi[4];
+                for (int c = 0; c < 4; c++)
+                {
+                    lo[c] = hi[c] = values[kept[0] * 4 + c];
+                    for (size_t i : kept)
+                    {
+                        lo[c] = fminf(lo[c], values[i * 4 + c]);
+                        hi[c] = fmaxf(hi[c], values[i * 4 + c]);
+                    }
+
+                    t.min[c] = lo[c];
+                    t.step[c] = (hi[c] - lo[c]) / ANIM_STEPS;
+                }
+
+                for (size_t i : kept)
+                {
+                    float time = out.duration > 0.0f ? fminf(fmaxf(times[i] / out.duration, 0.0f), 1.0f) : 0.0f;
+                    out.times.push_back((uint16_t)lrintf(time * ANIM_STEPS));
+
+                    for (int c = 0; c < 4; c++)
+                        out.values.push_back(t.step[c] > 0.0f ? (uint16_t)lrintf((values[i * 4 + c] - lo[c]) / t.step[c]) : 0);
+                }
+
+                out.tracks.push_back(t);
+            }
+        }
+
+        return out;
+    }
+
+    /**
+     * @brief Sample a clip
+     *
+     * @param c The clip
+     * @param time The time (in seconds, wraps around with looping clips)
+     * @param out The pose
+     * @param cursors The tracks' last keys (kept between the calls, the search continues from them)
+     */
+    void sample(const clip &c, float time, pose &out, std::vector<uint> &cursors)
+    {
+        out.joints.resize(c.tracks.size() / 3 * 12);
+        cursors.resize(c.tracks.size(), 0);
+
+        // The time in the keys' steps
+        if (c.duration > 0.0f)
+        {
+            if (c.loop)
+            {
+                time = fmodf(time, c.duration);
+                if (time < 0.0f)
+                    time += c.duration;
+            }
+            time = fminf(fmaxf(time / c.duration, 0.0f), 1.0f) * ANIM_STEPS;
+        }
+        else
+            time = 0.0f;
+
+        for (size_t i = 0; i < c.tracks.size(); i++)
+        {
+            const __clip_track_t &t = c.tracks[i];
+            const uint16_t *times = &c.times[t.first];
+            float *dst = &out.joints[(i / 3) * 12 + (i % 3) * 4];
+
+            // The keys around the time (playback usually moves forwards, so it's found in a few steps)
+            uint k = cursors[i] < t.count && times[cursors[i]] <= time ? cursors[i] : 0;
+            while (k + 1 < t.count && times[k + 1] <= time)
+                k++;
+            cursors[i] = k;
+
+            const uint16_t *a = &c.values[(size_t)(t.first + k) * 4];
+            const uint16_t *b = k + 1 < t.count ? a + 4 : a;
+
+            float f = 0.0f;
+            if (k + 1 < t.count)
+                f = fminf(fmaxf((time - times[k]) / (float)std::max(times[k + 1] - times[k], 1), 0.0f), 1.0f);
+
+#if defined(__SSE2__)
+            __m128 va = dequantize(a, t), vb = dequantize(b, t);
+            __m128 v = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_set1_ps(f)));
+
+            if (i % 3 == 1)
+                v = normalize4(v);
+            _mm_storeu_ps(dst, v);
+#else
+            float len = 0.0f;
+            for (int n = 0; n < 4; n++)
+            {
+                float va = t.min[n] + a[n] * t.step[n];
+                float vb = t.min[n] + b[n] * t.step[n];
+                dst[n] = va + (vb - va) * f;
+                len += dst[n] * dst[n];
+            }
+
+            if (i % 3 == 1 && len > 0.0f)
+                for (int n = 0; n < 4; n++)
+                    dst[n] /= sqrtf(len);
+#endif
+        }
+    }
+
+    /**
+     * @brief Blend two poses (of the same skeleton)
+     *
+     * @param a The first pose
+     * @param b The second pose
+     * @param weight The second pose's weight (0 - a, 1 - b)
+     * @param out The blended pose (can be a or b)
+     */
+    void blend(const pose &a, const pose &b, float weight, pose &out)
+    {
+        size_t n = std::min(a.joints.size(), b.joints.size());
+        out.joints.resize(n);
+
+#if defined(__SSE2__)
+        __m128 w = _mm_set1_ps(weight);
+        __m128 sign = _mm_set1_ps(-0.0f);
+
+        for (size_t i = 0; i < n; i += 12)
+        {
+            const float *pa = &a.joints[i], *pb = &b.joints[i];
+            float *o = &out.joints[i];
+
+            __m128 ta = _mm_loadu_ps(pa), tb = _mm_loadu_ps(pb);
+            __m128 ra = _mm_loadu_ps(pa + 4), rb = _mm_loadu_ps(pb + 4);
+            __m128 sa = _mm_loadu_ps(pa + 8), sb = _mm_loadu_ps(pb + 8);
+
+            // The rotations take the short way (flipped, if they are in opposite hemispheres)
+            rb = _mm_xor_ps(rb, _mm_and_ps(dot4(ra, rb), sign));
+
+            _mm_storeu_ps(o, _mm_add_ps(ta, _mm_mul_ps(_mm_sub_ps(tb, ta), w)));
+            _mm_storeu_ps(o + 4, normalize4(_mm_add_ps(ra, _mm_mul_ps(_mm_sub_ps(rb, ra), w))));
+            _mm_storeu_ps(o + 8, _mm_add_ps(sa, _mm_mul_ps(_mm_sub_ps(sb, sa), w)));
+        }
+#else
+        for (size_t i = 0; i < n; i += 12)
+        {
+            const float *pa = &a.joints[i], *pb = &b.joints[i];
+            float *o = &out.joints[i];
+
+            float dot = pa[4] * pb[4] + pa[5] * pb[5] + pa[6] * pb[6] + pa[7] * pb[7];
+            float flip = dot < 0.0f ? -1.0f : 1.0f;
+
+            float len = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                o[c] = pa[c] + (pb[c] - pa[c]) * weight;
+                o[4 + c] = pa[4 + c] + (pb[4 + c] * flip - pa[4 + c]) * weight;
+                o[8 + c] = pa[8 + c] + (pb[8 + c] - pa[8 + c]) * weight;
+                len += o[4 + c] * o[4 + c];
+            }
+
+            for (int c = 0; c < 4 && len > 0.0f; c++)
+                o[4 + c] /= sqrtf(len);
+        }
+#endif
+    }
+
+    /**
+     * @brief Calculate the skinning matrices of a pose (rest pose's mesh space -> the posed mesh space)
+     *
+     * @param rig The skeleton
+     * @param p The pose
+     * @param models The joints' model matrices (output, kept between the calls to avoid allocations)
+     * @param out The skinning matrices
+     */
+    void palette(const skeleton &rig, const pose &p, std::vector<mat4> &models, std::vector<mat4> &out)
+    {
+        size_t n = std::min(rig.joints.size(), p.joints.size() / 12);
+        models.resize(n);
+        out.resize(n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const float *t = &p.joints[i * 12], *r = t + 4, *s = t + 8;
+
+            // Scale, rotate, then translate (relative to the parent)
+            mat4 local = matrix::rotate((quat){r[0], r[1], r[2], r[3]});
+            for (int c = 0; c < 3; c++)
+            {
+                local.m[0][c] *= s[0];
+                local.m[1][c] *= s[1];
+                local.m[2][c] *= s[2];
+                local.m[3][c] = t[c];
+            }
+
+            int parent = rig.joints[i].parent;
+            if (parent >= 0)
+                multiply(local, models[parent], models[i]);
+            else
+                models[i] = local;
+
+            multiply(rig.joints[i].inverse_bind, models[i], out[i]);
+        }
+    }
+
+    /**
+     * @brief Skin a mesh (linear blend skinning of the positions & normals)
+     *
+     * @param rig The skeleton (with the mesh's influences)
+     * @param palette The skinning matrices (see animation::palette())
+     * @param m The mesh (in the rest pose)
+     * @param out The interleaved vertices (8 floats per vertex, the positions & the normals are written)
+     * @param min The skinned mesh's bounds (output)
+     * @param max The skinned mesh's bounds (output)
+     */
+    void skin(const skeleton &rig, const std::vector<mat4> &palette, const mesh &m, float *out, vec3 &min, vec3 &max)
+    {
+        size_t n = std::min((size_t)m.tris * 3, rig.weights.size() / 4);
+        bool normals = m.normals.size() >= n * 3;
+
+        const unsigned char *joints = rig.influences.data();
+        const float *weights = rig.weights.data();
+
+        min = {0.0f, 0.0f, 0.0f};
+        max = {0.0f, 0.0f, 0.0f};
+        if (n == 0)
+            return;
+
+#if defined(__SSE2__)
+        __m128 lo = _mm_set1_ps(INFINITY), hi = _mm_set1_ps(-INFINITY);
+
+        for (size_t v = 0; v < n; v++)
+        {
+            // The weighted matrix of the vertex' joints
+            __m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps(), r2 = _mm_setzero_ps(), r3 = _mm_setzero_ps();
+            float sum = 0.0f;
+
+            for (int i = 0; i < 4; i++)
+            {
+                float w = weights[v * 4 + i];
+                uint j = joints[v * 4 + i];
+                if (w == 0.0f || j >= palette.size())
+                    continue;
+
+                const mat4 &p = palette[j];
+                __m128 vw = _mm_set1_ps(w);
+                r0 = _mm_add_ps(r0, _mm_mul_ps(vw, _mm_loadu_ps(p.m[0])));
+                r1 = _mm_add_ps(r1, _mm_mul_ps(vw, _mm_loadu_ps(p.m[1])));
+                r2 = _mm_add_ps(r2, _mm_mul_ps(vw, _mm_loadu_ps(p.m[2])));
+                r3 = _mm_add_ps(r3, _mm_mul_ps(vw, _mm_loadu_ps(p.m[3])));
+                sum += w;
+            }
+
+            // Vertices without influences stay in the rest pose
+            if (sum == 0.0f)
+            {
+                r0 = _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f);
+                r1 = _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f);
+                r2 = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+                r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+
+            const float *pos = &m.vertices[v * 3];
+            __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pos[0]), r0), _mm_mul_ps(_mm_set1_ps(pos[1]), r1)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pos[2]), r2), r3));
+
+            float result[4];
+            _mm_storeu_ps(result, p);
+            out[v * 8 + 0] = result[0];
+            out[v * 8 + 1] = result[1];
+            out[v * 8 + 2] = result[2];
+
+            lo = _mm_min_ps(lo, p);
+            hi = _mm_max_ps(hi, p);
+
+            if (normals)
+            {
+                const float *nor = &m.normals[v * 3];
+                __m128 nn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nor[0]), r0), _mm_mul_ps(_mm_set1_ps(nor[1]), r1)),
+                                       _mm_mul_ps(_mm_set1_ps(nor[2]), r2));
+
+                // (reciprocal square root & one Newton-Raphson step, much cheaper than a division)
+                __m128 d = _mm_max_ps(dot4(nn, nn), _mm_set1_ps(1e-12f));
+                __m128 inv = _mm_rsqrt_ps(d);
+                inv = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), inv), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(d, _mm_mul_ps(inv, inv))));
+
+                _mm_storeu_ps(result, _mm_mul_ps(nn, inv));
+                out[v * 8 + 5] = result[0];
+                out[v * 8 + 6] = result[1];
+                out[v * 8 + 7] = result[2];
+            }
+        }
+
+        float l[4], h[4];
+        _mm_storeu_ps(l, lo);
+        _mm_storeu_ps(h, hi);
+        min = {l[0], l[1], l[2]};
+        max = {h[0], h[1], h[2]};
+#else
+        for (size_t v = 0; v < n; v++)
+        {
+            // The weighted matrix of the vertex' joints
+            mat4 s;
+            float sum = 0.0f;
+
+            for (int i = 0; i < 4; i++)
+            {
+                float w = weights[v * 4 + i];
+                uint j = joints[v * 4 + i];
+                if (w == 0.0f || j >= palette.size())
+                    continue;
+
+                for (int r = 0; r < 4; r++)
+                    for (int c = 0; c < 4; c++)
+                        s.m[r][c] += w * palette[j].m[r][c];
+                sum += w;
+            }
+
+            // Vertices without influences stay in the rest pose
+            if (sum == 0.0f)
+                s = matrix::identity();
+
+            vec3 p = matrix::multiplyvec(s, {m.vertices[v * 3], m.vertices[v * 3 + 1], m.vertices[v * 3 + 2]});
+            out[v * 8 + 0] = p.x;
+            out[v * 8 + 1] = p.y;
+            out[v * 8 + 2] = p.z;
+
+            if (v == 0)
+            {
+                min = p;
+                max = p;
+            }
+            min = {fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z)};
+            max = {fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z)};
+
+            if (normals)
+            {
+                vec3 nor = {m.normals[v * 3], m.normals[v * 3 + 1], m.normals[v * 3 + 2], 0.0f};
+                nor = vector::normalize(matrix::multiplyvec(s, nor));
+                out[v * 8 + 5] = nor.x;
+                out[v * 8 + 6] = nor.y;
+                out[v * 8 + 7] = nor.z;
+            }
+        }
+#endif
+    }
+};
+
+/**
+ * @brief A clip playing on a skinned object (see Animator::play())
+ */
+struct __animation_layer_t
+{
+    const clip *c = NULL;      // NULL - the rest pose
+    float time = 0.0f;         // in seconds
+    std::vector<uint> cursors; // the tracks' last keys (see animation::sample())
+};
+
+/**
+ * @brief A skinned object's animation
+ */
+struct __animation_instance_t
+{
+    object *obj = NULL;
+    const skeleton *rig = NULL;
+
+    __animation_layer_t from, to; // crossfading from -> to
+    float fade = 0.0f;            // the crossfade's length (in seconds)
+    float faded = 0.0f;           // the time since the crossfade's start
+    float speed = 1.0f;
+
+    pose a, b;                 // the sampled poses (blended into a)
+    std::vector<mat4> models;  // the joints' model matrices
+    std::vector<mat4> palette; // the skinning matrices
+    float *vertices = NULL;    // the object's vertices (this frame)
+};
+
+/**
+ * @brief Animates & skins objects on the CPU (their skinned vertices are streamed every frame, see object::dynamic)
+ * @details Every object is sampled, blended & skinned by one worker, so the shadows, the depth pre-pass & the culling
+ * draw the skinned meshes like any other dynamic mesh. The skeletons & the clips aren't copied (keep them alive)
+ */
+class Animator
+{
+private:
+    std::vector<__animation_instance_t> instances;
+
+    __animation_instance_t *find(object *obj);
+    void animate(__animation_instance_t &in);
+
+public:
+    float time = 0.0f; // the last update's CPU time (in ms)
+
+    void add(object *obj, const skeleton &rig);
+    void remove(object *obj);
+    void play(object *obj, const clip &c, float fade = 0.0f, float speed = 1.0f);
+
+    uint size();
+    void update(float deltaTime, Workers &workers);
+};
+
+// Private Functions
+
+/**
+ * @brief Find an object's animation
+ *
+ * @param obj The object
+ * @return The animation (NULL if it isn't animated)
+ */
+__animation_instance_t *Animator::find(object *obj)
+{
+    for (auto &in : instances)
+        if (in.obj == obj)
+            return &in;
+    return NULL;
+}
+
+/**
+ * @brief Sample, blend & skin an object (safe from many threads, one object per thread)
+ *
+ * @param in The object's animation
+ */
+void Animator::animate(__animation_instance_t &in)
+{
+    if (in.vertices == NULL)
+        return;
+
+    // The current clip (crossfaded from the last one)
+    if (in.to.c != NULL)
+        animation::sample(*in.to.c, in.to.time, in.a, in.to.cursors);
+    else
+        animation::rest(*in.rig, in.a);
+
+    float weight = in.fade > 0.0f ? in.faded / in.fade : 1.0f;
+    if (weight < 1.0f)
+    {
+        if (in.from.c != NULL)
+            animation::sample(*in.from.c, in.from.time, in.b, in.from.cursors);
+        else
+            animation::rest(*in.rig, in.b);
+
+        animation::blend(in.b, in.a, weight, in.a);
+    }
+
+    animation::palette(*in.rig, in.a, in.models, in.palette);
+
+    vec3 min, max;
+    animation::skin(*in.rig, in.palette, in.obj->m, in.vertices, min, max);
+
+    // The skinned mesh's bounds (for the culling & the shadows)
+    mesh &m = in.obj->m;
+    m.min = min;
+    m.max = max;
+    m.center = vector::avg(min, max);
+    m.radius = vector::distance(max, m.center);
+
+    in.obj->dirty = true;
+}
+
+// Public Functions
+
+/**
+ * @brief Animate an object (it's mesh has to be the skeleton's mesh, it's streamed every frame after this)
+ *
+ * @param obj The object (drawable)
+ * @param rig The skeleton (see loadin::rig())
+ */
+void Animator::add(object *obj, const skeleton &rig)
+{
+    if (obj == NULL || find(obj) != NULL)
+        return;
+
+    if (obj->gpu.id == 0 || rig.weights.size() / 4 != obj->gpu.vertices)
+    {
+        debug::warning("Animator::add()", "the skeleton doesn't fit the object's mesh", obj->m.name.c_str());
+        return;
+    }
+
+    __animation_instance_t in;
+    in.obj = obj;
+    in.rig = &rig;
+    instances.push_back(in);
+
+    obj->dynamic = true;
+    obj->dirty = true;
+}
+
+/**
+ * @brief Stop animating an object (it keeps it's last pose)
+ *
+ * @param obj The object
+ */
+void Animator::remove(object *obj)
+{
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        if (instances[i].obj == obj)
+        {
+            instances.erase(instances.begin() + i);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Play a clip on an animated object
+ *
+ * @param obj The object (see add())
+ * @param c The clip (see animation::compress())
+ * @param fade The crossfade from the current clip (in seconds, 0 - switch at once)
+ * @param speed The playback's speed
+ */
+void Animator::play(object *obj, const clip &c, float fade, float speed)
+{
+    __animation_instance_t *in = find(obj);
+    if (in == NULL)
+    {
+        debug::warning("Animator::play()", "the object isn't animated", obj != NULL ? obj->m.name.c_str() : "");
+        return;
+    }
+
+    if (c.tracks.size() != in->rig->joints.size() * 3)
+    {
+        debug::warning("Animator::play()", "the clip doesn't fit the skeleton", c.name.c_str());
+        return;
+    }
+
+    in->from = in->to;
+    in->to.c = &c;
+    in->to.time = 0.0f;
+    in->to.cursors.assign(c.tracks.size(), 0);
+
+    in->fade = fade;
+    in->faded = 0.0f;
+    in->speed = speed;
+}
+
+/**
+ * @brief Get the number of animated objects
+ */
+uint Animator::size()
+{
+    return (uint)instances.size();
+}
+
+/**
+ * @brief Advance the clips & skin the animated objects (call once per frame, before the objects are streamed)
+ *
+ * @param deltaTime The time since the last update (in seconds)
+ * @param workers The threads (one object per job)
+ */
+void Animator::update(float deltaTime, Workers &workers)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // Advance the playback & get the objects' vertices (on this thread, writing may give an object it's own mesh)
+    for (auto &in : instances)
+    {
+        in.from.time += deltaTime * in.speed;
+        in.to.time += deltaTime * in.speed;
+        in.faded += deltaTime;
+
+        in.vertices = in.obj->write(0, in.obj->gpu.vertices);
+    }
+
+    workers.run(instances.size(), [&](size_t first, size_t last, uint worker)
+                {
+                    for (size_t i = first; i < last; i++)
+                        animate(instances[i]);
+                },
+                1);
+
+    time = (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+}
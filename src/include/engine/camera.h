@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
+
 #include <tools/shader.h>
 
 #include <engine/object.h>
+#include <engine/proxy.h>
 
 struct camera
 {
@@ -11,6 +14,12 @@ struct camera
     lua_State *L;
 
     gls s;
+    permutations variants;
+    uint textured_bit, colored_bit, instanced_bit; // feature bits of the variants
+
+    const permutations *depth = NULL; // draws only the depth with these, if set ("depth" with {"INSTANCED"}, see Engine::prepass)
+    bool invariant = false;           // the programs' gl_Position is the same as depth.vs' (else the camera skips the pre-pass)
+
     uint attrib_vertex, attrib_texcoord, attrib_normal;
     int *width, *height;
 
@@ -24,7 +33,12 @@ struct camera
     vec3 lookDir;
     vec3 front, up, right;
 
+    // The current frame's matrices (see begin())
+    mat4 viewmat, projmat;
+    std::vector<gls> bound; // programs that already got the matrices
+
     camera(int *w, int *h, gls shader);
+    camera(int *w, int *h, permutations shaders);
     void add(std::string luascript);
 
     void update();
@@ -34,7 +48,17 @@ struct camera
     mat4 projection(int w, int h);
     mat4 view();
 
-    void draw(object obj);
+    uint features(object &obj);
+    gls variant(uint features);
+
+    void begin();
+    gls prepare(uint features);
+    void attach(uint buffer, size_t offset);
+    void detach();
+
+    void draw(const proxy &p);
+    void draw(const proxy &p, uint instances, uint buffer, size_t offset);
+    void multidraw(const proxy &p, uint draws, uint buffer, uint commands, size_t offset);
 };
 
 /**
@@ -50,11 +74,32 @@ camera::camera(int *w, int *h, gls shader)
 
     this->s = shader;
 
+    this->variants.programs = {shader};
+    this->textured_bit = 0;
+    this->colored_bit = 0;
+    this->instanced_bit = 0;
+
     this->attrib_vertex = glGetAttribLocation(s, "aPos");
     this->attrib_texcoord = glGetAttribLocation(s, "aTexCoord");
     this->attrib_normal = glGetAttribLocation(s, "aNormal");
 }
 
+/**
+ * @brief Init The Camera with a shader's permutations
+ * @details The "TEXTURED" and "COLORED" feature keywords are selected per object, "INSTANCED" for instanced draws.
+ * The shader's gl_Position has to be invariant & computed like depth.vs' (see 3d.vs), else set invariant to false
+ *
+ * @param shaders The shader's permutations (see shader::permute())
+ */
+camera::camera(int *w, int *h, permutations shaders) : camera(w, h, shaders.programs[0])
+{
+    this->variants = shaders;
+    this->textured_bit = shader::bit(shaders, "TEXTURED");
+    this->colored_bit = shader::bit(shaders, "COLORED");
+    this->instanced_bit = shader::bit(shaders, "INSTANCED");
+    this->invariant = true;
+}
+
 void camera::add(std::string luascript)
 {
     this->script = true;
@@ -122,21 +167,174 @@ void camera::rotate(vec3 amount)
     this->rotation += amount;
 }
 
-void camera::draw(object obj)
+/**
+ * @brief Get the shader features of an object's material
+ *
+ * @param obj The object
+ * @return The feature mask
+ */
+uint camera::features(object &obj)
+{
+    uint mask = 0;
+    if (obj.textured && obj.tmc < 1.0f)
+        mask |= textured_bit;
+    if (!obj.textured || obj.tmc > 0.0f)
+        mask |= colored_bit;
+
+    return mask;
+}
+
+/**
+ * @brief Select the shader variant for a feature mask
+ *
+ * @param features The feature mask (see camera::features())
+ * @return The shader program
+ */
+gls camera::variant(uint features)
+{
+    if (depth != NULL)
+        return shader::select(*depth, (features & instanced_bit) ? 1 : 0);
+    return shader::select(variants, features);
+}
+
+/**
+ * @brief Start drawing a frame (calculates the view & projection matrices)
+ */
+void camera::begin()
+{
+    this->viewmat = matrix::lookAt(this->position, this->position + this->lookDir, this->up);
+    this->projmat = matrix::perspective(this->fov, (float)*width / (float)*height, this->near, this->far);
+    this->bound.clear();
+}
+
+/**
+ * @brief Select a shader variant for drawing (sets the matrices once per program & frame)
+ *
+ * @param features The feature mask (see camera::features())
+ * @return The shader program
+ */
+gls camera::prepare(uint features)
+{
+    gls program = variant(features);
+
+    glstate::enable(GL_DEPTH_TEST);
+    shader::use(program);
+
+    if (std::find(this->bound.begin(), this->bound.end(), program) == this->bound.end())
+    {
+        shader::set(program, "view", this->viewmat);
+        shader::set(program, "projection", this->projmat);
+        this->bound.push_back(program);
+    }
+
+    return program;
+}
+
+/**
+ * @brief Point the per-instance attributes of the bound vertex array at an instance buffer
+ * @details Instance data: {mat4 model, vec4 (color, tmc)} per instance
+ *
+ * @param buffer The instance buffer
+ * @param offset The first instance's offset in the buffer (in bytes)
+ */
+void camera::attach(uint buffer, size_t offset)
 {
-    shader::use(s);
+    int stride = sizeof(float) * 20;
+    glstate::bind_buffer(GL_ARRAY_BUFFER, buffer);
+    for (int i = 0; i < 5; i++)
+    {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, stride, (void *)(offset + i * 4 * sizeof(float)));
+        glVertexAttribDivisor(3 + i, 1);
+    }
+}
 
-    shader::set(s, "view", matrix::lookAt(this->position, this->position + this->lookDir, this->up));
-    shader::set(s, "projection", matrix::perspective(this->fov, (float)*width / (float)*height, this->near, this->far));
+/**
+ * @brief Disable the per-instance attributes of the bound vertex array (it's also used for normal draws)
+ */
+void camera::detach()
+{
+    for (int i = 0; i < 5; i++)
+        glDisableVertexAttribArray(3 + i);
+}
 
-    shader::set(s, "model", obj.model());
+/**
+ * @brief Draw a render proxy
+ *
+ * @param p The proxy
+ */
+void camera::draw(const proxy &p)
+{
+    gls program = prepare(p.features);
+
+    shader::set(program, "model", p.model);
 
-    shader::set(s, "tmc", obj.tmc);
-    shader::set(s, "color", obj.color);
+    if (depth == NULL)
+    {
+        shader::set(program, "tmc", p.tmc);
+        shader::set(program, "color", p.color);
+        shader::set(program, "alpha", p.alpha);
 
-    glBindTexture(GL_TEXTURE_2D, obj.tex);
+        glstate::bind_texture(GL_TEXTURE_2D, p.tex);
+    }
 
-    // draw mesh
-    glBindVertexArray(obj.VAO);
-    glDrawElements(GL_TRIANGLES, obj.m.tris * 3, GL_UNSIGNED_INT, 0);
-}
\ No newline at end of file
+    // draw mesh (only it's positions for the depth)
+    glstate::bind_vertexarray(depth == NULL ? p.VAO : geometry::deptharray(p.VAO));
+    glDrawElementsBaseVertex(GL_TRIANGLES, p.count, GL_UNSIGNED_INT, (void *)(sizeof(uint) * p.first_index), p.base_vertex);
+    glstate::stats.draws++;
+}
+
+/**
+ * @brief Draw many copies of a render proxy's mesh with one draw call
+ *
+ * @param p The proxy (shared mesh & material)
+ * @param instances The number of instances
+ * @param buffer The instance buffer
+ * @param offset The first instance's offset in the buffer (in bytes)
+ */
+void camera::draw(const proxy &p, uint instances, uint buffer, size_t offset)
+{
+    gls program = prepare(p.features | instanced_bit);
+
+    if (depth == NULL)
+    {
+        shader::set(program, "alpha", p.alpha);
+        glstate::bind_texture(GL_TEXTURE_2D, p.tex);
+    }
+
+    glstate::bind_vertexarray(depth == NULL ? p.VAO : geometry::deptharray(p.VAO));
+
+    attach(buffer, offset);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, p.count, GL_UNSIGNED_INT, (void *)(sizeof(uint) * p.first_index), instances, p.base_vertex);
+    glstate::stats.draws++;
+    detach();
+}
+
+/**
+ * @brief Draw many meshes of the same vertex format with one glMultiDrawElementsIndirect call
+ * @details Every command selects it's instances with it's base instance, so the instance attributes start at the buffer's beginning
+ *
+ * @param p The first proxy (the state is shared by every command)
+ * @param draws The number of commands
+ * @param buffer The instance buffer
+ * @param commands The command buffer (see drawcommand)
+ * @param offset The first command's offset in the command buffer (in bytes)
+ */
+void camera::multidraw(const proxy &p, uint draws, uint buffer, uint commands, size_t offset)
+{
+    gls program = prepare(p.features | instanced_bit);
+
+    if (depth == NULL)
+    {
+        shader::set(program, "alpha", p.alpha);
+        glstate::bind_texture(GL_TEXTURE_2D, p.tex);
+    }
+
+    glstate::bind_vertexarray(depth == NULL ? p.VAO : geometry::deptharray(p.VAO));
+
+    attach(buffer, 0);
+    glstate::bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)offset, draws, 0);
+    glstate::stats.draws++;
+    detach();
+}
@@ -0,0 +1,146 @@
+// Cascaded Shadow Maps for the Game Engine
+#pragma once
+
+#include <math.h>
+
+#include <tools/types.h>
+
+#include <engine/culling.h>
+
+// The maximal number of cascades (same as MAX_CASCADES in light.fs)
+#define CASCADE_COUNT 4
+
+/**
+ * @brief One cascade (a slice of the camera's view, covered by one shadow map)
+ */
+struct cascade
+{
+    float near = 0.0f, far = 0.0f; // the slice (distance from the camera)
+
+    vec3 center;         // the slice's bounding sphere
+    float radius = 0.0f; // (the shadow map covers 2 * radius)
+
+    mat4 matrix;    // world-space to the shadow map's clip-space (view * projection)
+    frustum bounds; // for culling the casters (without a near plane, see fit())
+};
+
+/**
+ * @brief Cascade math (pure CPU functions, no OpenGL)
+ */
+namespace cascades
+{
+    /**
+     * @brief Split the view's depth range (practical split scheme)
+     * @details Blends logarithmic splits (even resolution over the depth) and uniform splits (not too thin near slices)
+     *
+     * @param near The camera's near
+     * @param far The shadows' far
+     * @param count The number of cascades
+     * @param lambda The blend factor (0 - uniform, 1 - logarithmic)
+     * @param out The split distances (count + 1, out[0] = near, out[count] = far)
+     */
+    void splits(float near, float far, uint count, float lambda, float *out)
+    {
+        for (uint i = 0; i <= count; i++)
+        {
+            float p = (float)i / count;
+            float logarithmic = near * powf(far / near, p);
+            float uniform = near + (far - near) * p;
+
+            out[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+        }
+    }
+
+    /**
+     * @brief Get the world-space corners of a slice of the view
+     *
+     * @param view The camera's view matrix
+     * @param projection The camera's projection matrix (symmetric perspective)
+     * @param near The slice's near
+     * @param far The slice's far
+     * @param out The corners (near 4, then far 4)
+     */
+    void corners(mat4 view, mat4 projection, float near, float far, vec3 out[8])
+    {
+        mat4 world = matrix::inverse(view);
+
+        for (int i = 0; i < 8; i++)
+        {
+            float d = i < 4 ? near : far;
+            vec3 v = {(i & 1 ? 1.0f : -1.0f) * d / projection.m[0][0],
+                      (i & 2 ? 1.0f : -1.0f) * d / projection.m[1][1],
+                      -d};
+            out[i] = matrix::multiplyvec(world, v);
+            out[i].w = 1.0f;
+        }
+    }
+
+    /**
+     * @brief Move a shadow matrix to the shadow map's texel grid
+     * @details Moving the camera then moves the map by whole texels, so the shadows' edges don't shimmer
+     *
+     * @param m The shadow matrix (orthographic)
+     * @param resolution The shadow map's size
+     */
+    void snap(mat4 &m, uint resolution)
+    {
+        // Where the world's origin lands on the map (in texels)
+        vec3 origin = matrix::multiplyvec(m, {0.0f, 0.0f, 0.0f});
+        float x = origin.x * resolution / 2.0f;
+        float y = origin.y * resolution / 2.0f;
+
+        m.m[3][0] += (roundf(x) - x) * 2.0f / resolution;
+        m.m[3][1] += (roundf(y) - y) * 2.0f / resolution;
+    }
+
+    /**
+     * @brief Fit a cascade to a slice of the view
+     * @details The map covers the slice's bounding sphere, so it's size doesn't change while the camera turns
+     *
+     * @param corners The slice's corners (see cascades::corners())
+     * @param direction The light's direction
+     * @param resolution The shadow map's size
+     * @param depth How far the casters can be behind the slice (towards the light)
+     * @return The cascade (without near & far)
+     */
+    cascade fit(const vec3 corners[8], vec3 direction, uint resolution, float depth)
+    {
+        cascade c;
+
+        // Bounding Sphere
+        vec3 center;
+        for (int i = 0; i < 8; i++)
+            center += corners[i];
+        center = center / 8.0f;
+        center.w = 1.0f;
+
+        float radius = 0.0f;
+        for (int i = 0; i < 8; i++)
+            radius = fmaxf(radius, vector::distance(center, corners[i]));
+
+        // Rounded up, so floating point noise doesn't change the map's scale
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        // The light's view (looking at the sphere's center)
+        direction = vector::normalize(direction);
+        vec3 up = fabsf(direction.y) > 0.99f ? (vec3){0.0f, 0.0f, 1.0f} : (vec3){0.0f, 1.0f, 0.0f};
+        vec3 eye = center - direction * (radius + depth);
+
+        mat4 view = matrix::lookAt(eye, center, up);
+        mat4 projection = matrix::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + depth);
+
+        c.center = center;
+        c.radius = radius;
+        c.matrix = view * projection;
+        snap(c.matrix, resolution);
+
+        // Casters in front of the near plane still cast into the slice (they are clamped, see Shadows::render())
+        c.bounds = culling::extract(c.matrix);
+        c.bounds.planes[4][0] = 0.0f;
+        c.bounds.planes[4][1] = 0.0f;
+        c.bounds.planes[4][2] = 0.0f;
+        c.bounds.planes[4][3] = 1.0f;
+
+        return c;
+    }
+};
@@ -0,0 +1,259 @@
+// Clustered Light Assignment for the Game Engine
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include <tools/types.h>
+#include <engine/workers.h>
+
+/**
+ * @brief The froxel grid (the view frustum split into tiles on the screen and exponential depth slices)
+ */
+struct clustergrid
+{
+    uint x = 16, y = 9, z = 24; // number of clusters per axis
+
+    float near = 0.1f, far = 1000.0f; // the depth range (the camera's near & far)
+
+    // The projection's scale (projection.m[0][0] & projection.m[1][1], symmetric perspective only)
+    float scale_x = 1.0f, scale_y = 1.0f;
+};
+
+/**
+ * @brief A light, prepared for clustering (view-space)
+ */
+struct clusterlight
+{
+    vec3 position;
+    float radius = 0.0f; // range of the light (where it's contribution is negligible)
+    bool global = false; // lights every cluster (ex. directional lights)
+};
+
+/**
+ * @brief The result of the light assignment
+ */
+struct clusterlist
+{
+    std::vector<uint> grid;    // {offset, count} per cluster (cluster = (k * y + j) * x + i)
+    std::vector<uint> indices; // the light indices of the clusters
+};
+
+/**
+ * @brief Clustered light assignment (pure CPU functions, no OpenGL)
+ */
+namespace clusters
+{
+    /**
+     * @brief Get the depth slice of a view-space distance
+     *
+     * @param g The grid
+     * @param depth The distance from the camera (positive)
+     * @return The slice
+     */
+    uint slice(const clustergrid &g, float depth)
+    {
+        if (depth <= g.near)
+            return 0;
+
+        float s = logf(depth / g.near) / logf(g.far / g.near) * g.z;
+        return std::min((uint)s, g.z - 1);
+    }
+
+    /**
+     * @brief Get the depth range of a slice
+     *
+     * @param g The grid
+     * @param k The slice
+     * @param near The slice's near distance (output)
+     * @param far The slice's far distance (output)
+     */
+    void range(const clustergrid &g, uint k, float &near, float &far)
+    {
+        near = g.near * powf(g.far / g.near, (float)k / g.z);
+        far = g.near * powf(g.far / g.near, (float)(k + 1) / g.z);
+    }
+
+    /**
+     * @brief Get the view-space bounding box of a cluster
+     *
+     * @param g The grid
+     * @param i The tile's column
+     * @param j The tile's row
+     * @param k The depth slice
+     * @param min The box's minimum (output)
+     * @param max The box's maximum (output)
+     */
+    void bounds(const clustergrid &g, uint i, uint j, uint k, vec3 &min, vec3 &max)
+    {
+        float zn, zf;
+        range(g, k, zn, zf);
+
+        float x0 = -1.0f + 2.0f * i / g.x, x1 = -1.0f + 2.0f * (i + 1) / g.x;
+        float y0 = -1.0f + 2.0f * j / g.y, y1 = -1.0f + 2.0f * (j + 1) / g.y;
+
+        // The tile's corners on the slice's near & far planes (the view looks down -z)
+        float xs[4] = {x0 * zn / g.scale_x, x1 * zn / g.scale_x, x0 * zf / g.scale_x, x1 * zf / g.scale_x};
+        float ys[4] = {y0 * zn / g.scale_y, y1 * zn / g.scale_y, y0 * zf / g.scale_y, y1 * zf / g.scale_y};
+
+        min = {*std::min_element(xs, xs + 4), *std::min_element(ys, ys + 4), -zf};
+        max = {*std::max_element(xs, xs + 4), *std::max_element(ys, ys + 4), -zn};
+    }
+
+    /**
+     * @brief Check if a sphere touches a box
+     *
+     * @param center The sphere's center
+     * @param radius The sphere's radius
+     * @param min The box's minimum
+     * @param max The box's maximum
+     * @return do they touch?
+     */
+    bool touches(vec3 center, float radius, vec3 min, vec3 max)
+    {
+        float dx = fmaxf(fmaxf(min.x - center.x, 0.0f), center.x - max.x);
+        float dy = fmaxf(fmaxf(min.y - center.y, 0.0f), center.y - max.y);
+        float dz = fmaxf(fmaxf(min.z - center.z, 0.0f), center.z - max.z);
+        return dx * dx + dy * dy + dz * dz <= radius * radius;
+    }
+
+    /**
+     * @brief Assign the lights of some depth slices (one worker's job)
+     *
+     * @param g The grid
+     * @param lights The lights
+     * @param first The first slice
+     * @param last The end of the slices
+     * @param counts The number of lights per cluster of the slices (output)
+     * @param indices The light indices, cluster after cluster (output)
+     */
+    void assign(const clustergrid &g, const std::vector<clusterlight> &lights, uint first, uint last,
+                std::vector<uint> &counts, std::vector<uint> &indices)
+    {
+        std::vector<std::vector<uint>> bins(g.x * g.y);
+
+        for (uint k = first; k < last; k++)
+        {
+            float zn, zf;
+            range(g, k, zn, zf);
+
+            for (auto &bin : bins)
+                bin.clear();
+
+            for (uint l = 0; l < (uint)lights.size(); l++)
+            {
+                const clusterlight &light = lights[l];
+                if (light.global)
+                {
+                    for (auto &bin : bins)
+                        bin.push_back(l);
+                    continue;
+                }
+
+                // Only the lights that reach the slice's depth range
+                float depth = -light.position.z;
+                if (depth + light.radius < zn || depth - light.radius > zf)
+                    continue;
+
+                // The tiles the light's box can cover (at the nearest depth it reaches in the slice)
+                float d = fmaxf(fmaxf(depth - light.radius, zn), 1e-4f);
+                float x0 = (light.position.x - light.radius) * g.scale_x / d, x1 = (light.position.x + light.radius) * g.scale_x / d;
+                float y0 = (light.position.y - light.radius) * g.scale_y / d, y1 = (light.position.y + light.radius) * g.scale_y / d;
+
+                // ... or at the farthest one (the box spans both sides of the view)
+                float D = fminf(depth + light.radius, zf);
+                x0 = fminf(x0, (light.position.x - light.radius) * g.scale_x / D);
+                x1 = fmaxf(x1, (light.position.x + light.radius) * g.scale_x / D);
+                y0 = fminf(y0, (light.position.y - light.radius) * g.scale_y / D);
+                y1 = fmaxf(y1, (light.position.y + light.radius) * g.scale_y / D);
+
+                int i0 = std::max(0, (int)floorf((x0 + 1.0f) / 2.0f * g.x)), i1 = std::min((int)g.x - 1, (int)floorf((x1 + 1.0f) / 2.0f * g.x));
+                int j0 = std::max(0, (int)floorf((y0 + 1.0f) / 2.0f * g.y)), j1 = std::min((int)g.y - 1, (int)floorf((y1 + 1.0f) / 2.0f * g.y));
+
+                for (int j = j0; j <= j1; j++)
+                {
+                    for (int i = i0; i <= i1; i++)
+                    {
+                        vec3 min, max;
+                        bounds(g, i, j, k, min, max);
+
+                        if (touches(light.position, light.radius, min, max))
+                            bins[j * g.x + i].push_back(l);
+                    }
+                }
+            }
+
+            for (auto &bin : bins)
+            {
+                counts.push_back(bin.size());
+                indices.insert(indices.end(), bin.begin(), bin.end());
+            }
+        }
+    }
+
+    /**
+     * @brief Assign lights to every cluster of the grid
+     * @details The depth slices are split between the workers, the results are merged in the workers' order
+     * (their ranges are in order, so the output doesn't depend on the number of threads)
+     *
+     * @param g The grid
+     * @param lights The lights (view-space)
+     * @param workers The threads to split the slices between (NULL - the calling thread)
+     * @return The assignment
+     */
+    clusterlist assign(const clustergrid &g, const std::vector<clusterlight> &lights, Workers *workers = NULL)
+    {
+        uint threads = workers != NULL ? workers->size() : 1;
+        std::vector<std::vector<uint>> counts(threads), indices(threads);
+
+        if (workers == NULL)
+            assign(g, lights, 0, g.z, counts[0], indices[0]);
+        else
+            workers->run(g.z, [&](size_t first, size_t last, uint worker)
+                         { assign(g, lights, (uint)first, (uint)last, counts[worker], indices[worker]); },
+                         1);
+
+        // Merge
+        clusterlist out;
+        out.grid.reserve(g.x * g.y * g.z * 2);
+
+        for (uint t = 0; t < threads; t++)
+        {
+            uint offset = out.indices.size();
+            for (uint c : counts[t])
+            {
+                out.grid.push_back(offset);
+                out.grid.push_back(c);
+                offset += c;
+            }
+            out.indices.insert(out.indices.end(), indices[t].begin(), indices[t].end());
+        }
+
+        return out;
+    }
+
+    /**
+     * @brief Calculate a light's range from it's attenuation
+     *
+     * @param constant The constant term
+     * @param linear The linear term
+     * @param quadratic The quadratic term
+     * @param brightness The light's maximal brightness (color * strength)
+     * @param threshold The negligible brightness
+     * @return The range (negative if infinite)
+     */
+    float radius(float constant, float linear, float quadratic, float brightness, float threshold = 1.0f / 256.0f)
+    {
+        // brightness / (c + l * d + q * d^2) = threshold
+        float c = constant - brightness / threshold;
+        if (c >= 0.0f)
+            return 0.0f;
+
+        if (quadratic > 0.0f)
+            return (-linear + sqrtf(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+        if (linear > 0.0f)
+            return -c / linear;
+        return -1.0f;
+    }
+};
@@ -0,0 +1,363 @@
+// Frustum Culling for the Game Engine
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <tools/types.h>
+#include <engine/workers.h>
+
+// The SIMD width of the culling tests
+#if defined(__AVX__)
+#define CULL_WIDTH 8
+#elif defined(__SSE2__)
+#define CULL_WIDTH 4
+#else
+#define CULL_WIDTH 1
+#endif
+
+// Number of objects per block (blocks are tested before their objects)
+#define CULL_BLOCK 64
+
+/**
+ * @brief The six planes of a view frustum
+ * @details {a, b, c, d} per plane (normals point inwards): left, right, bottom, top, near, far
+ */
+struct frustum
+{
+    float planes[6][4] = {{0}};
+};
+
+/**
+ * @brief Frustum helpers
+ */
+namespace culling
+{
+    /**
+     * @brief Extract the frustum planes of a view-projection matrix (Gribb-Hartmann)
+     *
+     * @param vp The view-projection matrix (view * projection)
+     * @return The frustum
+     */
+    frustum extract(mat4 vp)
+    {
+        frustum f;
+        for (int i = 0; i < 6; i++)
+        {
+            int axis = i / 2;
+            float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+
+            float length = 0.0f;
+            for (int r = 0; r < 4; r++)
+            {
+                f.planes[i][r] = vp.m[r][3] + sign * vp.m[r][axis];
+                if (r < 3)
+                    length += f.planes[i][r] * f.planes[i][r];
+            }
+
+            length = sqrtf(length);
+            if (length > 0.0f)
+                for (int r = 0; r < 4; r++)
+                    f.planes[i][r] /= length;
+        }
+        return f;
+    }
+
+    /**
+     * @brief Test an axis-aligned bounding box against a frustum
+     *
+     * @param f The frustum
+     * @param min The box's minimum
+     * @param max The box's maximum
+     * @return -1 if outside, 0 if intersecting, 1 if fully inside
+     */
+    int aabb(const frustum &f, vec3 min, vec3 max)
+    {
+        float c[3] = {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+        float e[3] = {(max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f};
+
+        int result = 1;
+        for (int i = 0; i < 6; i++)
+        {
+            const float *p = f.planes[i];
+            float d = p[0] * c[0] + p[1] * c[1] + p[2] * c[2] + p[3];
+            float r = fabsf(p[0]) * e[0] + fabsf(p[1]) * e[1] + fabsf(p[2]) * e[2];
+
+            if (d + r < 0.0f)
+                return -1;
+            if (d - r < 0.0f)
+                result = 0;
+        }
+        return result;
+    }
+
+    /**
+     * @brief Test a bounding sphere against a frustum
+     *
+     * @param f The frustum
+     * @param center The sphere's center
+     * @param radius The sphere's radius
+     * @return is it (partly) inside?
+     */
+    bool sphere(const frustum &f, vec3 center, float radius)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            const float *p = f.planes[i];
+            if (p[0] * center.x + p[1] * center.y + p[2] * center.z + p[3] < -radius)
+                return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief A block of consecutive objects (with the union of their bounds)
+ */
+struct __cull_block_t
+{
+    vec3 min, max;
+    bool dirty = true;
+};
+
+/**
+ * @brief Culls bounding boxes against a frustum, CULL_WIDTH boxes at a time
+ * @details The boxes are stored as structure-of-arrays (center & half-extents), blocks of CULL_BLOCK boxes
+ * that are fully outside (or inside) the frustum skip the per-box tests
+ */
+class Culler
+{
+private:
+    size_t n = 0;
+    std::vector<float> cx, cy, cz; // centers
+    std::vector<float> ex, ey, ez; // half-extents
+
+    std::vector<__cull_block_t> blocks;
+
+    void test(const frustum &f, size_t first, size_t last, std::vector<unsigned char> &out);
+    uint range(const frustum &f, size_t first, size_t last, std::vector<unsigned char> &out);
+
+public:
+    // Statistics of the last cull()
+    uint visible = 0;
+    uint culled = 0;
+    uint blocks_skipped = 0; // blocks that didn't need per-box tests
+
+    void resize(size_t count);
+    void set(size_t i, vec3 min, vec3 max);
+    void cull(const frustum &f, std::vector<unsigned char> &out, Workers *workers = NULL);
+};
+
+/**
+ * @brief Set the number of boxes
+ *
+ * @param count The number of boxes
+ */
+void Culler::resize(size_t count)
+{
+    // Padded to the SIMD width (the padding is an empty box far away)
+    size_t padded = (count + CULL_WIDTH - 1) / CULL_WIDTH * CULL_WIDTH;
+
+    cx.resize(padded, 1e30f);
+    cy.resize(padded, 1e30f);
+    cz.resize(padded, 1e30f);
+    ex.resize(padded, 0.0f);
+    ey.resize(padded, 0.0f);
+    ez.resize(padded, 0.0f);
+
+    blocks.resize((count + CULL_BLOCK - 1) / CULL_BLOCK);
+    n = count;
+}
+
+/**
+ * @brief Update a box (call when the object moved)
+ *
+ * @param i The box's index
+ * @param min The world-space minimum
+ * @param max The world-space maximum
+ */
+void Culler::set(size_t i, vec3 min, vec3 max)
+{
+    if (i >= n)
+        resize(i + 1);
+
+    cx[i] = (min.x + max.x) * 0.5f;
+    cy[i] = (min.y + max.y) * 0.5f;
+    cz[i] = (min.z + max.z) * 0.5f;
+    ex[i] = (max.x - min.x) * 0.5f;
+    ey[i] = (max.y - min.y) * 0.5f;
+    ez[i] = (max.z - min.z) * 0.5f;
+
+    blocks[i / CULL_BLOCK].dirty = true;
+}
+
+/**
+ * @brief Test a range of boxes (first must be aligned to CULL_WIDTH)
+ *
+ * @param f The frustum
+ * @param first The first box
+ * @param last The end of the range
+ * @param out 1 for visible, 0 for culled (per box)
+ */
+void Culler::test(const frustum &f, size_t first, size_t last, std::vector<unsigned char> &out)
+{
+    size_t i = first;
+
+#if CULL_WIDTH == 8
+    for (; i < last; i += 8)
+    {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 signmask = _mm256_set1_ps(-0.0f);
+
+        __m256 x = _mm256_loadu_ps(&cx[i]), y = _mm256_loadu_ps(&cy[i]), z = _mm256_loadu_ps(&cz[i]);
+        __m256 hx = _mm256_loadu_ps(&ex[i]), hy = _mm256_loadu_ps(&ey[i]), hz = _mm256_loadu_ps(&ez[i]);
+
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 a = _mm256_set1_ps(f.planes[p][0]), b = _mm256_set1_ps(f.planes[p][1]);
+            __m256 c = _mm256_set1_ps(f.planes[p][2]), d = _mm256_set1_ps(f.planes[p][3]);
+
+            // distance of the center + projected radius of the box
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, x), _mm256_mul_ps(b, y)), _mm256_add_ps(_mm256_mul_ps(c, z), d));
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signmask, a), hx), _mm256_mul_ps(_mm256_andnot_ps(signmask, b), hy)),
+                                          _mm256_mul_ps(_mm256_andnot_ps(signmask, c), hz));
+
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (int k = 0; k < 8 && i + k < last; k++)
+            out[i + k] = (mask >> k) & 1;
+    }
+#elif CULL_WIDTH == 4
+    for (; i < last; i += 4)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 signmask = _mm_set1_ps(-0.0f);
+
+        __m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+        __m128 hx = _mm_loadu_ps(&ex[i]), hy = _mm_loadu_ps(&ey[i]), hz = _mm_loadu_ps(&ez[i]);
+
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 a = _mm_set1_ps(f.planes[p][0]), b = _mm_set1_ps(f.planes[p][1]);
+            __m128 c = _mm_set1_ps(f.planes[p][2]), d = _mm_set1_ps(f.planes[p][3]);
+
+            // distance of the center + projected radius of the box
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)), _mm_add_ps(_mm_mul_ps(c, z), d));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signmask, a), hx), _mm_mul_ps(_mm_andnot_ps(signmask, b), hy)),
+                                       _mm_mul_ps(_mm_andnot_ps(signmask, c), hz));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4 && i + k < last; k++)
+            out[i + k] = (mask >> k) & 1;
+    }
+#else
+    for (; i < last; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            const float *pl = f.planes[p];
+            float dist = pl[0] * cx[i] + pl[1] * cy[i] + pl[2] * cz[i] + pl[3];
+            float radius = fabsf(pl[0]) * ex[i] + fabsf(pl[1]) * ey[i] + fabsf(pl[2]) * ez[i];
+            inside = dist + radius >= 0.0f;
+        }
+        out[i] = inside;
+    }
+#endif
+}
+
+/**
+ * @brief Cull a range of blocks
+ *
+ * @param f The frustum
+ * @param first The first block
+ * @param last The end of the range
+ * @param out 1 for visible, 0 for culled (per box)
+ * @return The number of skipped blocks
+ */
+uint Culler::range(const frustum &f, size_t first, size_t last, std::vector<unsigned char> &out)
+{
+    uint skipped = 0;
+
+    for (size_t b = first; b < last; b++)
+    {
+        size_t start = b * CULL_BLOCK;
+        size_t end = std::min(start + CULL_BLOCK, n);
+
+        __cull_block_t &block = blocks[b];
+        if (block.dirty)
+        {
+            for (size_t i = start; i < end; i++)
+            {
+                vec3 min = {cx[i] - ex[i], cy[i] - ey[i], cz[i] - ez[i]};
+                vec3 max = {cx[i] + ex[i], cy[i] + ey[i], cz[i] + ez[i]};
+                if (i == start)
+                {
+                    block.min = min;
+                    block.max = max;
+                }
+
+                block.min = {fminf(block.min.x, min.x), fminf(block.min.y, min.y), fminf(block.min.z, min.z)};
+                block.max = {fmaxf(block.max.x, max.x), fmaxf(block.max.y, max.y), fmaxf(block.max.z, max.z)};
+            }
+            block.dirty = false;
+        }
+
+        // Hierarchical early-out
+        int result = culling::aabb(f, block.min, block.max);
+        if (result != 0)
+        {
+            for (size_t i = start; i < end; i++)
+                out[i] = result > 0;
+            skipped++;
+        }
+        else
+            test(f, start, end, out);
+    }
+
+    return skipped;
+}
+
+/**
+ * @brief Cull every box
+ *
+ * @param f The frustum
+ * @param out 1 for visible, 0 for culled (per box)
+ * @param workers The threads to split the blocks between (NULL - the calling thread)
+ */
+void Culler::cull(const frustum &f, std::vector<unsigned char> &out, Workers *workers)
+{
+    out.resize(n);
+
+    visible = 0;
+    culled = 0;
+    blocks_skipped = 0;
+
+    if (workers == NULL)
+        blocks_skipped = range(f, 0, blocks.size(), out);
+    else
+    {
+        // Blocks are CULL_BLOCK (a multiple of CULL_WIDTH) boxes, so the ranges don't share SIMD groups
+        std::vector<uint> skipped(workers->size(), 0);
+        workers->run(blocks.size(), [&](size_t first, size_t last, uint worker)
+                     { skipped[worker] = this->range(f, first, last, out); },
+                     std::max(WORKER_GRAIN / CULL_BLOCK, 1));
+
+        for (uint s : skipped)
+            blocks_skipped += s;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        visible += out[i];
+    culled = n - visible;
+}
@@ -6,32 +6,103 @@
 #endif
 
 #include <SDL2/SDL.h>
+#include <tools/device.h>
+#include <tools/trace.h>
 #include <tools/shader.h>
 #include <tools/loadin.h>
 
 #include <engine/camera.h>
 #include <engine/object.h>
+#include <engine/queue.h>
+#include <engine/proxy.h>
+#include <engine/culling.h>
+#include <engine/occlusion.h>
+#include <engine/sprites.h>
+#include <engine/shadows.h>
+#include <engine/light.h>
+#include <engine/profiler.h>
+#include <engine/workers.h>
+#include <engine/renderthread.h>
+#include <engine/resolution.h>
+#include <engine/animation.h>
+#include <engine/particles.h>
+#include <engine/terrain.h>
 
 #include <engine/physics.h>
 
 bool __engine_init = false;
 
+/**
+ * @brief The frame being drawn (handed over from the simulation, see Engine::handoff())
+ */
+struct __engine_frame_t
+{
+    camera *cam = NULL; // the camera (a copy of it with the render thread)
+    vec3 background;    // the clear color
+
+    uint target = 0;           // the 3D scene's framebuffer (0 - the screen)
+    int width = 0, height = 0; // the 3D scene's resolution
+    bool prepass = false;      // draw the opaque depth first? (see Engine::prepass)
+
+    // Statistics
+    uint visible = 0;
+    uint culled = 0;
+};
+
 /**
  * @brief The Engine class
  */
 class Engine : public Physics
 {
 private:
-    // Main Window
-    SDL_Window *window;
-    SDL_GLContext glcontext;
+    // Main Window (or a headless device)
     bool shouldClose;
+    Uint64 frame_start = 0;
 
     camera *cam = NULL;
 
+    // Render Thread (see Engine::threaded())
+    RenderThread renderer;
+    camera *view = NULL;    // the camera's copy for the render thread
+    vec3 background;        // the clear color of the simulated frame
+    __engine_frame_t drawn; // the frame being drawn
+
+    void handoff();
+    void draw();
+
+    // 3D Renderer
+    RenderQueue queue;
+    std::vector<proxy> proxies;
+    Materials materials;
+
+    std::vector<drawbatch> batches;
+    std::vector<float> instances;
+    uint instanceVBO;
+
+    // Multi-Draw-Indirect (see geometry::indirect())
+    std::vector<drawbatch> multidraws; // first batch, number of commands & the commands' offset
+    std::vector<drawcommand> commands;
+    uint indirectVBO;
+
+    Culler culler;
+    std::vector<unsigned char> inview; // frustum culling's results (per proxy)
+
+    // Worker Threads' data
+    std::vector<object *> changed; // objects with outdated proxies
+    std::vector<drawlist> lists;   // per worker
+    std::vector<uint> slots;       // instance of every queued draw (UINT32_MAX if it's drawn alone)
+
+    permutations depth_shaders; // position-only (for the depth pre-pass)
+
+    void prepare(object &obj);
+    void sync(object &obj);
+    void render(camera *c);
+    void submit(camera *c, bool indirect, bool opaque);
+
     // 2D Renderer
     gls ui_shader;
-    uint VAO;
+    SpriteBatch sprites; // draws the quads
+    SpriteBatch ui;      // the simulated frame's quads (handed to sprites)
 
     // Text Renderer
     font chars;
@@ -44,7 +115,26 @@ private:
     bool mbutton[3];
 
 public:
+    Device *device = NULL; // the render device (see DEVICE_TYPE)
+
     std::map<std::string, texture> texs;
+
+    // Render Statistics (of the last frame)
+    uint visible = 0; // drawn objects
+    uint culled = 0;  // objects outside the camera's view
+
+    float frametime = 0.0f; // the time between the last two updates (in ms, high resolution)
+
+    Occlusion occlusion;   // CPU occlusion culling (see object::occluder)
+    Shadows shadows;       // point light & sun shadows (see object::caster, call shadows.setup() or shadows.sun() to use)
+    Light *lights = NULL;  // clustered lights, assigned to the drawn camera's clusters every frame (see Light::setup())
+    Profiler profiler;     // GPU & CPU times of the passes ("shadows", "scene", "2d"), add your own with begin() & end()
+    Resolution resolution; // dynamic resolution of the 3D scene (call resolution.setup() to use, the 2D quads stay sharp)
+    bool prepass = false;  // draw the opaque depth first, so every pixel is shaded once (for fill-rate bound scenes, cameras with camera::invariant, timed as "prepass")
+    Animator animator;     // skeletal animation (CPU skinning of the objects given to animator.add())
+    Particles particles;   // particle emitters (see particles.add(), simulated by the workers, timed as "particles")
+    Terrain terrain;       // heightmap terrain with continuous LOD (load it through gl(), terrain.ground answers height queries, timed as "terrain")
+    Workers workers;       // threads of the proxy updates, culling & queueing (one per core, workers.setup(0) to use only the main thread)
     std::map<std::string, object> objs;
 
     int width, height;
@@ -59,11 +149,16 @@ public:
 
     // Basics
 
-    Engine(std::string wname = "Game", bool fullscreen = true, bool vsync = true);
+    Engine(std::string wname = "Game", bool fullscreen = true, bool vsync = true, DEVICE_TYPE type = DEVICE_GL, int w = 1280, int h = 720);
     bool update(float r, float g, float b);
     void clean();
     void kill();
 
+    // Render Thread
+
+    void threaded(bool on = true);
+    void gl(std::function<void()> fn);
+
     // Loadings
 
     void load(std::string name, texture tex);
@@ -84,6 +179,12 @@ public:
     bool rect(vec2 center, vec2 size, vec3 color_a, vec3 color_b, int bid);
     bool rect(vec2 center, vec2 size, std::string tex_a, std::string tex_b, int bid);
 
+    // 2D Order & Clipping
+
+    void layer(int z);
+    void scissor(vec2 center, vec2 size);
+    void scissor();
+
     // UI
 
     bool key(std::string k);
@@ -99,83 +200,51 @@ public:
 
 /**
  * @brief Construct a new Engine class & init renderers
+ *
+ * @param wname The window's title
+ * @param fullscreen is the window fullscreen?
+ * @param vsync is vsync enabled?
+ * @param type The render device (DEVICE_NULL & DEVICE_HEADLESS run without a window, ex. on build servers)
+ * @param w The width (of the window before it's maximized, or of the headless surface)
+ * @param h The height
  */
-Engine::Engine(std::string wname, bool fullscreen, bool vsync)
+Engine::Engine(std::string wname, bool fullscreen, bool vsync, DEVICE_TYPE type, int w, int h)
 {
     if (!__engine_init)
     {
-        // Init SDL2 & OpenGL
-        if (SDL_Init(SDL_INIT_VIDEO) < 0)
-            debug::error("graphics::init()", "failed to init SDL2", SDL_GetError());
-
-        window = SDL_CreateWindow(wname.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1280, 720, SDL_WINDOW_OPENGL | SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_FULLSCREEN_DESKTOP * fullscreen); // Init Window with OpenGL and Maximized
-        if (window == NULL)
-            debug::error("graphics::init()", "failed to create window", SDL_GetError());
+        // Init the Device & OpenGL
+        width = w;
+        height = h;
 
-        SDL_SetWindowMinimumSize(window, 720, 480);
+        device = devices::create(type);
+        devices::current = device;
+        device->open(wname, width, height, fullscreen, vsync);
+        trace::attach(width, height); // if trace::start() was called
 
-        SDL_ShowCursor((SDL_bool)!fullscreen);
-        SDL_SetRelativeMouseMode((SDL_bool)fullscreen);
-
-        // Request OpenGL 3.3 Core (or higher)
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-
-        glcontext = SDL_GL_CreateContext(window);
-
-        if (!gladLoadGLLoader(SDL_GL_GetProcAddress) || glcontext == NULL)
-            debug::error("graphics::init()", "failed to init OpenGL");
         debug::glinfo();
+        glstate::invalidate();
 
-        SDL_GetWindowSize(window, &width, &height);
-        glViewport(0, 0, width, height);
-        glEnable(GL_DEPTH_TEST);
+        glstate::viewport(0, 0, width, height);
+        glstate::enable(GL_DEPTH_TEST);
 
-        // Enable VSync (for the editor)
-        SDL_GL_SetSwapInterval(vsync);
-        SDL_SetWindowIcon(window, IMG_Load("res/oof.jpg"));
+        // Without a window there are no inputs
+        static const Uint8 nokeys[SDL_NUM_SCANCODES] = {};
+        keyboard = nokeys;
+        mbutton[0] = mbutton[1] = mbutton[2] = false;
+        shouldClose = false;
 
         // Init 2D Renderer
         ui_shader = shader::load("2d");
         shader::use(ui_shader);
 
         // 2D Renderer Init
-        uint VBO, EBO;
-
-        float vertices[] = {
-            // positions      // texture coords
-            1.0f, 1.0f, 1.0f, 1.0f,   // top right
-            1.0f, -1.0f, 1.0f, 0.0f,  // bottom right
-            -1.0f, -1.0f, 0.0f, 0.0f, // bottom left
-            -1.0f, 1.0f, 0.0f, 1.0f   // top left
-        };
-
-        unsigned int indices[] = {
-            0, 1, 3, // first triangle
-            1, 2, 3  // second triangle
-        };
-
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        // position attribute
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        // texture coord attribute
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+        sprites.init(ui_shader);
 
         // Init 3D Renderer
+        glGenBuffers(1, &instanceVBO);
+        glGenBuffers(1, &indirectVBO);
+
+        workers.setup();
 
         // Init Text Renderer
         // chars = loadin::ttf("ubuntu.ttf");
@@ -189,6 +258,8 @@ Engine::Engine(std::string wname, bool fullscreen, bool vsync)
 
 /**
  * @brief Update the Engine
+ * @details Simulates the frame (timing, inputs, scripts) & hands it to the renderer. With the render thread (see Engine::threaded())
+ * the frame is drawn while the next one is simulated
  *
  * @param r Clear Color [R]
  * @param g Clear Color [G]
@@ -197,61 +268,66 @@ Engine::Engine(std::string wname, bool fullscreen, bool vsync)
  */
 bool Engine::update(float r, float g, float b)
 {
-    // Update Window
-    SDL_GL_SwapWindow(window);
-
-    // Clear Screen
-    glClearColor(r, g, b, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Update Window's Size
-    int w, h;
-    SDL_GetWindowSize(window, &w, &h);
-    if (width != w || height != h)
-        glViewport(0, 0, w, h);
-    width = w;
-    height = h;
-
     // Update Time
     past = millis;
     millis = SDL_GetTicks();
     deltaTime = (float)(millis - past) / 1000;
 
-    // update inputs
-    keyboard = SDL_GetKeyboardState(NULL);
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (frame_start != 0)
+        frametime = (float)(now - frame_start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+    frame_start = now;
 
-    int m[2];
-    if (!SDL_GetRelativeMouseMode())
-    {
-        SDL_GetMouseState(&m[0], &m[1]);
-        mouse.x = map(m[0], 0, width, -1, 1);
-        mouse.y = map(m[1], 0, height, 1, -1);
-    }
-    else
+    // update inputs
+    if (device->windowed())
     {
-        SDL_GetRelativeMouseState(&m[0], &m[1]);
-        mouse.x = m[0] * sensitivity;
-        mouse.y = m[1] * sensitivity;
+        keyboard = SDL_GetKeyboardState(NULL);
+
+        int m[2];
+        if (!SDL_GetRelativeMouseMode())
+        {
+            SDL_GetMouseState(&m[0], &m[1]);
+            mouse.x = map(m[0], 0, width, -1, 1);
+            mouse.y = map(m[1], 0, height, 1, -1);
+        }
+        else
+        {
+            SDL_GetRelativeMouseState(&m[0], &m[1]);
+            mouse.x = m[0] * sensitivity;
+            mouse.y = m[1] * sensitivity;
+        }
     }
 
     if (cam != NULL)
         cam->update();
 
-    // Update Objects
+    // Update Objects (scripts)
     for (auto &elem : objs)
-    {
-        std::string name = elem.first;
-        object *obj = &elem.second;
+        elem.second.update(deltaTime, millis);
+
+    // Animate the Skinned Objects
+    animator.update(deltaTime, workers);
 
-        obj->update(deltaTime, millis);
+    // Simulate the Particles
+    particles.update(deltaTime, workers);
 
-        if (cam != NULL && obj->drawable)
-            cam->draw(*obj);
+    // Hand the Frame to the Renderer
+    background = {r, g, b};
+
+    if (renderer.running())
+        renderer.frame();
+    else
+    {
+        handoff();
+        draw();
+
+        visible = drawn.visible;
+        culled = drawn.culled;
     }
 
     // poll events
     SDL_Event event;
-    while (SDL_PollEvent(&event))
+    while (device->windowed() && SDL_PollEvent(&event))
     {
         if (event.type == SDL_QUIT)
             shouldClose = true;
@@ -279,18 +355,431 @@ bool Engine::update(float r, float g, float b)
     return shouldClose;
 }
 
+/**
+ * @brief Copy the simulated frame to the renderer (streams the changed meshes & updates the render proxies)
+ * @details Runs on the thread with the context, while the simulation waits. After it the renderer doesn't read the objects
+ * (the occluders' triangles are copied), the camera, the simulated 2D quads or the particles
+ */
+void Engine::handoff()
+{
+    // Statistics of the last drawn frame
+    visible = drawn.visible;
+    culled = drawn.culled;
+
+    // Update Window's Size
+    device->size(width, height);
+
+    // Stream the changed Meshes & find the outdated Render Proxies
+    changed.clear();
+    for (auto &elem : objs)
+    {
+        object *obj = &elem.second;
+        obj->stream();
+
+        // Only drawable objects get a proxy
+        if (obj->proxy < 0 && !obj->drawable)
+            continue;
+
+        if (obj->proxy < 0)
+        {
+            obj->proxy = (int)proxies.size();
+            proxies.push_back(proxy());
+        }
+
+        if (obj->changed() || proxies[obj->proxy].visible != obj->drawable)
+            changed.push_back(obj);
+    }
+
+    // Update the Render Proxies (every object writes only it's own proxy)
+    workers.run(changed.size(), [&](size_t first, size_t last, uint worker)
+                {
+                    for (size_t i = first; i < last; i++)
+                        prepare(*changed[i]);
+                });
+
+    for (object *obj : changed)
+        sync(*obj);
+
+    // The Camera, the Clear Color & the 2D Quads
+    drawn.cam = cam;
+    if (renderer.running() && cam != NULL)
+    {
+        if (view == NULL)
+            view = new camera(*cam);
+        else
+            *view = *cam;
+        drawn.cam = view;
+    }
+
+    drawn.background = background;
+    drawn.prepass = prepass;
+    sprites.take(ui);
+
+    // The alive Particles (copied to the GPU)
+    particles.upload();
+}
+
+/**
+ * @brief Draw the handed frame (shows the last frame with it's 2D quads, then draws the 3D scene)
+ */
+void Engine::draw()
+{
+    // Draw the last frame's 2D quads & show it
+    profiler.begin("2d");
+    sprites.flush(width, height);
+    profiler.end();
+
+    profiler.frame();
+    device->present();
+    trace::frame();
+    glstate::frame();
+
+    // Clear Screen
+    glClearColor(drawn.background.x, drawn.background.y, drawn.background.z, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glstate::viewport(0, 0, width, height);
+
+    // Draw the 3D Scene (into the dynamic resolution's target, then upscaled to the screen)
+    drawn.target = 0;
+    drawn.width = width;
+    drawn.height = height;
+
+    resolution.update(profiler);
+    if (resolution.enabled)
+        drawn.target = resolution.begin(width, height, drawn.width, drawn.height);
+
+    geometry::flush();
+    render(drawn.cam);
+    geometry::advance();
+
+    if (resolution.enabled)
+        resolution.end(width, height);
+}
+
+/**
+ * @brief Draw the 3D scene (fills, sorts & executes the render queue)
+ *
+ * @param c The camera
+ */
+void Engine::render(camera *c)
+{
+    if (c == NULL)
+        return;
+
+    c->begin();
+
+    // Shadows (only the changed faces of the point lights, the sun's cascades follow the camera)
+    profiler.begin("shadows");
+    shadows.fit(c->viewmat, c->projmat, c->near, c->far);
+    shadows.render(proxies);
+    glstate::bind_framebuffer(drawn.target);
+    glstate::viewport(0, 0, drawn.width, drawn.height);
+    profiler.end();
+
+    // Clustered Lights (with this frame's view & the drawn resolution)
+    if (lights != NULL)
+        lights->cluster(c->viewmat, c->projmat, c->near, c->far, drawn.width, drawn.height, &workers);
+
+    profiler.begin("scene");
+
+    // Frustum Culling
+    mat4 viewproj = c->viewmat * c->projmat;
+    culler.cull(culling::extract(viewproj), inview, &workers);
+
+    // Occlusion Culling (rasterize the visible occluders, the other objects are tested while queueing)
+    bool occlusion_on = occlusion.enabled && !occlusion.all().empty();
+    Uint64 occlusion_start = SDL_GetPerformanceCounter();
+
+    if (occlusion_on)
+    {
+        occlusion.begin(viewproj);
+        for (auto &o : occlusion.all())
+            if (proxies[o.proxy].visible && inview[o.proxy])
+                occlusion.rasterize(o.vertices, proxies[o.proxy].model);
+        occlusion.finish();
+    }
+
+    // Fill the Render Queue (every worker queues a range of the proxies to it's own list)
+    lists.resize(workers.size());
+    for (auto &l : lists)
+    {
+        l.items.clear();
+        l.visible = l.culled = l.tested = l.occluded = 0;
+    }
+
+    workers.run(proxies.size(), [&](size_t first, size_t last, uint worker)
+                {
+                    drawlist &l = lists[worker];
+
+                    for (size_t i = first; i < last; i++)
+                    {
+                        const proxy &p = proxies[i];
+                        if (!p.visible)
+                            continue;
+
+                        if (!inview[i])
+                        {
+                            l.culled++;
+                            continue;
+                        }
+
+                        if (occlusion_on)
+                        {
+                            l.tested++;
+                            if (!occlusion.test(p.min, p.max))
+                            {
+                                l.occluded++;
+                                continue;
+                            }
+                        }
+                        l.visible++;
+
+                        float depth = vector::distance(c->position, p.center) / c->far;
+                        gls program = c->variant(p.features);
+
+                        if (p.alpha < 1.0f)
+                            l.items.push_back({renderkey::transparent(program, p.material, p.tex, depth), (uint)i});
+                        else
+                            l.items.push_back({renderkey::opaque(program, p.material, p.tex, p.mesh, depth), (uint)i});
+                    }
+                });
+
+    // Merge the lists in the workers' order (the same queue as with one thread)
+    drawn.visible = 0;
+    drawn.culled = 0;
+    queue.clear();
+
+    for (auto &l : lists)
+    {
+        queue.append(l);
+
+        drawn.visible += l.visible;
+        drawn.culled += l.culled;
+        occlusion.tested += l.tested;
+        occlusion.occluded += l.occluded;
+    }
+
+    if (occlusion_on)
+        occlusion.time = (float)(SDL_GetPerformanceCounter() - occlusion_start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+
+    queue.sort();
+
+    // With multi-draw-indirect every draw is instanced (the instance is selected by the command's base instance)
+    bool indirect = c->instanced_bit != 0 && geometry::indirect();
+
+    // Batch consecutive opaque draws of the same mesh & material (sorting put them next to each other)
+    batches.clear();
+    slots.assign(queue.size(), UINT32_MAX);
+    uint packed = 0;
+
+    for (size_t i = 0; i < queue.size();)
+    {
+        const proxy &a = proxies[queue[i].index];
+
+        size_t j = i + 1;
+        if (c->instanced_bit != 0 && renderkey::pass(queue[i].key) == PASS_OPAQUE)
+        {
+            while (j < queue.size() && renderkey::pass(queue[j].key) == PASS_OPAQUE)
+            {
+                const proxy &b = proxies[queue[j].index];
+                if (a.mesh != b.mesh || a.tex != b.tex || a.features != b.features || a.material != b.material)
+                    break;
+                j++;
+            }
+        }
+
+        drawbatch batch = {(uint)i, (uint)(j - i), (size_t)packed * sizeof(float) * 20};
+
+        if (batch.count > 1 || indirect)
+            for (size_t k = i; k < j; k++)
+                slots[k] = packed++;
+
+        batches.push_back(batch);
+        i = j;
+    }
+
+    // Pack the instance data (model & color, every instance has it's own slot)
+    instances.resize((size_t)packed * 20);
+
+    workers.run(queue.size(), [&](size_t first, size_t last, uint worker)
+                {
+                    for (size_t k = first; k < last; k++)
+                    {
+                        if (slots[k] == UINT32_MAX)
+                            continue;
+
+                        const proxy &p = proxies[queue[k].index];
+                        float *dst = &instances[(size_t)slots[k] * 20];
+
+                        memcpy(dst, &p.model.m[0][0], sizeof(float) * 16);
+                        dst[16] = p.color.x;
+                        dst[17] = p.color.y;
+                        dst[18] = p.color.z;
+                        dst[19] = p.tmc;
+                    }
+                });
+
+    // Upload the frame's instance data (re-specifying the buffer orphans the last frame's data)
+    if (!instances.empty())
+    {
+        glstate::bind_buffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * instances.size(), &instances[0], GL_STREAM_DRAW);
+    }
+
+    // Merge consecutive batches of the same vertex format & state into multi-draws
+    multidraws.clear();
+    commands.clear();
+
+    if (indirect)
+    {
+        for (size_t i = 0; i < batches.size();)
+        {
+            const proxy &a = proxies[queue[batches[i].first].index];
+            RENDER_PASS pass = renderkey::pass(queue[batches[i].first].key);
+
+            size_t j = i;
+            while (j < batches.size())
+            {
+                const proxy &b = proxies[queue[batches[j].first].index];
+                if (j > i && (renderkey::pass(queue[batches[j].first].key) != pass || a.VAO != b.VAO || a.tex != b.tex ||
+                              a.features != b.features || a.alpha != b.alpha))
+                    break;
+
+                uint base_instance = batches[j].offset / (sizeof(float) * 20);
+                commands.push_back({b.count, batches[j].count, b.first_index, (int)b.base_vertex, base_instance});
+                j++;
+            }
+
+            multidraws.push_back({(uint)i, (uint)(j - i), (commands.size() - (j - i)) * sizeof(drawcommand)});
+            i = j;
+        }
+
+        glstate::bind_buffer(GL_DRAW_INDIRECT_BUFFER, indirectVBO);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(drawcommand) * commands.size(), commands.data(), GL_STREAM_DRAW);
+    }
+
+    // Depth Pre-Pass (the opaque draws' depth, then the color pass shades only the visible pixels)
+    if (drawn.prepass && c->invariant)
+    {
+        profiler.begin("prepass");
+
+        if (depth_shaders.programs.empty())
+            depth_shaders = shader::permute("depth", {"INSTANCED"});
+
+        c->depth = &depth_shaders;
+        glstate::colormask(false);
+        submit(c, indirect, true);
+        glstate::colormask(true);
+        c->depth = NULL;
+
+        profiler.end();
+    }
+
+    // Terrain (opaque, only the visible nodes at the LOD of their distance)
+    if (terrain.loaded())
+    {
+        profiler.begin("terrain");
+        terrain.draw(c->viewmat, c->projmat, c->position);
+        profiler.end();
+    }
+
+    submit(c, indirect, false);
+
+    // Particles (blended over the scene)
+    if (particles.drawn > 0)
+    {
+        profiler.begin("particles");
+        particles.draw(c->viewmat, c->projmat);
+        profiler.end();
+    }
+
+    glstate::disable(GL_BLEND);
+    glstate::depthmask(true);
+    glstate::depthfunc(GL_LESS);
+
+    profiler.end();
+}
+
+/**
+ * @brief Draw the batches (opaque front-to-back, then transparent back-to-front)
+ * @details After the depth pre-pass the opaque draws only pass the depth test where they are the nearest (GL_EQUAL,
+ * so the camera's programs have to compute the same depth, see camera::invariant)
+ *
+ * @param c The camera
+ * @param indirect draw with multi-draw-indirect?
+ * @param opaque draw only the opaque batches? (the depth pre-pass)
+ */
+void Engine::submit(camera *c, bool indirect, bool opaque)
+{
+    if (drawn.prepass && c->invariant && !opaque)
+    {
+        glstate::depthfunc(GL_EQUAL);
+        glstate::depthmask(false);
+    }
+
+    if (indirect)
+    {
+        for (auto &md : multidraws)
+        {
+            const drawbatch &batch = batches[md.first];
+            if (renderkey::pass(queue[batch.first].key) == PASS_TRANSPARENT)
+            {
+                if (opaque)
+                    break;
+
+                glstate::enable(GL_BLEND);
+                glstate::blendfunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glstate::depthmask(false);
+                glstate::depthfunc(GL_LESS);
+            }
+
+            c->multidraw(proxies[queue[batch.first].index], md.count, instanceVBO, indirectVBO, md.offset);
+        }
+    }
+    else
+    {
+        for (auto &batch : batches)
+        {
+            if (renderkey::pass(queue[batch.first].key) == PASS_TRANSPARENT)
+            {
+                if (opaque)
+                    break;
+
+                glstate::enable(GL_BLEND);
+                glstate::blendfunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glstate::depthmask(false);
+                glstate::depthfunc(GL_LESS);
+            }
+
+            const proxy &p = proxies[queue[batch.first].index];
+            if (batch.count > 1)
+                c->draw(p, batch.count, instanceVBO, batch.offset);
+            else
+                c->draw(p);
+        }
+    }
+}
+
 /**
  * @brief Cleanup
  */
 void Engine::clean()
 {
+    threaded(false);
     Physics::clean();
 
     // Update Objects
     for (auto &[name, it] : objs)
         destroy(name);
 
-    SDL_DestroyWindow(window);
+    workers.stop();
+    trace::stop();
+    device->close();
+    delete device;
+    device = devices::current = NULL;
+
+    delete view;
+    view = NULL;
     __engine_init = false;
 }
 
@@ -302,6 +791,39 @@ void Engine::kill()
     shouldClose = true;
 }
 
+// Render Thread
+
+/**
+ * @brief Draw on a render thread (it owns the OpenGL context, frame N is drawn while frame N + 1 is simulated)
+ * @details With the render thread the main thread can't call OpenGL: create textures, meshes & shaders through Engine::gl(),
+ * shadows, occlusion, the lights & the profiler belong to the render thread too (change & read them through Engine::gl())
+ *
+ * @param on use the render thread? (else the main thread draws)
+ */
+void Engine::threaded(bool on)
+{
+    if (on)
+        renderer.start(device, [this]()
+                       { handoff(); },
+                       [this]()
+                       { draw(); });
+    else
+        renderer.stop();
+}
+
+/**
+ * @brief Run a function with the OpenGL context (on the render thread between two frames, or right away without it)
+ *
+ * @param fn The function (ex. loading a texture or adding a mesh)
+ */
+void Engine::gl(std::function<void()> fn)
+{
+    if (renderer.running())
+        renderer.call(fn);
+    else
+        fn();
+}
+
 // Loadings
 
 /**
@@ -335,18 +857,8 @@ void Engine::load(std::string name, object obj)
  */
 void Engine::rect(vec2 center, vec2 size, vec3 color)
 {
-    glDisable(GL_DEPTH_TEST);
-
-    shader::use(ui_shader);
-    shader::set(ui_shader, "center", center);
-    shader::set(ui_shader, "size", size / 2);
-    shader::set(ui_shader, "type", 1);
-    shader::set(ui_shader, "color", color);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    glEnable(GL_DEPTH_TEST);
+    // Queued, the 2D quads are drawn at the end of the frame (see SpriteBatch)
+    ui.add(center, size, color, 0, SPRITE_COLORED);
 }
 
 // Render Text
@@ -417,19 +929,7 @@ void Engine::text(vec2 pos, float scale, std::string text, vec3 color)
  */
 void Engine::rect(vec2 center, vec2 size, std::string tex)
 {
-    glDisable(GL_DEPTH_TEST);
-
-    glBindTexture(GL_TEXTURE_2D, texs[tex]);
-
-    shader::use(ui_shader);
-    shader::set(ui_shader, "center", center);
-    shader::set(ui_shader, "size", size / 2);
-    shader::set(ui_shader, "type", 0);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    glEnable(GL_DEPTH_TEST);
+    ui.add(center, size, {1.0f, 1.0f, 1.0f}, texs[tex], SPRITE_TEXTURED);
 }
 
 // Draw Buttons
@@ -498,6 +998,37 @@ bool Engine::rect(vec2 center, vec2 size, std::string tex_a, std::string tex_b,
     return false;
 }
 
+// 2D Order & Clipping
+
+/**
+ * @brief Set the layer of the next 2D shapes (higher layers are drawn on top, resets every frame)
+ *
+ * @param z The layer
+ */
+void Engine::layer(int z)
+{
+    ui.layer = z;
+}
+
+/**
+ * @brief Clip the next 2D shapes to a rectangle
+ *
+ * @param center The rectangle's center
+ * @param size The rectangle's size
+ */
+void Engine::scissor(vec2 center, vec2 size)
+{
+    ui.scissor(center, size);
+}
+
+/**
+ * @brief Stop clipping the next 2D shapes
+ */
+void Engine::scissor()
+{
+    ui.noscissor();
+}
+
 /**
  * @brief Get key inputs
  *
@@ -669,6 +1200,83 @@ bool Engine::key(std::string k)
 void Engine::select(camera *c)
 {
     cam = c;
+
+    // The shader features depend on the camera's variants
+    for (auto &[name, obj] : objs)
+        obj.dirty = true;
+}
+
+/**
+ * @brief Update an object's render proxy (it's draw data & bounds), safe from many threads
+ *
+ * @param obj The object (with a proxy)
+ */
+void Engine::prepare(object &obj)
+{
+    proxy &p = proxies[obj.proxy];
+
+    p.visible = obj.drawable;
+
+    p.VAO = obj.VAO;
+    p.mesh = obj.gpu.id;
+    p.base_vertex = obj.base_vertex;
+    p.first_index = obj.gpu.first_index;
+    p.count = obj.gpu.indices;
+
+    p.features = cam != NULL ? cam->features(obj) : 0;
+    p.tex = obj.tex;
+
+    p.color = obj.color;
+    p.tmc = obj.tmc;
+    p.alpha = obj.m.mtl.d;
+
+    p.model = obj.model();
+
+    // World-Space Bounds
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = {i & 1 ? obj.m.max.x : obj.m.min.x,
+                       i & 2 ? obj.m.max.y : obj.m.min.y,
+                       i & 4 ? obj.m.max.z : obj.m.min.z};
+        vec3 v = matrix::multiplyvec(p.model, corner);
+
+        if (i == 0)
+        {
+            p.min = v;
+            p.max = v;
+        }
+
+        p.min = {fminf(p.min.x, v.x), fminf(p.min.y, v.y), fminf(p.min.z, v.z)};
+        p.max = {fmaxf(p.max.x, v.x), fmaxf(p.max.y, v.y), fmaxf(p.max.z, v.z)};
+    }
+
+    p.center = matrix::multiplyvec(p.model, obj.m.center);
+    p.center.w = 1.0f;
+    p.radius = obj.m.radius; // the model has no scale
+}
+
+/**
+ * @brief Register an object's updated proxy (it's material id, to the culling, the shadows & the occlusion culling)
+ *
+ * @param obj The object (with a prepared proxy, see Engine::prepare())
+ */
+void Engine::sync(object &obj)
+{
+    proxy &p = proxies[obj.proxy];
+
+    p.material = materials.id(obj.m.mtl); // (not in prepare(), so the ids are given in the same order with any number of workers)
+
+    culler.set(obj.proxy, p.min, p.max);
+    shadows.caster(obj.proxy, p.min, p.max, obj.caster && p.visible, obj.dynamic);
+
+    if (obj.occluder && p.visible && p.alpha >= 1.0f)
+        occlusion.add(obj.proxy, obj.m.vertices, obj.dirty); // (copied only when the mesh changed)
+    else
+        occlusion.remove(obj.proxy);
+
+    obj.synced_position = obj.position;
+    obj.synced_rotation = obj.rotation;
+    obj.dirty = false;
 }
 
 void Engine::destroy(std::string name)
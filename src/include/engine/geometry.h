@@ -0,0 +1,630 @@
+// Geometry Pool for the Game Engine
+#pragma once
+
+#include <map>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include <tools/glstate.h>
+#include <tools/debug.h>
+#include <tools/trace.h>
+
+// The frames in flight of the vertex streams (see geometry::stream())
+#define STREAM_FRAMES 3
+
+/**
+ * @brief The vertex formats of the geometry pool
+ */
+typedef enum
+{
+    FORMAT_PNT = 0, // position (3), texcoord (2), normal (3)
+    FORMAT_COUNT
+} VERTEX_FORMAT;
+
+/**
+ * @brief A mesh's place in the geometry pool
+ */
+struct gpumesh
+{
+    uint id = 0; // unique id (0 if not allocated)
+    VERTEX_FORMAT format = FORMAT_PNT;
+
+    uint base_vertex = 0, vertices = 0; // range in the format's vertex buffer
+    uint first_index = 0, indices = 0;  // range in the format's index buffer
+};
+
+/**
+ * @brief One command of a multi-draw-indirect call (layout defined by OpenGL)
+ */
+struct drawcommand
+{
+    uint count;
+    uint instances;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+
+/**
+ * @brief A first-fit free-list allocator with coalescing
+ */
+struct __geometry_allocator_t
+{
+    uint capacity = 0;
+    std::map<uint, uint> free; // offset -> size
+
+    /**
+     * @brief Allocate a range
+     *
+     * @param size The size of the range
+     * @param offset The range's offset (output)
+     * @return was there enough space?
+     */
+    bool alloc(uint size, uint &offset)
+    {
+        for (auto it = free.begin(); it != free.end(); it++)
+        {
+            if (it->second >= size)
+            {
+                offset = it->first;
+                uint left = it->second - size;
+
+                free.erase(it);
+                if (left > 0)
+                    free[offset + size] = left;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Free a range (merges it with it's free neighbours)
+     *
+     * @param offset The range's offset
+     * @param size The range's size
+     */
+    void release(uint offset, uint size)
+    {
+        if (size == 0)
+            return;
+
+        auto next = free.lower_bound(offset);
+
+        // Merge with the previous range
+        if (next != free.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                offset = prev->first;
+                size += prev->second;
+                free.erase(prev);
+            }
+        }
+
+        // Merge with the next range
+        if (next != free.end() && offset + size == next->first)
+        {
+            size += next->second;
+            free.erase(next);
+        }
+
+        free[offset] = size;
+    }
+
+    /**
+     * @brief Grow the managed space
+     *
+     * @param size The new capacity
+     */
+    void grow(uint size)
+    {
+        if (size > capacity)
+        {
+            release(capacity, size - capacity);
+            capacity = size;
+        }
+    }
+};
+
+/**
+ * @brief The shared buffers of one vertex format
+ */
+struct __geometry_format_t
+{
+    bool ready = false;
+
+    uint VAO = 0, VBO = 0, EBO = 0;
+    uint stride = 0; // in floats
+
+    // The stripped stream: only the positions, tightly packed (for depth-only passes, see geometry::deptharray())
+    uint depthVAO = 0, PBO = 0;
+
+    __geometry_allocator_t vertices, indices;
+};
+
+/**
+ * @brief The streaming vertex buffer of one format (for meshes that change every frame)
+ */
+struct __geometry_stream_t
+{
+    bool ready = false;
+    bool persistent = false; // mapped once (ARB_buffer_storage) or orphaned every frame?
+
+    uint VAO = 0, VBO = 0;
+    uint capacity = 0; // vertices per frame
+    uint wanted = 0;   // the capacity after this frame (if it overflowed)
+
+    uint frame = 0; // the ring's current segment
+    uint used = 0;  // vertices written this frame
+
+    float *mapped = NULL;       // the whole ring (persistent)
+    std::vector<float> staging; // this frame's vertices (orphaning)
+    GLsync fences[STREAM_FRAMES] = {0};
+};
+
+/**
+ * @brief The geometry pool
+ * @details Every mesh of a vertex format lives in the same (large) vertex & index buffers, so a whole format
+ * is drawn with one vertex array, meshes are addressed by their base vertex & first index
+ */
+namespace geometry
+{
+    __geometry_format_t formats[FORMAT_COUNT];
+    __geometry_stream_t streams[FORMAT_COUNT];
+    uint next_id = 1;
+
+    // The initial sizes (the buffers grow, if they are full)
+    uint initial_vertices = 1 << 16;
+    uint initial_indices = 1 << 16;
+    uint initial_stream = 1 << 15; // vertices per frame
+
+    /**
+     * @brief Get the size of a format's vertex (in floats)
+     *
+     * @param format The vertex format
+     * @return The size
+     */
+    uint stride(VERTEX_FORMAT format)
+    {
+        switch (format)
+        {
+        case FORMAT_PNT:
+        default:
+            return 8;
+        }
+    }
+
+    /**
+     * @brief Point a vertex array at a vertex buffer of a format
+     *
+     * @param vao The vertex array
+     * @param vbo The vertex buffer
+     * @param format The vertex format
+     */
+    void attributes(uint vao, uint vbo, VERTEX_FORMAT format)
+    {
+        glstate::bind_vertexarray(vao);
+        glstate::bind_buffer(GL_ARRAY_BUFFER, vbo);
+
+        int stride = sizeof(float) * geometry::stride(format);
+        switch (format)
+        {
+        case FORMAT_PNT:
+        default:
+            // vertex positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)(0 * sizeof(float)));
+            // vertex texture coords
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+            // vertex normals
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void *)(5 * sizeof(float)));
+            break;
+        }
+    }
+
+    /**
+     * @brief Point a vertex array at a position buffer (3 floats per vertex)
+     *
+     * @param vao The vertex array
+     * @param pbo The position buffer
+     */
+    void positions(uint vao, uint pbo)
+    {
+        glstate::bind_vertexarray(vao);
+        glstate::bind_buffer(GL_ARRAY_BUFFER, pbo);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void *)0);
+    }
+
+    /**
+     * @brief Copy a buffer into a new, bigger one
+     *
+     * @param buffer The buffer (replaced by the new buffer)
+     * @param oldsize The old size (in bytes)
+     * @param newsize The new size (in bytes)
+     */
+    void resize(uint &buffer, size_t oldsize, size_t newsize)
+    {
+        uint bigger;
+        glGenBuffers(1, &bigger);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+        glBufferData(GL_COPY_WRITE_BUFFER, newsize, NULL, GL_STATIC_DRAW);
+
+        if (buffer != 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldsize);
+
+            glstate::forget(buffer);
+            glDeleteBuffers(1, &buffer);
+        }
+
+        buffer = bigger;
+    }
+
+    /**
+     * @brief Get a format's buffers (creates them on first use)
+     *
+     * @param format The vertex format
+     * @return The buffers
+     */
+    __geometry_format_t &get(VERTEX_FORMAT format)
+    {
+        __geometry_format_t &f = formats[format];
+        if (!f.ready)
+        {
+            f.stride = stride(format);
+            glGenVertexArrays(1, &f.VAO);
+            glGenVertexArrays(1, &f.depthVAO);
+
+            resize(f.VBO, 0, sizeof(float) * f.stride * initial_vertices);
+            resize(f.PBO, 0, sizeof(float) * 3 * initial_vertices);
+            resize(f.EBO, 0, sizeof(uint) * initial_indices);
+            f.vertices.grow(initial_vertices);
+            f.indices.grow(initial_indices);
+
+            attributes(f.VAO, f.VBO, format);
+            glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f.EBO);
+
+            positions(f.depthVAO, f.PBO);
+            glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f.EBO);
+
+            f.ready = true;
+        }
+        return f;
+    }
+
+    /**
+     * @brief Allocate space for a mesh
+     *
+     * @param format The vertex format
+     * @param vertices The number of vertices
+     * @param indices The number of indices
+     * @return The mesh's place
+     */
+    gpumesh alloc(VERTEX_FORMAT format, uint vertices, uint indices)
+    {
+        __geometry_format_t &f = get(format);
+
+        gpumesh out;
+        out.format = format;
+        out.vertices = vertices;
+        out.indices = indices;
+
+        // Grow the vertex buffer, if it's full
+        if (!f.vertices.alloc(vertices, out.base_vertex))
+        {
+            uint capacity = std::max(f.vertices.capacity * 2, f.vertices.capacity + vertices);
+            resize(f.VBO, sizeof(float) * f.stride * f.vertices.capacity, sizeof(float) * f.stride * capacity);
+            resize(f.PBO, sizeof(float) * 3 * f.vertices.capacity, sizeof(float) * 3 * capacity);
+            f.vertices.grow(capacity);
+            f.vertices.alloc(vertices, out.base_vertex);
+
+            attributes(f.VAO, f.VBO, format);
+            positions(f.depthVAO, f.PBO);
+        }
+
+        // Grow the index buffer, if it's full
+        if (!f.indices.alloc(indices, out.first_index))
+        {
+            uint capacity = std::max(f.indices.capacity * 2, f.indices.capacity + indices);
+            resize(f.EBO, sizeof(uint) * f.indices.capacity, sizeof(uint) * capacity);
+            f.indices.grow(capacity);
+            f.indices.alloc(indices, out.first_index);
+
+            glstate::bind_vertexarray(f.VAO);
+            glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f.EBO);
+            glstate::bind_vertexarray(f.depthVAO);
+            glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f.EBO);
+
+            // The stream draws with the same indices
+            if (streams[format].ready)
+            {
+                glstate::bind_vertexarray(streams[format].VAO);
+                glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f.EBO);
+            }
+        }
+
+        out.id = next_id++;
+        return out;
+    }
+
+    /**
+     * @brief Free a mesh's space
+     *
+     * @param m The mesh's place
+     */
+    void release(gpumesh &m)
+    {
+        if (m.id == 0)
+            return;
+
+        __geometry_format_t &f = formats[m.format];
+        f.vertices.release(m.base_vertex, m.vertices);
+        f.indices.release(m.first_index, m.indices);
+
+        m = gpumesh();
+    }
+
+    /**
+     * @brief Upload (a part of) a mesh's vertices (and their positions to the stripped stream)
+     *
+     * @param m The mesh's place
+     * @param data The vertex data
+     * @param first The first vertex to update
+     * @param count The number of vertices
+     */
+    void vertices(const gpumesh &m, const float *data, uint first, uint count)
+    {
+        __geometry_format_t &f = formats[m.format];
+
+        glstate::bind_buffer(GL_ARRAY_BUFFER, f.VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * f.stride * (m.base_vertex + first), sizeof(float) * f.stride * count, data);
+
+        // Every format starts with the position
+        static std::vector<float> packed;
+        packed.resize((size_t)count * 3);
+        for (uint i = 0; i < count; i++)
+        {
+            packed[i * 3 + 0] = data[(size_t)i * f.stride + 0];
+            packed[i * 3 + 1] = data[(size_t)i * f.stride + 1];
+            packed[i * 3 + 2] = data[(size_t)i * f.stride + 2];
+        }
+
+        glstate::bind_buffer(GL_ARRAY_BUFFER, f.PBO);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 3 * (m.base_vertex + first), sizeof(float) * 3 * count, packed.data());
+    }
+
+    /**
+     * @brief Upload a mesh's indices (relative to the mesh's base vertex)
+     *
+     * @param m The mesh's place
+     * @param data The indices
+     */
+    void indices(const gpumesh &m, const uint *data)
+    {
+        __geometry_format_t &f = formats[m.format];
+
+        glstate::bind_vertexarray(f.VAO);
+        glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f.EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * m.first_index, sizeof(uint) * m.indices, data);
+    }
+
+    /**
+     * @brief Get a format's vertex array
+     *
+     * @param format The vertex format
+     * @return The vertex array
+     */
+    uint vertexarray(VERTEX_FORMAT format)
+    {
+        return get(format).VAO;
+    }
+
+    /**
+     * @brief Get the position-only vertex array of a vertex array (for depth-only passes)
+     * @details The pool's vertex arrays have a stripped stream, the streams' vertex arrays are returned as they are
+     *
+     * @param vao The vertex array (see vertexarray() & streamarray())
+     * @return The vertex array with the same vertices & indices
+     */
+    uint deptharray(uint vao)
+    {
+        for (int i = 0; i < FORMAT_COUNT; i++)
+            if (formats[i].ready && formats[i].VAO == vao)
+                return formats[i].depthVAO;
+        return vao;
+    }
+
+    // Streaming
+
+    /**
+     * @brief (Re)create a format's stream with it's wanted capacity
+     *
+     * @param format The vertex format
+     */
+    void restream(VERTEX_FORMAT format)
+    {
+        __geometry_stream_t &st = streams[format];
+        uint stride = geometry::stride(format);
+
+        // Wait for the frames in flight, they may still read the old buffer
+        for (auto &fence : st.fences)
+        {
+            if (fence != 0)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+                glDeleteSync(fence);
+                fence = 0;
+            }
+        }
+
+        if (st.VBO != 0)
+        {
+            glstate::forget(st.VBO);
+            glDeleteBuffers(1, &st.VBO);
+        }
+        else
+        {
+            // (not while recording a trace, the writes to mapped memory can't be recorded)
+            st.persistent = debug::glextension("GL_ARB_buffer_storage") && !trace::recording;
+            glGenVertexArrays(1, &st.VAO);
+        }
+
+        st.capacity = std::max(st.wanted, initial_stream);
+        st.wanted = st.capacity;
+        st.frame = 0;
+        st.used = 0;
+
+        glGenBuffers(1, &st.VBO);
+        glstate::bind_buffer(GL_ARRAY_BUFFER, st.VBO);
+
+        if (st.persistent)
+        {
+            // One segment per frame in flight, written while the GPU reads the others
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            size_t size = sizeof(float) * stride * st.capacity * STREAM_FRAMES;
+
+            glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+            st.mapped = (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * stride * st.capacity, NULL, GL_STREAM_DRAW);
+            st.staging.resize(stride * st.capacity);
+        }
+
+        // The stream draws with the pool's indices
+        uint EBO = get(format).EBO;
+        attributes(st.VAO, st.VBO, format);
+        glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+        st.ready = true;
+    }
+
+    /**
+     * @brief Get space for a mesh's vertices in this frame's part of the stream (valid for one frame)
+     *
+     * @param format The vertex format
+     * @param count The number of vertices
+     * @param base_vertex The vertices' base vertex in the stream (output)
+     * @return Where to write the vertices (NULL if the stream is full, it grows after the frame)
+     */
+    float *stream(VERTEX_FORMAT format, uint count, uint &base_vertex)
+    {
+        __geometry_stream_t &st = streams[format];
+        if (!st.ready)
+            restream(format);
+
+        if (st.used + count > st.capacity)
+        {
+            st.wanted = std::max(st.wanted, std::max(st.capacity * 2, st.used + count));
+            return NULL;
+        }
+
+        uint stride = geometry::stride(format);
+        float *out;
+
+        if (st.persistent)
+        {
+            base_vertex = st.frame * st.capacity + st.used;
+            out = st.mapped + (size_t)stride * base_vertex;
+        }
+        else
+        {
+            base_vertex = st.used;
+            out = &st.staging[(size_t)stride * st.used];
+        }
+
+        st.used += count;
+        return out;
+    }
+
+    /**
+     * @brief Get a format's stream's vertex array
+     *
+     * @param format The vertex format
+     * @return The vertex array
+     */
+    uint streamarray(VERTEX_FORMAT format)
+    {
+        if (!streams[format].ready)
+            restream(format);
+        return streams[format].VAO;
+    }
+
+    /**
+     * @brief Send this frame's streamed vertices (call once per frame, before drawing)
+     */
+    void flush()
+    {
+        for (int i = 0; i < FORMAT_COUNT; i++)
+        {
+            __geometry_stream_t &st = streams[i];
+            if (!st.ready || st.persistent || st.used == 0)
+                continue;
+
+            // Re-specifying the buffer orphans the last frame's vertices (no waiting for the GPU)
+            uint stride = geometry::stride((VERTEX_FORMAT)i);
+            glstate::bind_buffer(GL_ARRAY_BUFFER, st.VBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * stride * st.capacity, NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * stride * st.used, st.staging.data());
+        }
+    }
+
+    /**
+     * @brief Move the streams to the next frame (call once per frame, after drawing)
+     */
+    void advance()
+    {
+        for (int i = 0; i < FORMAT_COUNT; i++)
+        {
+            __geometry_stream_t &st = streams[i];
+            if (!st.ready)
+                continue;
+
+            if (st.persistent)
+            {
+                // Fence this frame's segment & wait until the GPU is done with the next one
+                st.fences[st.frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                st.frame = (st.frame + 1) % STREAM_FRAMES;
+
+                GLsync &fence = st.fences[st.frame];
+                if (fence != 0)
+                {
+                    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                        ;
+                    glDeleteSync(fence);
+                    fence = 0;
+                }
+            }
+
+            st.used = 0;
+
+            if (st.wanted > st.capacity)
+                restream((VERTEX_FORMAT)i);
+        }
+    }
+
+    /**
+     * @brief Check if the driver can draw many meshes with one glMultiDrawElementsIndirect call
+     *
+     * @return is it supported?
+     */
+    bool indirect()
+    {
+        static int supported = -1;
+        if (supported < 0)
+            supported = debug::glextension("GL_ARB_multi_draw_indirect") &&
+                        debug::glextension("GL_ARB_draw_indirect") &&
+                        debug::glextension("GL_ARB_base_instance");
+        return supported;
+    }
+};
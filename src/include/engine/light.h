@@ -1,7 +1,25 @@
 // Lighting Library for the Game Engine
 #pragma once
 
+#include <vector>
+
 #include <tools/shader.h>
+#include <tools/glstate.h>
+
+#include <engine/clusters.h>
+#include <engine/shadows.h>
+
+// The size of the shader's light array (lights in use are set at runtime, see Light::setup())
+#define LIGHT_CAPACITY 128
+
+// The maximal number of lights with clustered shading (stored in a texture buffer)
+#define CLUSTER_CAPACITY 1024
+
+// The texture units of the clustered shading's buffers (light data, cluster grid, light indices)
+#define CLUSTER_UNIT 4
+
+// The uniform buffer binding point of the lights
+#define LIGHT_BINDING 0
 
 typedef enum
 {
@@ -11,40 +29,82 @@ typedef enum
     SPOT_LIGHT
 } LIGHT_TYPE;
 
+/**
+ * @brief One light, as laid out in the uniform buffer (std140, 6 * vec4)
+ */
+struct __light_t
+{
+    float position[4] = {0.0f, 0.0f, 0.0f, -1.0f};       // xyz, w: type
+    float direction[4] = {0.0f, -1.0f, 0.0f, 0.976f};    // xyz, w: cut-off (cosine)
+    float ambient[4] = {0.1f, 0.1f, 0.1f, 0.953f};       // rgb, w: outer cut-off (cosine)
+    float diffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};         // rgb, w: strength
+    float specular[4] = {1.0f, 1.0f, 1.0f, 0.0f};        // rgb, w: shadow range
+    float attenuation[4] = {1.0f, 0.09f, 0.032f, -1.0f}; // constant, linear, quadratic, w: shadow layer (-1 if none)
+};
+
 /**
  * @brief The Light manager class
- * @details Manages lights and shadows in a shader
+ * @details Manages lights and shadows in a shader. The lights are kept in a packed array
+ * and uploaded into a uniform buffer by update(), only the changed range is sent.
+ * With clustered shading the lights go into a texture buffer instead and cluster() assigns
+ * them to the froxels of the view, so every fragment only loops over the lights near it.
  * @warning Only works with shaders made for this class
  */
 class Light
 {
 private:
-    uint MAX_LIGHTS = 0;
+    uint MAX_LIGHTS = 0; // lights in use
+    uint capacity = LIGHT_CAPACITY;
+
+    std::vector<__light_t> lights;
+    uint ubo = 0;
+
+    // Clustered Shading: buffers & their textures (light data, cluster grid, light indices)
+    bool clustered = false;
+    uint buffers[3] = {0, 0, 0};
+    uint textures[3] = {0, 0, 0};
+
+    std::vector<uint> ids; // the light index of the assigned lights
+    clustergrid grid;
+    clusterlist assigned;
+    int range_location = -1, screen_location = -1; // clusterRange & screenSize (set every frame)
+
+    // The changed range (-1 if nothing changed) & the light count
+    int dirty_first = -1, dirty_last = -1;
+    bool count_dirty = true;
+
+    __light_t &touch(int n);
 
 public:
     gls s;
 
-    void setup(std::string path, uint max_lights = 4);
+    void setup(std::string path, uint max_lights = 4, bool clustered = false);
     void update();
+    void cluster(mat4 view, mat4 projection, float near, float far, int width, int height, Workers *workers = NULL);
+
+    void set_count(uint max_lights);
 
     void set_state(int n, LIGHT_TYPE en);
     void set_pos(int n, vec3 pos);
     void set_dir(int n, vec3 dir);
     void set_strength(int n, float strength);
-    // TODO: Use Shadows
+    void set_color(int n, vec3 ambient, vec3 diffuse, vec3 specular);
+    void set_attenuation(int n, float constant, float linear, float quadratic);
+    void set_cutoff(int n, float inner, float outer);
+    void set_shadow(int n, int layer, float range);
 };
 
 /**
  * @brief Setup the Light manager & load the shader
  *
  * @param path
+ * @param max_lights The number of lights in use (can be changed later, see set_count())
+ * @param clustered use clustered shading? (set Engine::lights, or call cluster() every frame)
  */
-void Light::setup(std::string path, uint max_lights)
+void Light::setup(std::string path, uint max_lights, bool clustered)
 {
-    if (max_lights < 1)
-        debug::error("light::setup()", "light num must be an unsigned integer (non-zero)"); // TODO: Think about merging lighting into the shader lib, max_lights=0 disables lighting for shader
-
-    MAX_LIGHTS = max_lights;
+    this->clustered = clustered;
+    this->capacity = clustered ? CLUSTER_CAPACITY : LIGHT_CAPACITY;
 
     std::string vertex, fragment;
 
@@ -68,53 +128,319 @@ void Light::setup(std::string path, uint max_lights)
         std::string line;
         while (getline(f, line))
         {
-            if (isin(line, "#define MAX_LIGHTS"))
-                fragment += "#define MAX_LIGHTS " + itos(MAX_LIGHTS) + "\n";
-            else
-                fragment += line + "\n";
+            fragment += line + "\n";
         }
     }
     else
         debug::error("light::setup()", "can't open shader file", (path + ".fs").c_str());
 
+    if (clustered)
+        fragment = shader::define(fragment, {"MAX_LIGHTS " + itos(LIGHT_CAPACITY), "MAX_CASCADES " + itos(CASCADE_COUNT), "CLUSTERED"});
+    else
+        fragment = shader::define(fragment, {"MAX_LIGHTS " + itos(LIGHT_CAPACITY), "MAX_CASCADES " + itos(CASCADE_COUNT)});
+
     s = shader::load_raw(vertex.c_str(), fragment.c_str());
+    lights.assign(capacity, __light_t());
 
+    // The shadows (see Shadows, the cascades' block is uploaded by Shadows::render())
     shader::use(s);
-    for (int i = 0; i < MAX_LIGHTS; i++)
-        shader::set(s, "light[" + itos(i) + "].enabled", false);
+    shader::set(s, "shadowAtlas", SHADOW_UNIT);
+    shader::set(s, "cascadeMap", CASCADE_UNIT);
+
+    uint cascades = glGetUniformBlockIndex(s, "Cascades");
+    if (cascades != GL_INVALID_INDEX)
+        glUniformBlockBinding(s, cascades, CASCADE_BINDING);
+
+    if (clustered)
+    {
+        // {Light light[CLUSTER_CAPACITY]} as RGBA32F, {offset, count} per cluster as RG32UI, indices as R32UI
+        GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        const char *names[3] = {"lightData", "clusterGrid", "clusterIndices"};
+
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+
+        shader::use(s);
+        for (int i = 0; i < 3; i++)
+        {
+            glstate::bind_buffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, i == 0 ? sizeof(__light_t) * capacity : 0, NULL, GL_DYNAMIC_DRAW);
+
+            glstate::bind_texture(GL_TEXTURE_BUFFER, textures[i], CLUSTER_UNIT + i);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+
+            shader::set(s, names[i], CLUSTER_UNIT + i);
+        }
+
+        shader::set(s, "clusterDims", (vec3){(float)grid.x, (float)grid.y, (float)grid.z});
+        range_location = glGetUniformLocation(s, "clusterRange");
+        screen_location = glGetUniformLocation(s, "screenSize");
+    }
+    else
+    {
+        // Connect the shader's light block to the binding point
+        uint block = glGetUniformBlockIndex(s, "Lights");
+        if (block != GL_INVALID_INDEX)
+            glUniformBlockBinding(s, block, LIGHT_BINDING);
+        else
+            debug::warning("light::setup()", "shader has no light block", path.c_str());
+
+        // {int count; Light light[LIGHT_CAPACITY];}
+        glGenBuffers(1, &ubo);
+        glstate::bind_buffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, 16 + sizeof(__light_t) * LIGHT_CAPACITY, NULL, GL_DYNAMIC_DRAW);
+    }
+
+    set_count(max_lights);
+    dirty_first = 0;
+    dirty_last = capacity - 1;
+
+    update();
 }
 
 /**
- * @brief Update the lights
+ * @brief Upload the changed lights (call once per frame)
  */
 void Light::update()
 {
+    if (clustered)
+    {
+        // The light count isn't needed, cluster() only assigns the lights in use
+        if (dirty_first >= 0)
+        {
+            glstate::bind_buffer(GL_TEXTURE_BUFFER, buffers[0]);
+            glBufferSubData(GL_TEXTURE_BUFFER, sizeof(__light_t) * dirty_first,
+                            sizeof(__light_t) * (dirty_last - dirty_first + 1), &lights[dirty_first]);
+            dirty_first = dirty_last = -1;
+        }
+        return;
+    }
+
+    if (ubo == 0)
+        return;
+
+    glstate::bind_buffer(GL_UNIFORM_BUFFER, ubo);
+
+    if (count_dirty)
+    {
+        int header[4] = {(int)MAX_LIGHTS, 0, 0, 0};
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(header), header);
+        count_dirty = false;
+    }
+
+    if (dirty_first >= 0)
+    {
+        glBufferSubData(GL_UNIFORM_BUFFER, 16 + sizeof(__light_t) * dirty_first,
+                        sizeof(__light_t) * (dirty_last - dirty_first + 1), &lights[dirty_first]);
+        dirty_first = dirty_last = -1;
+    }
+
+    glstate::bind_buffer_base(GL_UNIFORM_BUFFER, LIGHT_BINDING, ubo);
+}
+
+/**
+ * @brief Assign the lights to the clusters of the view (every frame, with clustered shading)
+ * @details Engine::render() calls it with the drawn camera & resolution when the lights are set as Engine::lights
+ *
+ * @param view The camera's view matrix
+ * @param projection The camera's projection matrix (symmetric perspective)
+ * @param near The camera's near
+ * @param far The camera's far
+ * @param width The drawn width (the scaled one with dynamic resolution)
+ * @param height The drawn height
+ * @param workers The threads to split the assignment between (ex. &Engine::workers, NULL - the calling thread)
+ */
+void Light::cluster(mat4 view, mat4 projection, float near, float far, int width, int height, Workers *workers)
+{
+    if (!clustered)
+        return;
+
+    grid.near = near;
+    grid.far = far;
+    grid.scale_x = projection.m[0][0];
+    grid.scale_y = projection.m[1][1];
+
+    // Prepare the lights in use (view-space)
+    std::vector<clusterlight> prepared;
+    ids.clear();
+
+    for (uint i = 0; i < MAX_LIGHTS; i++)
+    {
+        const __light_t &l = lights[i];
+        int type = (int)l.position[3];
+        if (type < DIR_LIGHT)
+            continue;
+
+        clusterlight c;
+        c.position = matrix::multiplyvec(view, {l.position[0], l.position[1], l.position[2]});
+
+        float brightness = fmaxf(l.diffuse[0], fmaxf(l.diffuse[1], l.diffuse[2])) * l.diffuse[3];
+        c.radius = clusters::radius(l.attenuation[0], l.attenuation[1], l.attenuation[2], brightness);
+        c.global = type == DIR_LIGHT || c.radius < 0.0f;
+
+        prepared.push_back(c);
+        ids.push_back(i);
+    }
+
+    assigned = clusters::assign(grid, prepared, workers);
+    for (auto &index : assigned.indices)
+        index = ids[index];
+
+    // Upload (re-specifying the buffers orphans the last frame's data)
+    glstate::bind_buffer(GL_TEXTURE_BUFFER, buffers[1]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(uint) * assigned.grid.size(), assigned.grid.data(), GL_STREAM_DRAW);
+    glstate::bind_buffer(GL_TEXTURE_BUFFER, buffers[2]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(uint) * assigned.indices.size(), assigned.indices.data(), GL_STREAM_DRAW);
+
+    for (int i = 0; i < 3; i++)
+        glstate::bind_texture(GL_TEXTURE_BUFFER, textures[i], CLUSTER_UNIT + i);
+
+    shader::use(s);
+    glUniform2f(range_location, grid.near, grid.far);
+    glUniform2f(screen_location, (float)width, (float)height);
+}
+
+/**
+ * @brief Get a light for changing (marks it as changed)
+ *
+ * @param n The light's index
+ * @return The light
+ */
+__light_t &Light::touch(int n)
+{
+    if (dirty_first < 0 || n < dirty_first)
+        dirty_first = n;
+    if (n > dirty_last)
+        dirty_last = n;
+
+    return lights[n];
+}
+
+/**
+ * @brief Set the number of lights in use (no shader recompile)
+ *
+ * @param max_lights The number of lights (1 - LIGHT_CAPACITY, or CLUSTER_CAPACITY with clustered shading)
+ */
+void Light::set_count(uint max_lights)
+{
+    if (max_lights < 1)
+        debug::error("light::setup()", "light num must be an unsigned integer (non-zero)"); // TODO: Think about merging lighting into the shader lib, max_lights=0 disables lighting for shader
+
+    if (max_lights > capacity)
+    {
+        debug::warning("light::set_count()", "too many lights", ("max " + itos(capacity)).c_str());
+        max_lights = capacity;
+    }
+
+    MAX_LIGHTS = max_lights;
+    count_dirty = true;
 }
 
 void Light::set_state(int n, LIGHT_TYPE en)
 {
     n = clamp(n, 0, MAX_LIGHTS - 1);
 
-    shader::set(s, "light[" + itos(n) + "].type", en);
+    touch(n).position[3] = (float)en;
 }
 
 void Light::set_pos(int n, vec3 pos)
 {
     n = clamp(n, 0, MAX_LIGHTS - 1);
 
-    shader::set(s, "light[" + itos(n) + "].position", pos);
+    __light_t &l = touch(n);
+    l.position[0] = pos.x;
+    l.position[1] = pos.y;
+    l.position[2] = pos.z;
 }
 
 void Light::set_dir(int n, vec3 dir)
 {
     n = clamp(n, 0, MAX_LIGHTS - 1);
 
-    shader::set(s, "light[" + itos(n) + "].direction", dir);
+    __light_t &l = touch(n);
+    l.direction[0] = dir.x;
+    l.direction[1] = dir.y;
+    l.direction[2] = dir.z;
 }
 
 void Light::set_strength(int n, float strength)
 {
     n = clamp(n, 0, MAX_LIGHTS - 1);
 
-    shader::set(s, "light[" + itos(n) + "].strength", strength);
+    touch(n).diffuse[3] = strength;
 }
+
+/**
+ * @brief Set a light's colors
+ *
+ * @param n The light's index
+ * @param ambient The ambient color
+ * @param diffuse The diffuse color
+ * @param specular The specular color
+ */
+void Light::set_color(int n, vec3 ambient, vec3 diffuse, vec3 specular)
+{
+    n = clamp(n, 0, MAX_LIGHTS - 1);
+
+    __light_t &l = touch(n);
+    l.ambient[0] = ambient.x;
+    l.ambient[1] = ambient.y;
+    l.ambient[2] = ambient.z;
+    l.diffuse[0] = diffuse.x;
+    l.diffuse[1] = diffuse.y;
+    l.diffuse[2] = diffuse.z;
+    l.specular[0] = specular.x;
+    l.specular[1] = specular.y;
+    l.specular[2] = specular.z;
+}
+
+/**
+ * @brief Set a (point or spot) light's attenuation
+ *
+ * @param n The light's index
+ * @param constant The constant term
+ * @param linear The linear term
+ * @param quadratic The quadratic term
+ */
+void Light::set_attenuation(int n, float constant, float linear, float quadratic)
+{
+    n = clamp(n, 0, MAX_LIGHTS - 1);
+
+    __light_t &l = touch(n);
+    l.attenuation[0] = constant;
+    l.attenuation[1] = linear;
+    l.attenuation[2] = quadratic;
+}
+
+/**
+ * @brief Set a spot light's cone
+ *
+ * @param n The light's index
+ * @param inner The inner angle (in degrees)
+ * @param outer The outer angle (in degrees)
+ */
+void Light::set_cutoff(int n, float inner, float outer)
+{
+    n = clamp(n, 0, MAX_LIGHTS - 1);
+
+    __light_t &l = touch(n);
+    l.direction[3] = cosf(radians(inner));
+    l.ambient[3] = cosf(radians(outer));
+}
+
+/**
+ * @brief Set a light's shadow
+ * @details Directional lights use the cascades (any layer >= 0 turns them on, see Shadows::sun())
+ *
+ * @param n The light's index
+ * @param layer The shadow's first layer in the atlas (see Shadows::layer(), -1 for no shadow)
+ * @param range The shadow's range (same as in Shadows::add())
+ */
+void Light::set_shadow(int n, int layer, float range)
+{
+    n = clamp(n, 0, MAX_LIGHTS - 1);
+
+    __light_t &l = touch(n);
+    l.attenuation[3] = (float)layer;
+    l.specular[3] = range;
+}
\ No newline at end of file
@@ -2,10 +2,67 @@
 #pragma once
 
 #include <tools/loadin.h>
+#include <engine/geometry.h>
 #include <lua/lua.hpp>
 
 #define lualib "res/scripts/libs/class.lua"
 
+/**
+ * @brief An uploaded mesh (shared by the objects with the same mesh data & by copies of objects)
+ */
+struct __mesh_upload_t
+{
+    gpumesh gpu;
+    int users;    // objects drawing it (it's space is freed with the last one)
+    uint64_t key; // the mesh data's key (0 if it was changed, so it can't be shared anymore)
+};
+
+std::map<uint, __mesh_upload_t> __mesh_uploads; // by gpumesh id
+std::map<uint64_t, uint> __mesh_keys;           // the shareable uploads' ids, by the mesh data's key
+
+/**
+ * @brief An object's use of an upload (copying it counts a new user, destroying it frees the upload after the last user)
+ */
+struct __mesh_user_t
+{
+    uint id = 0; // the upload's gpumesh id (0 if none)
+
+    __mesh_user_t() {}
+    __mesh_user_t(const __mesh_user_t &u) { set(u.id); }
+    __mesh_user_t &operator=(const __mesh_user_t &u)
+    {
+        set(u.id);
+        return *this;
+    }
+    ~__mesh_user_t() { set(0); }
+
+    void set(uint upload);
+};
+
+/**
+ * @brief Use another upload (the old one is freed, if this was it's last user)
+ *
+ * @param upload The upload's gpumesh id (0 - none)
+ */
+void __mesh_user_t::set(uint upload)
+{
+    // The new one first, so setting the same upload keeps it
+    auto it = __mesh_uploads.find(upload);
+    if (it != __mesh_uploads.end())
+        it->second.users++;
+
+    it = __mesh_uploads.find(this->id);
+    if (it != __mesh_uploads.end() && --it->second.users <= 0)
+    {
+        if (it->second.key != 0)
+            __mesh_keys.erase(it->second.key);
+        geometry::release(it->second.gpu);
+        __mesh_uploads.erase(it);
+    }
+
+    this->id = upload;
+}
+
 /**
  * @brief Object for [bodies], [scripts], [audio sources], [lights], etc.
  */
@@ -62,6 +119,57 @@ private:
         lua_pop(L, 2);
     }
 
+    // The interleaved vertices (kept, so changes are written in place, see write())
+    std::vector<float> local;
+    int changed_first = -1, changed_last = -1; // the changed vertices (-1 if none)
+    bool streamed = false;                     // drawn from the stream this frame?
+
+    void interleave()
+    {
+        uint count = this->m.tris * 3;
+        this->local.resize(count * 8);
+
+        float *v = this->local.data();
+        for (uint i = 0; i < count; i++, v += 8)
+        {
+            v[0] = this->m.vertices[i * 3];
+            v[1] = this->m.vertices[i * 3 + 1];
+            v[2] = this->m.vertices[i * 3 + 2];
+
+            v[3] = this->m.texcoords[i * 2];
+            v[4] = this->m.texcoords[i * 2 + 1];
+
+            v[5] = this->m.normals[i * 3];
+            v[6] = this->m.normals[i * 3 + 1];
+            v[7] = this->m.normals[i * 3 + 2];
+        }
+    }
+
+    void upload()
+    {
+        interleave();
+        std::vector<uint> indices;
+
+        for (int i = 0; i < this->m.tris * 3; i++)
+            indices.push_back(i);
+
+        // Place the mesh in the geometry pool (it's own upload, the old one is freed after it's last user)
+        this->gpu = geometry::alloc(FORMAT_PNT, this->m.tris * 3, indices.size());
+        this->VAO = geometry::vertexarray(FORMAT_PNT);
+        this->base_vertex = this->gpu.base_vertex;
+
+        __mesh_uploads[this->gpu.id] = {this->gpu, 0, 0};
+        this->user.set(this->gpu.id);
+
+        if (!indices.empty())
+        {
+            geometry::vertices(this->gpu, &this->local[0], 0, this->gpu.vertices);
+            geometry::indices(this->gpu, &indices[0]);
+        }
+    }
+
+    bool unshare();
+
 public:
     // Properties
     bool script = false;   // has a script ?
@@ -70,14 +178,21 @@ public:
 
     bool drawable = false; // is drawable ?
     bool textured = false; // is textured ?
+    bool occluder = false; // hides the objects behind it ? (for big, simple meshes, like walls)
+    bool caster = true;    // casts shadows ?
 
     bool physical = false; // is physical ?
     bool gravity = false;  // has gravity ?
 
     lua_State *L;
 
-    mesh m, c;          // Main and Collider Mesh
-    uint VAO, VBO, EBO; // rendering objects
+    mesh m, c;            // Main and Collider Mesh
+    uint VAO = 0;         // vertex array (shared by every mesh of the vertex format)
+    gpumesh gpu;          // place in the geometry pool
+    __mesh_user_t user;   // the upload it draws (see __mesh_uploads)
+
+    bool dynamic = false; // streamed every frame ? (for meshes that change every frame, see write())
+    uint base_vertex = 0; // the drawn vertices' base vertex (in the pool or in the stream)
 
     float tmc = 0.0f; // texture-mix-color
 
@@ -89,6 +204,12 @@ public:
 
     vec3 position, rotation;
 
+    // Rendering
+    int proxy = -1;    // render proxy's index (-1 if it has none)
+    bool dirty = true; // render data changed since the last sync ?
+
+    vec3 synced_position, synced_rotation; // transform at the last sync
+
     // Functions
     void add(vec3 colour);
     void add(texture t);
@@ -98,21 +219,28 @@ public:
 
     void pusharray();
 
+    float *write(uint first, uint count);
+    void write(uint i, vec3 position, vec2 texcoord, vec3 normal);
+    void stream();
+
     void update(float deltaTime, int millis);
     void destroy();
 
+    bool changed();
     mat4 model();
 };
 
 void object::add(vec3 colour)
 {
     this->color = colour; // oh, no
+    this->dirty = true;
 }
 
 void object::add(texture t)
 {
     this->textured = true;
     this->tex = t;
+    this->dirty = true;
 }
 
 /**
@@ -152,53 +280,36 @@ void object::add(mesh m, bool draw)
 {
     this->m = m;
     this->body = true;
+    this->dirty = true;
+
+    // Meshes that weren't loaded from a file have no bounds yet
+    if (this->m.radius == 0.0f && this->m.tris > 0)
+        loadin::bounds(this->m);
 
     // Setup for rendering, if drawable
     if (draw)
     {
         if (this->body)
         {
-            std::vector<float> vertices;
-            std::vector<uint> indices;
+            // Objects with the same mesh data share the GPU buffers (so they can be instanced)
+            uint64_t key = hash(this->m.vertices.data(), sizeof(float) * this->m.vertices.size());
+            key = hash(this->m.texcoords.data(), sizeof(float) * this->m.texcoords.size(), key);
+            key = hash(this->m.normals.data(), sizeof(float) * this->m.normals.size(), key);
 
-            for (int i = 0; i < this->m.tris * 3; i++)
+            auto it = __mesh_keys.find(key);
+            if (it != __mesh_keys.end())
             {
-                vertices.push_back(this->m.vertices[i * 3]);
-                vertices.push_back(this->m.vertices[i * 3 + 1]);
-                vertices.push_back(this->m.vertices[i * 3 + 2]);
-
-                vertices.push_back(this->m.texcoords[i * 2]);
-                vertices.push_back(this->m.texcoords[i * 2 + 1]);
-
-                vertices.push_back(this->m.normals[i * 3]);
-                vertices.push_back(this->m.normals[i * 3 + 1]);
-                vertices.push_back(this->m.normals[i * 3 + 2]);
-
-                indices.push_back(i);
+                this->gpu = __mesh_uploads[it->second].gpu;
+                this->VAO = geometry::vertexarray(this->gpu.format);
+                this->base_vertex = this->gpu.base_vertex;
+                this->user.set(this->gpu.id);
+            }
+            else
+            {
+                upload();
+                __mesh_uploads[this->gpu.id].key = key;
+                __mesh_keys[key] = this->gpu.id;
             }
-
-            // Lock Mesh
-            glGenVertexArrays(1, &this->VAO);
-            glGenBuffers(1, &this->VBO);
-            glGenBuffers(1, &this->EBO);
-
-            glBindVertexArray(this->VAO);
-
-            glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
-
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * indices.size(), &indices[0], GL_STATIC_DRAW);
-
-            // vertex positions
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void *)(0 * sizeof(float)));
-            // vertex texture coords
-            glEnableVertexAttribArray(2);
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void *)(3 * sizeof(float)));
-            // vertex normals
-            glEnableVertexAttribArray(1);
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void *)(5 * sizeof(float)));
 
             this->drawable = draw;
         }
@@ -222,32 +333,157 @@ void object::add(mesh c, bool physical, bool gravity)
 }
 
 /**
- * @brief Update the GPU's array with the mesh data (Fairly slow -> shouldn't be used frequently)
+ * @brief Give the object it's own copy of a shared mesh (before changing it)
+ *
+ * @return did it get a new copy? (it already has the current mesh data)
+ */
+bool object::unshare()
+{
+    auto it = __mesh_uploads.find(this->user.id);
+    if (it == __mesh_uploads.end())
+        return false;
+
+    if (it->second.users > 1)
+    {
+        upload();
+        this->dirty = true;
+        return true;
+    }
+
+    // The only user changes it, so the objects added later with the old data can't share it
+    if (it->second.key != 0)
+    {
+        __mesh_keys.erase(it->second.key);
+        it->second.key = 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Update the GPU's array with the mesh data (uploads every vertex, use write() for small or frequent changes)
  */
 void object::pusharray()
 {
-    std::vector<float> vertices;
-    std::vector<uint> indices;
+    // The mesh data changed, so it can't be shared anymore
+    if (unshare())
+        return;
 
-    for (int i = 0; i < this->m.tris * 3; i++)
+    // The vertex count changed, so it doesn't fit in it's old place
+    if (this->gpu.id == 0 || this->gpu.vertices != (uint)this->m.tris * 3)
     {
-        vertices.push_back(this->m.vertices[i * 3]);
-        vertices.push_back(this->m.vertices[i * 3 + 1]);
-        vertices.push_back(this->m.vertices[i * 3 + 2]);
+        upload();
+        this->dirty = true;
+        return;
+    }
 
-        vertices.push_back(this->m.texcoords[i * 2]);
-        vertices.push_back(this->m.texcoords[i * 2 + 1]);
+    interleave();
 
-        vertices.push_back(this->m.normals[i * 3]);
-        vertices.push_back(this->m.normals[i * 3 + 1]);
-        vertices.push_back(this->m.normals[i * 3 + 2]);
+    // Update Arrays (dynamic objects are streamed by the engine)
+    this->changed_first = 0;
+    this->changed_last = this->gpu.vertices - 1;
+    if (!this->dynamic)
+        stream();
+}
+
+/**
+ * @brief Change vertices in place (interleaved: position (3), texcoord (2), normal (3) per vertex)
+ * @details Only the changed range is uploaded (by the engine, see stream()), the mesh (m) isn't changed
+ *
+ * @param first The first vertex
+ * @param count The number of vertices
+ * @return The vertices (count * 8 floats, NULL if out of range)
+ */
+float *object::write(uint first, uint count)
+{
+    if (this->gpu.id == 0 || first + count > this->gpu.vertices)
+        return NULL;
+
+    unshare();
+    if (this->local.size() != this->gpu.vertices * 8)
+        interleave();
 
-        indices.push_back(i);
+    if (this->changed_first < 0 || (int)first < this->changed_first)
+        this->changed_first = first;
+    if ((int)(first + count) - 1 > this->changed_last)
+        this->changed_last = first + count - 1;
+
+    return &this->local[first * 8];
+}
+
+/**
+ * @brief Change one vertex in place (also changes the mesh)
+ *
+ * @param i The vertex
+ * @param position The position
+ * @param texcoord The texture coordinate
+ * @param normal The normal
+ */
+void object::write(uint i, vec3 position, vec2 texcoord, vec3 normal)
+{
+    float *v = write(i, 1);
+    if (v == NULL)
+        return;
+
+    v[0] = this->m.vertices[i * 3] = position.x;
+    v[1] = this->m.vertices[i * 3 + 1] = position.y;
+    v[2] = this->m.vertices[i * 3 + 2] = position.z;
+
+    v[3] = this->m.texcoords[i * 2] = texcoord.x;
+    v[4] = this->m.texcoords[i * 2 + 1] = texcoord.y;
+
+    v[5] = this->m.normals[i * 3] = normal.x;
+    v[6] = this->m.normals[i * 3 + 1] = normal.y;
+    v[7] = this->m.normals[i * 3 + 2] = normal.z;
+}
+
+/**
+ * @brief Upload the changed vertices (called by the engine every frame)
+ * @details Dynamic objects are copied into the vertex stream every frame (no waiting for the GPU),
+ * the others send only their changed range into the geometry pool
+ */
+void object::stream()
+{
+    if (this->gpu.id == 0)
+        return;
+
+    if (this->dynamic)
+    {
+        if (this->local.size() != this->gpu.vertices * 8)
+            interleave();
+
+        uint base;
+        float *out = geometry::stream(this->gpu.format, this->gpu.vertices, base);
+        if (out != NULL)
+        {
+            memcpy(out, this->local.data(), sizeof(float) * this->local.size());
+
+            this->VAO = geometry::streamarray(this->gpu.format);
+            this->base_vertex = base;
+            this->streamed = true;
+            this->dirty = true;
+
+            this->changed_first = this->changed_last = -1;
+            return;
+        }
     }
 
-    // Update Arrays
-    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    // Back to the pool (it missed the changes while streamed)
+    if (this->streamed)
+    {
+        this->changed_first = 0;
+        this->changed_last = this->gpu.vertices - 1;
+
+        this->VAO = geometry::vertexarray(this->gpu.format);
+        this->base_vertex = this->gpu.base_vertex;
+        this->streamed = false;
+        this->dirty = true;
+    }
+
+    if (this->changed_first >= 0)
+    {
+        geometry::vertices(this->gpu, &this->local[this->changed_first * 8], this->changed_first, this->changed_last - this->changed_first + 1);
+        this->changed_first = this->changed_last = -1;
+    }
 }
 
 /**
@@ -299,6 +535,23 @@ void object::destroy()
         if (lua_pcall(L, 0, 0, 0) != LUA_OK)
             debug::warning("object::destroy()", "script runtime error", lua_tostring(L, -1));
     }
+
+    // Free it's place in the geometry pool (after the last object that draws it)
+    this->user.set(0);
+    this->gpu = gpumesh();
+    this->drawable = false;
+    this->dirty = true;
+}
+
+/**
+ * @brief Check if the object's render data changed since the last sync
+ * @details Call with dirty = true after changing the color, tmc or texture directly
+ *
+ * @return has it changed?
+ */
+bool object::changed()
+{
+    return this->dirty || this->position != this->synced_position || this->rotation != this->synced_rotation;
 }
 
 /**
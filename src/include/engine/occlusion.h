@@ -0,0 +1,416 @@
+// Occlusion Culling for the Game Engine
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <tools/types.h>
+
+// The resolution of the depth buffer (the width must be a multiple of 4)
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+
+// The size of the hierarchical tiles (in pixels)
+#define OCCLUSION_TILE 8
+
+// The occluders are rasterized with a border around the screen (so the edges' pixels have neighbours, see Occlusion::finish())
+#define OCCLUSION_BORDER_X 4 // (keeps the rows aligned to 4 pixels)
+#define OCCLUSION_BORDER_Y 1
+#define OCCLUSION_RASTER_WIDTH (OCCLUSION_WIDTH + 2 * OCCLUSION_BORDER_X)
+#define OCCLUSION_RASTER_HEIGHT (OCCLUSION_HEIGHT + 2 * OCCLUSION_BORDER_Y)
+
+/**
+ * @brief An object that hides the objects behind it
+ */
+struct __occluder_t
+{
+    uint proxy;                  // the object's render proxy
+    std::vector<float> vertices; // {x, y, z} * 3 = tri (local space, the renderer's copy)
+};
+
+/**
+ * @brief A CPU occlusion culler
+ * @details Selected occluders are rasterized into a small software depth buffer, then the bounding boxes of
+ * the other objects are tested against it. Every tile keeps the farthest depth of it's pixels, so most boxes
+ * are accepted (or rejected) without touching the pixels. Runs on the CPU only, so the results are deterministic.
+ * The occluders are sampled at the pixels' centers, then every pixel takes the farthest depth of it's 3x3 neighbours,
+ * so a pixel is only covered if the occluders cover all of it (the low resolution never hides a visible object).
+ */
+class Occlusion
+{
+private:
+    std::vector<float> raster; // the sampled occluders (with the border)
+    std::vector<float> depth;  // per pixel, the conservative depth (0 - 1, 1 is empty)
+    std::vector<float> tiles;  // per tile, the farthest depth
+
+    std::vector<__occluder_t> list;
+    mat4 viewproj;
+
+    void triangle(vec3 a, vec3 b, vec3 c);
+
+public:
+    bool enabled = true;
+
+    // Statistics of the last frame
+    uint occluders = 0; // rasterized occluders
+    uint tested = 0;    // tested boxes
+    uint occluded = 0;  // hidden boxes
+    float time = 0.0f;  // CPU time (in milliseconds)
+
+    void add(uint proxy, const std::vector<float> &vertices, bool changed = true);
+    void remove(uint proxy);
+    const std::vector<__occluder_t> &all();
+
+    void begin(mat4 vp);
+    void rasterize(const std::vector<float> &vertices, mat4 model);
+    void finish();
+
+    bool visible(vec3 min, vec3 max);
+    bool test(vec3 min, vec3 max) const;
+    float at(int x, int y);
+};
+
+/**
+ * @brief Register an occluder (or update it's mesh)
+ * @details The triangles are copied, so the simulation can change the mesh while a frame is drawn
+ *
+ * @param proxy The occluder's render proxy
+ * @param vertices The occluder's triangles
+ * @param changed Did the mesh change since the last add()? (else a registered occluder keeps it's copy)
+ */
+void Occlusion::add(uint proxy, const std::vector<float> &vertices, bool changed)
+{
+    for (auto &o : list)
+    {
+        if (o.proxy == proxy)
+        {
+            if (changed)
+                o.vertices = vertices;
+            return;
+        }
+    }
+    list.push_back({proxy, vertices});
+}
+
+/**
+ * @brief Unregister an occluder
+ *
+ * @param proxy The occluder's render proxy
+ */
+void Occlusion::remove(uint proxy)
+{
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        if (list[i].proxy == proxy)
+        {
+            list.erase(list.begin() + i);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Get the registered occluders
+ *
+ * @return The occluders
+ */
+const std::vector<__occluder_t> &Occlusion::all()
+{
+    return list;
+}
+
+/**
+ * @brief Start a frame (clears the depth buffer)
+ *
+ * @param vp The camera's view-projection matrix (view * projection)
+ */
+void Occlusion::begin(mat4 vp)
+{
+    raster.assign(OCCLUSION_RASTER_WIDTH * OCCLUSION_RASTER_HEIGHT, 1.0f);
+    depth.assign(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+    tiles.assign((OCCLUSION_WIDTH / OCCLUSION_TILE) * (OCCLUSION_HEIGHT / OCCLUSION_TILE), 1.0f);
+
+    viewproj = vp;
+
+    occluders = 0;
+    tested = 0;
+    occluded = 0;
+}
+
+/**
+ * @brief Rasterize one triangle (x, y in the raster, with the border, and depth)
+ *
+ * @param a The first corner
+ * @param b The second corner
+ * @param c The third corner
+ */
+void Occlusion::triangle(vec3 a, vec3 b, vec3 c)
+{
+    // Counter-clockwise winding (occluders are double-sided)
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area == 0.0f)
+        return;
+    if (area < 0.0f)
+    {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    int minx = std::max(0, (int)floorf(std::min({a.x, b.x, c.x})));
+    int maxx = std::min(OCCLUSION_RASTER_WIDTH - 1, (int)ceilf(std::max({a.x, b.x, c.x})));
+    int miny = std::max(0, (int)floorf(std::min({a.y, b.y, c.y})));
+    int maxy = std::min(OCCLUSION_RASTER_HEIGHT - 1, (int)ceilf(std::max({a.y, b.y, c.y})));
+    if (minx > maxx || miny > maxy)
+        return;
+
+    minx &= ~3; // rows are processed 4 pixels at a time
+
+    // Edge functions: e(x, y) = A * x + B * y + C (positive inside)
+    float A0 = b.y - c.y, B0 = c.x - b.x, C0 = b.x * c.y - b.y * c.x;
+    float A1 = c.y - a.y, B1 = a.x - c.x, C1 = c.x * a.y - c.y * a.x;
+    float A2 = a.y - b.y, B2 = b.x - a.x, C2 = a.x * b.y - a.y * b.x;
+
+    float inv = 1.0f / area;
+
+    for (int y = miny; y <= maxy; y++)
+    {
+        float py = y + 0.5f;
+        float *row = &raster[y * OCCLUSION_RASTER_WIDTH];
+
+#if defined(__SSE2__)
+        __m128 px = _mm_add_ps(_mm_set1_ps(minx + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+        __m128 step = _mm_set1_ps(4.0f);
+        __m128 zero = _mm_setzero_ps();
+
+        for (int x = minx; x <= maxx; x += 4)
+        {
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A0), px), _mm_set1_ps(B0 * py + C0));
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A1), px), _mm_set1_ps(B1 * py + C1));
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A2), px), _mm_set1_ps(B2 * py + C2));
+
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+            if (_mm_movemask_ps(inside) != 0)
+            {
+                __m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(a.z)), _mm_mul_ps(w1, _mm_set1_ps(b.z))),
+                                                 _mm_mul_ps(w2, _mm_set1_ps(c.z))),
+                                      _mm_set1_ps(inv));
+
+                __m128 old = _mm_loadu_ps(&row[x]);
+                __m128 nearer = _mm_min_ps(old, z);
+                _mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+
+            px = _mm_add_ps(px, step);
+        }
+#else
+        for (int x = minx; x <= maxx; x++)
+        {
+            float px = x + 0.5f;
+            float w0 = A0 * px + B0 * py + C0;
+            float w1 = A1 * px + B1 * py + C1;
+            float w2 = A2 * px + B2 * py + C2;
+
+            if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+            {
+                float z = (w0 * a.z + w1 * b.z + w2 * c.z) * inv;
+                row[x] = std::min(row[x], z);
+            }
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Rasterize an occluder
+ *
+ * @param vertices The occluder's triangles ({x, y, z} * 3 = tri)
+ * @param model The occluder's model matrix
+ */
+void Occlusion::rasterize(const std::vector<float> &vertices, mat4 model)
+{
+    mat4 mvp = model * viewproj;
+
+    for (size_t i = 0; i + 8 < vertices.size(); i += 9)
+    {
+        vec3 s[3];
+        bool clipped = false;
+
+        for (int k = 0; k < 3; k++)
+        {
+            vec3 v = {vertices[i + k * 3], vertices[i + k * 3 + 1], vertices[i + k * 3 + 2]};
+            vec3 clip = matrix::multiplyvec(mvp, v);
+
+            // Triangles crossing the near plane are skipped (that only makes the culling less aggressive)
+            if (clip.w <= 1e-5f)
+            {
+                clipped = true;
+                break;
+            }
+
+            s[k].x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH + OCCLUSION_BORDER_X;
+            s[k].y = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT + OCCLUSION_BORDER_Y;
+            s[k].z = clip.z / clip.w * 0.5f + 0.5f;
+        }
+
+        if (!clipped)
+            triangle(s[0], s[1], s[2]);
+    }
+
+    occluders++;
+}
+
+/**
+ * @brief Finish rasterizing (builds the conservative depth & the hierarchical tiles)
+ * @details A pixel lies inside the square of it's 3x3 neighbours' centers, so if the occluders cover those centers
+ * they (usually) cover the whole pixel, & a plane's farthest depth over the pixel is at one of them
+ */
+void Occlusion::finish()
+{
+    // The farthest depth of 3 neighbours in the rows, then in the columns
+    std::vector<float> rows(OCCLUSION_WIDTH * OCCLUSION_RASTER_HEIGHT);
+    for (int y = 0; y < OCCLUSION_RASTER_HEIGHT; y++)
+    {
+        const float *in = &raster[y * OCCLUSION_RASTER_WIDTH + OCCLUSION_BORDER_X];
+        float *out = &rows[y * OCCLUSION_WIDTH];
+
+#if defined(__SSE2__)
+        for (int x = 0; x < OCCLUSION_WIDTH; x += 4)
+            _mm_storeu_ps(&out[x], _mm_max_ps(_mm_max_ps(_mm_loadu_ps(&in[x - 1]), _mm_loadu_ps(&in[x])), _mm_loadu_ps(&in[x + 1])));
+#else
+        for (int x = 0; x < OCCLUSION_WIDTH; x++)
+            out[x] = std::max({in[x - 1], in[x], in[x + 1]});
+#endif
+    }
+
+    for (int y = 0; y < OCCLUSION_HEIGHT; y++)
+    {
+        // The rows above, at & below (the raster's row y + 1)
+        const float *a = &rows[y * OCCLUSION_WIDTH];
+        const float *b = a + OCCLUSION_WIDTH;
+        const float *c = b + OCCLUSION_WIDTH;
+        float *out = &depth[y * OCCLUSION_WIDTH];
+
+#if defined(__SSE2__)
+        for (int x = 0; x < OCCLUSION_WIDTH; x += 4)
+            _mm_storeu_ps(&out[x], _mm_max_ps(_mm_max_ps(_mm_loadu_ps(&a[x]), _mm_loadu_ps(&b[x])), _mm_loadu_ps(&c[x])));
+#else
+        for (int x = 0; x < OCCLUSION_WIDTH; x++)
+            out[x] = std::max({a[x], b[x], c[x]});
+#endif
+    }
+
+    int tw = OCCLUSION_WIDTH / OCCLUSION_TILE;
+    int th = OCCLUSION_HEIGHT / OCCLUSION_TILE;
+
+    for (int ty = 0; ty < th; ty++)
+    {
+        for (int tx = 0; tx < tw; tx++)
+        {
+            float farthest = 0.0f;
+            for (int y = ty * OCCLUSION_TILE; y < (ty + 1) * OCCLUSION_TILE; y++)
+                for (int x = tx * OCCLUSION_TILE; x < (tx + 1) * OCCLUSION_TILE; x++)
+                    farthest = std::max(farthest, depth[y * OCCLUSION_WIDTH + x]);
+
+            tiles[ty * tw + tx] = farthest;
+        }
+    }
+}
+
+/**
+ * @brief Test a world-space bounding box against the occluders
+ *
+ * @param min The box's minimum
+ * @param max The box's maximum
+ * @return is it (possibly) visible?
+ */
+bool Occlusion::visible(vec3 min, vec3 max)
+{
+    tested++;
+
+    if (test(min, max))
+        return true;
+
+    occluded++;
+    return false;
+}
+
+/**
+ * @brief Test a world-space bounding box against the occluders, without counting it (safe from many threads)
+ *
+ * @param min The box's minimum
+ * @param max The box's maximum
+ * @return is it (possibly) visible?
+ */
+bool Occlusion::test(vec3 min, vec3 max) const
+{
+    // Project the corners (the box's nearest depth is compared to the buffer)
+    float sminx = 1e30f, sminy = 1e30f, smaxx = -1e30f, smaxy = -1e30f;
+    float nearest = 1.0f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z};
+        vec3 clip = matrix::multiplyvec(viewproj, corner);
+
+        // Crosses the near plane
+        if (clip.w <= 1e-5f)
+            return true;
+
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+
+        sminx = std::min(sminx, x);
+        sminy = std::min(sminy, y);
+        smaxx = std::max(smaxx, x);
+        smaxy = std::max(smaxy, y);
+        nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, (int)floorf(sminx));
+    int y0 = std::max(0, (int)floorf(sminy));
+    int x1 = std::min(OCCLUSION_WIDTH - 1, (int)ceilf(smaxx));
+    int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)ceilf(smaxy));
+    if (x0 > x1 || y0 > y1)
+        return true; // off-screen (left to the frustum culling)
+
+    int tw = OCCLUSION_WIDTH / OCCLUSION_TILE;
+    for (int ty = y0 / OCCLUSION_TILE; ty <= y1 / OCCLUSION_TILE; ty++)
+    {
+        for (int tx = x0 / OCCLUSION_TILE; tx <= x1 / OCCLUSION_TILE; tx++)
+        {
+            // The whole tile is nearer than the box
+            if (nearest > tiles[ty * tw + tx])
+                continue;
+
+            // Check the covered pixels of the tile
+            int px0 = std::max(x0, tx * OCCLUSION_TILE), px1 = std::min(x1, (tx + 1) * OCCLUSION_TILE - 1);
+            int py0 = std::max(y0, ty * OCCLUSION_TILE), py1 = std::min(y1, (ty + 1) * OCCLUSION_TILE - 1);
+
+            for (int y = py0; y <= py1; y++)
+                for (int x = px0; x <= px1; x++)
+                    if (nearest <= depth[y * OCCLUSION_WIDTH + x])
+                        return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Read the depth buffer (for debugging)
+ *
+ * @param x The pixel's x (0 - OCCLUSION_WIDTH)
+ * @param y The pixel's y (0 - OCCLUSION_HEIGHT)
+ * @return The depth (1 if empty)
+ */
+float Occlusion::at(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= OCCLUSION_WIDTH || y >= OCCLUSION_HEIGHT || depth.empty())
+        return 1.0f;
+    return depth[y * OCCLUSION_WIDTH + x];
+}
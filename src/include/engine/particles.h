@@ -0,0 +1,673 @@
+// Particle Systems for the Game Engine
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <SDL2/SDL.h>
+#include <GL/glad.h>
+
+#include <tools/types.h>
+#include <tools/debug.h>
+#include <tools/glstate.h>
+#include <tools/shader.h>
+
+#include <engine/workers.h>
+
+// The SIMD width of the simulation
+#if defined(__AVX__)
+#define PARTICLE_WIDTH 8
+#elif defined(__SSE2__)
+#define PARTICLE_WIDTH 4
+#else
+#define PARTICLE_WIDTH 1
+#endif
+
+// Keys of the color, alpha & size curves
+#define PARTICLE_KEYS 4
+
+/**
+ * @brief A particle emitter (it's settings & it's particles)
+ * @details The particles are stored as structure-of-arrays (one array per attribute, padded to PARTICLE_WIDTH), so
+ * PARTICLE_WIDTH particles are simulated at once. The curves are piecewise linear over the particles' life (0 - born, 1 - dead)
+ */
+struct emitter
+{
+    // Spawning
+    vec3 position;                          // in world-space (the particles don't follow it after they spawned)
+    vec3 area;                              // the particles spawn in this box around the position (half of it's size)
+    float rate = 100.0f;                    // new particles per second
+    uint max = 10000;                       // the most particles alive at once
+    float life = 2.0f;                      // in seconds
+    float life_spread = 0.5f;               // random +- life
+    vec3 velocity = {0.0f, 1.0f, 0.0f};     // the initial velocity
+    vec3 spread = {0.5f, 0.5f, 0.5f};       // random +- velocity (per axis)
+    bool active = true;                     // spawning? (the alive particles are simulated anyway)
+
+    // Simulation
+    vec3 gravity = {0.0f, -9.81f, 0.0f};
+    float drag = 0.0f; // the part of the velocity lost per second
+
+    // Look
+    float times[PARTICLE_KEYS] = {0.0f, 0.33f, 0.66f, 1.0f}; // the curves' keys (increasing, 0 - 1)
+    vec3 colors[PARTICLE_KEYS] = {{1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}};
+    float alphas[PARTICLE_KEYS] = {1.0f, 1.0f, 1.0f, 0.0f};
+    float sizes[PARTICLE_KEYS] = {0.1f, 0.1f, 0.1f, 0.1f}; // in world units
+    texture tex = 0;                                          // 0 - round, soft particles
+    bool additive = false;                                    // add the colors (ex. fire, sparks) instead of blending
+
+    // Particles
+    uint count = 0;                         // alive (the first count of the arrays)
+    std::vector<float> x, y, z, vx, vy, vz; // position & velocity
+    std::vector<float> age;                 // 0 - born, 1 - dead
+    std::vector<float> speed;               // the age per second (1 / life)
+    std::vector<float> size;
+    std::vector<uint32_t> color; // RGBA8
+
+    float pending = 0.0f;       // the spawns of the next update (fractions & bursts)
+    uint32_t seed = 0x9E3779B9; // the random state
+
+    void burst(uint n);
+};
+
+/**
+ * @brief Spawn particles at the next update (on top of the rate)
+ *
+ * @param n The number of particles
+ */
+void emitter::burst(uint n)
+{
+    this->pending += (float)n;
+}
+
+/**
+ * @brief The curves of an emitter, as a sum of clamped ramps (one per segment, shared by the channels)
+ * @details value = base + sum(delta[k] * clamp((t - start[k]) * scale[k], 0, 1)), so there are no branches per particle
+ */
+struct __particle_curves_t
+{
+    float start[PARTICLE_KEYS - 1];
+    float scale[PARTICLE_KEYS - 1];
+
+    float base[5];                     // red, green, blue, alpha & size at the first key
+    float delta[5][PARTICLE_KEYS - 1]; // the change of the channels per segment
+};
+
+/**
+ * @brief The GPU side of an emitter (only used by Particles::upload() & Particles::draw(), so by the render thread)
+ * @details The buffer holds allocated x, y, z, size & color values after each other
+ */
+struct __particle_batch_t
+{
+    uint VAO = 0, VBO = 0;
+    uint allocated = 0; // particles per attribute
+
+    uint count = 0; // the handed particles
+    texture tex = 0;
+    bool additive = false;
+};
+
+/**
+ * @brief Particle helpers (the SIMD lanes & the simulation)
+ */
+namespace particle
+{
+#if PARTICLE_WIDTH == 8
+    typedef __m256 lanes;
+
+    inline lanes set(float v) { return _mm256_set1_ps(v); }
+    inline lanes load(const float *p) { return _mm256_loadu_ps(p); }
+    inline void store(float *p, lanes v) { _mm256_storeu_ps(p, v); }
+    inline lanes add(lanes a, lanes b) { return _mm256_add_ps(a, b); }
+    inline lanes sub(lanes a, lanes b) { return _mm256_sub_ps(a, b); }
+    inline lanes mul(lanes a, lanes b) { return _mm256_mul_ps(a, b); }
+    inline lanes min(lanes a, lanes b) { return _mm256_min_ps(a, b); }
+    inline lanes max(lanes a, lanes b) { return _mm256_max_ps(a, b); }
+    inline int over(lanes a, lanes b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+#elif PARTICLE_WIDTH == 4
+    typedef __m128 lanes;
+
+    inline lanes set(float v) { return _mm_set1_ps(v); }
+    inline lanes load(const float *p) { return _mm_loadu_ps(p); }
+    inline void store(float *p, lanes v) { _mm_storeu_ps(p, v); }
+    inline lanes add(lanes a, lanes b) { return _mm_add_ps(a, b); }
+    inline lanes sub(lanes a, lanes b) { return _mm_sub_ps(a, b); }
+    inline lanes mul(lanes a, lanes b) { return _mm_mul_ps(a, b); }
+    inline lanes min(lanes a, lanes b) { return _mm_min_ps(a, b); }
+    inline lanes max(lanes a, lanes b) { return _mm_max_ps(a, b); }
+    inline int over(lanes a, lanes b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+#else
+    typedef float lanes;
+
+    inline lanes set(float v) { return v; }
+    inline lanes load(const float *p) { return *p; }
+    inline void store(float *p, lanes v) { *p = v; }
+    inline lanes add(lanes a, lanes b) { return a + b; }
+    inline lanes sub(lanes a, lanes b) { return a - b; }
+    inline lanes mul(lanes a, lanes b) { return a * b; }
+    inline lanes min(lanes a, lanes b) { return fminf(a, b); }
+    inline lanes max(lanes a, lanes b) { return fmaxf(a, b); }
+    inline int over(lanes a, lanes b) { return a >= b; }
+#endif
+
+#if defined(__SSE2__)
+    /**
+     * @brief Pack 4 colors into RGBA8 (the channels are 0 - 255)
+     */
+    inline __m128i rgba(__m128i r, __m128i g, __m128i b, __m128i a)
+    {
+        return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+    }
+#endif
+
+    /**
+     * @brief Store the colors of PARTICLE_WIDTH particles as RGBA8
+     *
+     * @param r The red channels (0 - 1)
+     * @param g The green channels
+     * @param b The blue channels
+     * @param a The alpha channels
+     * @param out The colors
+     */
+    inline void pack(lanes r, lanes g, lanes b, lanes a, uint32_t *out)
+    {
+        lanes zero = set(0.0f), one = set(1.0f), scale = set(255.0f), half = set(0.5f);
+
+        r = add(mul(min(max(r, zero), one), scale), half);
+        g = add(mul(min(max(g, zero), one), scale), half);
+        b = add(mul(min(max(b, zero), one), scale), half);
+        a = add(mul(min(max(a, zero), one), scale), half);
+
+#if PARTICLE_WIDTH == 8
+        // AVX has no 256 bit integer shifts, so the halves are packed with SSE2
+        __m256i ri = _mm256_cvttps_epi32(r), gi = _mm256_cvttps_epi32(g);
+        __m256i bi = _mm256_cvttps_epi32(b), ai = _mm256_cvttps_epi32(a);
+
+        _mm_storeu_si128((__m128i *)out, rgba(_mm256_castsi256_si128(ri), _mm256_castsi256_si128(gi),
+                                              _mm256_castsi256_si128(bi), _mm256_castsi256_si128(ai)));
+        _mm_storeu_si128((__m128i *)(out + 4), rgba(_mm256_extractf128_si256(ri, 1), _mm256_extractf128_si256(gi, 1),
+                                                    _mm256_extractf128_si256(bi, 1), _mm256_extractf128_si256(ai, 1)));
+#elif PARTICLE_WIDTH == 4
+        _mm_storeu_si128((__m128i *)out, rgba(_mm_cvttps_epi32(r), _mm_cvttps_epi32(g), _mm_cvttps_epi32(b), _mm_cvttps_epi32(a)));
+#else
+        *out = (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+#endif
+    }
+
+    /**
+     * @brief A random number (xorshift)
+     *
+     * @param seed The random state
+     * @return -1 - 1
+     */
+    inline float random(uint32_t &seed)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return (float)(seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    /**
+     * @brief Get the curves of an emitter
+     *
+     * @param e The emitter
+     * @return The curves' ramps
+     */
+    __particle_curves_t curves(const emitter &e)
+    {
+        __particle_curves_t c;
+
+        const float base[5] = {e.colors[0].x, e.colors[0].y, e.colors[0].z, e.alphas[0], e.sizes[0]};
+        for (int n = 0; n < 5; n++)
+            c.base[n] = base[n];
+
+        for (int k = 0; k < PARTICLE_KEYS - 1; k++)
+        {
+            float span = e.times[k + 1] - e.times[k];
+            c.start[k] = e.times[k];
+            c.scale[k] = span > 1e-6f ? 1.0f / span : 1e6f;
+
+            c.delta[0][k] = e.colors[k + 1].x - e.colors[k].x;
+            c.delta[1][k] = e.colors[k + 1].y - e.colors[k].y;
+            c.delta[2][k] = e.colors[k + 1].z - e.colors[k].z;
+            c.delta[3][k] = e.alphas[k + 1] - e.alphas[k];
+            c.delta[4][k] = e.sizes[k + 1] - e.sizes[k];
+        }
+
+        return c;
+    }
+
+    /**
+     * @brief Simulate a range of particles (first must be aligned to PARTICLE_WIDTH, the last block may run into the padding)
+     * @details Ages the particles, applies the gravity & the drag, moves them & evaluates their curves
+     *
+     * @param e The emitter
+     * @param c The emitter's curves
+     * @param first The first particle
+     * @param last The end of the range
+     * @param deltaTime The time step (in seconds)
+     * @param dead The dead particles' indices (appended, increasing)
+     */
+    void simulate(emitter &e, const __particle_curves_t &c, size_t first, size_t last, float deltaTime, std::vector<uint> &dead)
+    {
+        lanes dt = set(deltaTime), damp = set(fmaxf(1.0f - e.drag * deltaTime, 0.0f));
+        lanes gx = set(e.gravity.x * deltaTime), gy = set(e.gravity.y * deltaTime), gz = set(e.gravity.z * deltaTime);
+        lanes zero = set(0.0f), one = set(1.0f);
+
+        lanes start[PARTICLE_KEYS - 1], scale[PARTICLE_KEYS - 1];
+        for (int k = 0; k < PARTICLE_KEYS - 1; k++)
+        {
+            start[k] = set(c.start[k]);
+            scale[k] = set(c.scale[k]);
+        }
+
+        lanes base[5], delta[5][PARTICLE_KEYS - 1];
+        for (int n = 0; n < 5; n++)
+        {
+            base[n] = set(c.base[n]);
+            for (int k = 0; k < PARTICLE_KEYS - 1; k++)
+                delta[n][k] = set(c.delta[n][k]);
+        }
+
+        // (the arrays in locals, so they aren't reloaded after every store)
+        float *x = &e.x[0], *y = &e.y[0], *z = &e.z[0];
+        float *vx = &e.vx[0], *vy = &e.vy[0], *vz = &e.vz[0];
+        float *ages = &e.age[0], *speed = &e.speed[0], *size = &e.size[0];
+        uint32_t *color = &e.color[0];
+
+        for (size_t i = first; i < last; i += PARTICLE_WIDTH)
+        {
+            // Lifetime
+            lanes age = add(load(&ages[i]), mul(load(&speed[i]), dt));
+            store(&ages[i], age);
+
+            // Gravity & Drag
+            lanes dx = mul(add(load(&vx[i]), gx), damp);
+            lanes dy = mul(add(load(&vy[i]), gy), damp);
+            lanes dz = mul(add(load(&vz[i]), gz), damp);
+            store(&vx[i], dx);
+            store(&vy[i], dy);
+            store(&vz[i], dz);
+
+            store(&x[i], add(load(&x[i]), mul(dx, dt)));
+            store(&y[i], add(load(&y[i]), mul(dy, dt)));
+            store(&z[i], add(load(&z[i]), mul(dz, dt)));
+
+            // Curves (the ramps of the segments)
+            lanes t = min(age, one);
+            lanes ramp[PARTICLE_KEYS - 1];
+            for (int k = 0; k < PARTICLE_KEYS - 1; k++)
+                ramp[k] = min(max(mul(sub(t, start[k]), scale[k]), zero), one);
+
+            lanes channel[5];
+            for (int n = 0; n < 5; n++)
+            {
+                channel[n] = base[n];
+                for (int k = 0; k < PARTICLE_KEYS - 1; k++)
+                    channel[n] = add(channel[n], mul(ramp[k], delta[n][k]));
+            }
+
+            store(&size[i], channel[4]);
+            pack(channel[0], channel[1], channel[2], channel[3], &color[i]);
+
+            // The dead (removed after the simulation)
+            int mask = over(age, one);
+            for (int k = 0; mask != 0 && k < PARTICLE_WIDTH; k++)
+                if (((mask >> k) & 1) && i + k < last)
+                    dead.push_back((uint)(i + k));
+        }
+    }
+}
+
+/**
+ * @brief Simulates & draws the particle emitters
+ * @details update() spawns, simulates (split over the workers) & compacts the particles (the dead ones are replaced by
+ * the last alive ones). upload() copies the alive particles to the GPU while the simulation waits (see Engine::handoff()),
+ * draw() draws every emitter as one instanced billboard draw. The particles aren't sorted & don't write the depth
+ */
+class Particles
+{
+private:
+    gls s = 0;
+    uint quadVBO = 0, quadEBO = 0;
+
+    std::map<std::string, __particle_batch_t> batches;
+    std::vector<__particle_batch_t> unused; // the buffers of removed emitters (reused by the next new one)
+
+    std::vector<std::vector<uint>> dead; // per worker
+
+    void reserve(emitter &e);
+    void spawn(emitter &e, uint n);
+    void compact(emitter &e);
+    void allocate(__particle_batch_t &b, uint n);
+
+public:
+    std::map<std::string, emitter> emitters;
+
+    uint alive = 0;    // particles after the last update
+    uint drawn = 0;    // particles of the handed frame
+    float time = 0.0f; // the last update's CPU time (in ms)
+
+    emitter &add(std::string name, emitter e);
+    void remove(std::string name);
+
+    void update(float deltaTime, Workers &workers);
+    void upload();
+    void draw(const mat4 &view, const mat4 &projection);
+};
+
+// Private Functions
+
+/**
+ * @brief Resize an emitter's arrays to it's max (padded to PARTICLE_WIDTH)
+ *
+ * @param e The emitter
+ */
+void Particles::reserve(emitter &e)
+{
+    size_t n = (e.max + PARTICLE_WIDTH - 1) / PARTICLE_WIDTH * PARTICLE_WIDTH;
+    if (e.x.size() == n)
+        return;
+
+    e.x.resize(n);
+    e.y.resize(n);
+    e.z.resize(n);
+    e.vx.resize(n);
+    e.vy.resize(n);
+    e.vz.resize(n);
+    e.age.resize(n);
+    e.speed.resize(n);
+    e.size.resize(n);
+    e.color.resize(n);
+
+    e.count = std::min(e.count, e.max);
+}
+
+/**
+ * @brief Spawn particles (as many as there is room for)
+ *
+ * @param e The emitter
+ * @param n The number of particles
+ */
+void Particles::spawn(emitter &e, uint n)
+{
+    n = std::min(n, e.max - e.count);
+
+    for (uint k = 0; k < n; k++)
+    {
+        uint i = e.count++;
+
+        e.x[i] = e.position.x + particle::random(e.seed) * e.area.x;
+        e.y[i] = e.position.y + particle::random(e.seed) * e.area.y;
+        e.z[i] = e.position.z + particle::random(e.seed) * e.area.z;
+
+        e.vx[i] = e.velocity.x + particle::random(e.seed) * e.spread.x;
+        e.vy[i] = e.velocity.y + particle::random(e.seed) * e.spread.y;
+        e.vz[i] = e.velocity.z + particle::random(e.seed) * e.spread.z;
+
+        e.age[i] = 0.0f;
+        e.speed[i] = 1.0f / fmaxf(e.life + particle::random(e.seed) * e.life_spread, 0.001f);
+    }
+}
+
+/**
+ * @brief Remove the dead particles (from the last one, so the moved particles are always alive)
+ *
+ * @param e The emitter
+ */
+void Particles::compact(emitter &e)
+{
+    for (size_t w = dead.size(); w-- > 0;)
+    {
+        for (size_t d = dead[w].size(); d-- > 0;)
+        {
+            uint i = dead[w][d];
+            uint last = --e.count;
+            if (i == last)
+                continue;
+
+            e.x[i] = e.x[last];
+            e.y[i] = e.y[last];
+            e.z[i] = e.z[last];
+            e.vx[i] = e.vx[last];
+            e.vy[i] = e.vy[last];
+            e.vz[i] = e.vz[last];
+            e.age[i] = e.age[last];
+            e.speed[i] = e.speed[last];
+            e.size[i] = e.size[last];
+            e.color[i] = e.color[last];
+        }
+    }
+}
+
+/**
+ * @brief (Re)allocate a batch's buffer & point the attributes at it
+ *
+ * @param b The batch
+ * @param n The particles per attribute
+ */
+void Particles::allocate(__particle_batch_t &b, uint n)
+{
+    b.allocated = n;
+
+    glstate::bind_vertexarray(b.VAO);
+    glstate::bind_buffer(GL_ARRAY_BUFFER, b.VBO);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)n * 5 * sizeof(float), NULL, GL_STREAM_DRAW);
+
+    // x, y, z & size (locations 1 - 4)
+    for (uint a = 0; a < 4; a++)
+    {
+        glVertexAttribPointer(1 + a, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void *)((size_t)n * a * sizeof(float)));
+        glEnableVertexAttribArray(1 + a);
+        glVertexAttribDivisor(1 + a, 1);
+    }
+
+    // color (location 5)
+    glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(uint32_t), (void *)((size_t)n * 4 * sizeof(float)));
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+}
+
+// Public Functions
+
+/**
+ * @brief Add (or replace) an emitter
+ *
+ * @param name The emitter's name
+ * @param e The emitter
+ * @return The added emitter
+ */
+emitter &Particles::add(std::string name, emitter e)
+{
+    emitter &added = emitters[name] = e;
+    reserve(added);
+    return added;
+}
+
+/**
+ * @brief Remove an emitter (with it's particles)
+ *
+ * @param name The emitter's name
+ */
+void Particles::remove(std::string name)
+{
+    if (emitters.erase(name) == 0)
+        debug::warning("Particles::remove()", "there's no emitter with this name", name.c_str());
+}
+
+/**
+ * @brief Spawn, simulate & compact the particles of every emitter
+ *
+ * @param deltaTime The time step (in seconds)
+ * @param workers The worker threads
+ */
+void Particles::update(float deltaTime, Workers &workers)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    dead.resize(workers.size());
+    alive = 0;
+
+    for (auto &[name, e] : emitters)
+    {
+        reserve(e);
+
+        // Spawn (the fractions are carried to the next update)
+        if (e.active)
+            e.pending += e.rate * deltaTime;
+
+        uint n = (uint)e.pending;
+        e.pending -= (float)n;
+        spawn(e, n);
+
+        // Simulate blocks of PARTICLE_WIDTH particles
+        __particle_curves_t c = particle::curves(e);
+        for (auto &d : dead)
+            d.clear();
+
+        size_t count = e.count;
+        workers.run((count + PARTICLE_WIDTH - 1) / PARTICLE_WIDTH, [&](size_t first, size_t last, uint worker)
+                    {
+                        particle::simulate(e, c, first * PARTICLE_WIDTH, std::min(last * PARTICLE_WIDTH, count), deltaTime, dead[worker]);
+                    });
+
+        compact(e);
+        alive += e.count;
+    }
+
+    time = (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Copy the alive particles to the GPU (needs the OpenGL context, the simulation mustn't run)
+ */
+void Particles::upload()
+{
+    // The shared quad (the billboards' corners)
+    if (quadVBO == 0 && !emitters.empty())
+    {
+        const float corners[8] = {-0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f};
+        const uint indices[6] = {0, 1, 2, 0, 2, 3};
+
+        glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &quadEBO);
+
+        glstate::bind_buffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+        // (filled as an array buffer, the element buffers belong to the vertex arrays)
+        glstate::bind_buffer(GL_ARRAY_BUFFER, quadEBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    }
+
+    // The removed emitters' buffers are kept for the next new emitter
+    for (auto it = batches.begin(); it != batches.end();)
+    {
+        if (emitters.find(it->first) == emitters.end())
+        {
+            unused.push_back(it->second);
+            it = batches.erase(it);
+        }
+        else
+            it++;
+    }
+
+    drawn = 0;
+    for (auto &[name, e] : emitters)
+    {
+        auto found = batches.find(name);
+        if (found == batches.end())
+        {
+            __particle_batch_t b;
+            if (!unused.empty())
+            {
+                b = unused.back();
+                unused.pop_back();
+            }
+            else
+            {
+                glGenVertexArrays(1, &b.VAO);
+                glGenBuffers(1, &b.VBO);
+
+                glstate::bind_vertexarray(b.VAO);
+                glstate::bind_buffer(GL_ARRAY_BUFFER, quadVBO);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+                glEnableVertexAttribArray(0);
+                glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+            }
+            found = batches.insert({name, b}).first;
+        }
+
+        __particle_batch_t &b = found->second;
+        b.count = e.count;
+        b.tex = e.tex;
+        b.additive = e.additive;
+
+        if (b.count == 0)
+            continue;
+
+        // Re-specifying the buffer orphans the last frame's data
+        if (b.allocated < e.max)
+            allocate(b, e.max);
+        else
+        {
+            glstate::bind_buffer(GL_ARRAY_BUFFER, b.VBO);
+            glBufferData(GL_ARRAY_BUFFER, (size_t)b.allocated * 5 * sizeof(float), NULL, GL_STREAM_DRAW);
+        }
+
+        const void *arrays[5] = {&e.x[0], &e.y[0], &e.z[0], &e.size[0], &e.color[0]};
+        for (uint a = 0; a < 5; a++)
+            glBufferSubData(GL_ARRAY_BUFFER, (size_t)b.allocated * a * sizeof(float), (size_t)b.count * sizeof(float), arrays[a]);
+
+        drawn += b.count;
+    }
+}
+
+/**
+ * @brief Draw the handed particles (one instanced draw per emitter, blended over the scene)
+ *
+ * @param view The camera's view matrix
+ * @param projection The camera's projection matrix
+ */
+void Particles::draw(const mat4 &view, const mat4 &projection)
+{
+    if (drawn == 0)
+        return;
+
+    if (s == 0)
+        s = shader::load("particle");
+
+    shader::use(s);
+    shader::set(s, "view", view);
+    shader::set(s, "projection", projection);
+    shader::set(s, "tex", 0);
+
+    glstate::enable(GL_DEPTH_TEST);
+    glstate::enable(GL_BLEND);
+    glstate::depthmask(false);
+    glstate::depthfunc(GL_LESS);
+
+    for (auto &[name, b] : batches)
+    {
+        if (b.count == 0)
+            continue;
+
+        glstate::blendfunc(GL_SRC_ALPHA, b.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+
+        shader::set(s, "textured", b.tex != 0);
+        if (b.tex != 0)
+            glstate::bind_texture(GL_TEXTURE_2D, b.tex);
+
+        glstate::bind_vertexarray(b.VAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void *)0, b.count, 0);
+    }
+}
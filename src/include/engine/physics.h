@@ -5,6 +5,7 @@
 #include <map>
 
 #include <engine/object.h>
+#include <engine/terrain.h>
 
 /**
  * @brief The Physics class' struct to return collision data from 2nd thread
@@ -48,6 +49,7 @@ public:
     void add(object o, std::string name);
 
     bool collide(std::string a, std::string b);
+    bool collide(std::string a, heightfield &ground);
 
     bool collide(vec2 point, vec2 start, vec2 size);
 };
@@ -257,6 +259,26 @@ bool Physics::collide(std::string a, std::string b)
     return false;
 }
 
+/**
+ * @brief Check if an object's collider reaches under a heightfield (ex. the terrain's ground, O(1) per vertex)
+ *
+ * @param a The object's name
+ * @param ground The heightfield
+ * @returns collision
+ */
+bool Physics::collide(std::string a, heightfield &ground)
+{
+    object &o = (*this->collisions.objs)[a];
+
+    for (size_t i = 0; i + 2 < o.c.vertices.size(); i += 3)
+    {
+        vec3 point = {o.c.vertices[i] + o.position.x, o.c.vertices[i + 1] + o.position.y, o.c.vertices[i + 2] + o.position.z};
+        if (ground.below(point))
+            return true;
+    }
+    return false;
+}
+
 /**
  * @brief Check if a 2D Point collides with a 2D rect
  *
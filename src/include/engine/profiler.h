@@ -0,0 +1,217 @@
+// Frame Profiler for the Game Engine
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <GL/glad.h>
+
+#include <tools/debug.h>
+
+#define PROFILER_FRAMES 4   // frames between a scope & reading it's result (so reading doesn't stall)
+#define PROFILER_HISTORY 64 // frames in the rolling averages
+
+/**
+ * @brief A scope's times in a frame
+ */
+struct passtime
+{
+    std::string name;
+    int depth = 0; // nesting (0 - top level)
+
+    float start = 0.0f; // GPU start (in ms, from the frame's first scope)
+    float gpu = 0.0f;   // GPU time (in ms)
+    float cpu = 0.0f;   // CPU time (in ms)
+};
+
+/**
+ * @brief The scopes of a frame in flight
+ */
+struct __profiler_frame_t
+{
+    std::vector<passtime> scopes;
+    std::vector<uint> queries; // 2 timestamps per scope (begin, end)
+};
+
+/**
+ * @brief A scope's last times
+ */
+struct __profiler_history_t
+{
+    float gpu[PROFILER_HISTORY] = {};
+    float cpu[PROFILER_HISTORY] = {};
+    uint count = 0, next = 0;
+};
+
+/**
+ * @brief Times scopes (passes) of the frame on the GPU & the CPU
+ * @details Every scope writes a GL_TIMESTAMP query at it's begin & end. The queries are in a ring of PROFILER_FRAMES frames,
+ * a frame's results are read when it's queries are reused (they are finished by then, so reading doesn't wait for the GPU)
+ */
+class Profiler
+{
+private:
+    __profiler_frame_t ring[PROFILER_FRAMES];
+    uint current = 0; // the frame in the ring
+    uint frames = 0;  // frames since setup()
+
+    std::vector<int> stack;     // the open scopes
+    std::vector<Uint64> starts; // the open scopes' CPU start
+
+    std::map<std::string, __profiler_history_t> history;
+
+    void collect(__profiler_frame_t &f);
+
+public:
+    bool enabled = true;
+
+    std::vector<passtime> timeline; // the scopes of the last finished frame
+    uint dropped = 0;               // frames which weren't finished when their queries were reused
+    uint collected = 0;             // frames read (the timeline changes when this does)
+
+    void begin(std::string name);
+    void end();
+    void frame();
+
+    float average(std::string name, bool gpu = true);
+};
+
+/**
+ * @brief Begin a scope (scopes can be nested)
+ *
+ * @param name The scope's name (the same name adds to the same average)
+ */
+void Profiler::begin(std::string name)
+{
+    if (!this->enabled)
+        return;
+
+    __profiler_frame_t &f = this->ring[this->current];
+
+    passtime p;
+    p.name = name;
+    p.depth = (int)this->stack.size();
+
+    uint i = (uint)f.scopes.size();
+    f.scopes.push_back(p);
+
+    // Grow the frame's pool
+    if (f.queries.size() < (size_t)(i + 1) * 2)
+    {
+        size_t have = f.queries.size();
+        f.queries.resize((size_t)(i + 1) * 2);
+        glGenQueries((GLsizei)(f.queries.size() - have), &f.queries[have]);
+    }
+
+    glQueryCounter(f.queries[i * 2], GL_TIMESTAMP);
+
+    this->stack.push_back(i);
+    this->starts.push_back(SDL_GetPerformanceCounter());
+}
+
+/**
+ * @brief End the last scope
+ */
+void Profiler::end()
+{
+    if (!this->enabled || this->stack.empty())
+        return;
+
+    __profiler_frame_t &f = this->ring[this->current];
+    int i = this->stack.back();
+
+    glQueryCounter(f.queries[i * 2 + 1], GL_TIMESTAMP);
+    f.scopes[i].cpu = (float)(SDL_GetPerformanceCounter() - this->starts.back()) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+
+    this->stack.pop_back();
+    this->starts.pop_back();
+}
+
+/**
+ * @brief Read a frame's results (to the timeline & the averages)
+ *
+ * @param f The frame
+ */
+void Profiler::collect(__profiler_frame_t &f)
+{
+    if (f.scopes.empty())
+        return;
+
+    // The last query is the last one to finish
+    int available = 0;
+    glGetQueryObjectiv(f.queries[f.scopes.size() * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        this->dropped++;
+        return;
+    }
+
+    GLuint64 first = 0;
+    for (size_t i = 0; i < f.scopes.size(); i++)
+    {
+        GLuint64 a = 0, b = 0;
+        glGetQueryObjectui64v(f.queries[i * 2], GL_QUERY_RESULT, &a);
+        glGetQueryObjectui64v(f.queries[i * 2 + 1], GL_QUERY_RESULT, &b);
+
+        if (i == 0)
+            first = a;
+
+        passtime &p = f.scopes[i];
+        p.start = (float)(double)(a - first) / 1000000.0f;
+        p.gpu = (float)(double)(b - a) / 1000000.0f;
+
+        __profiler_history_t &h = this->history[p.name];
+        h.gpu[h.next] = p.gpu;
+        h.cpu[h.next] = p.cpu;
+        h.next = (h.next + 1) % PROFILER_HISTORY;
+        h.count = std::min(h.count + 1, (uint)PROFILER_HISTORY);
+    }
+
+    this->timeline = f.scopes;
+    this->collected++;
+}
+
+/**
+ * @brief End the frame (reads the results of the frame PROFILER_FRAMES - 1 frames ago)
+ */
+void Profiler::frame()
+{
+    if (!this->enabled)
+        return;
+
+    // Close the forgotten scopes
+    while (!this->stack.empty())
+        this->end();
+
+    this->current = (this->current + 1) % PROFILER_FRAMES;
+    this->frames++;
+
+    // The next frame reuses the oldest frame's queries
+    __profiler_frame_t &f = this->ring[this->current];
+    if (this->frames >= PROFILER_FRAMES)
+        this->collect(f);
+    f.scopes.clear();
+}
+
+/**
+ * @brief Get a scope's rolling average (of the last PROFILER_HISTORY frames)
+ *
+ * @param name The scope's name
+ * @param gpu the GPU time? (else the CPU time)
+ * @return The average time (in ms, 0 if the scope wasn't measured yet)
+ */
+float Profiler::average(std::string name, bool gpu)
+{
+    auto it = this->history.find(name);
+    if (it == this->history.end() || it->second.count == 0)
+        return 0.0f;
+
+    const __profiler_history_t &h = it->second;
+
+    float sum = 0.0f;
+    for (uint i = 0; i < h.count; i++)
+        sum += gpu ? h.gpu[i] : h.cpu[i];
+    return sum / h.count;
+}
@@ -0,0 +1,73 @@
+// Render Proxies for the Game Engine
+#pragma once
+
+#include <map>
+#include <tuple>
+
+#include <tools/types.h>
+
+/**
+ * @brief The compact render data of a drawable object
+ * @details Kept in a contiguous array by the Engine and only updated when the object changes,
+ * so the renderer never has to touch the object (and it's meshes) itself
+ */
+struct proxy
+{
+    bool visible = false; // should it be drawn ?
+
+    uint VAO = 0;  // vertex array (of the mesh's vertex format)
+    uint mesh = 0; // geometry pool id (for batching)
+
+    uint base_vertex = 0; // place in the geometry pool
+    uint first_index = 0;
+    uint count = 0; // number of indices
+
+    uint material = 0; // material id (for sorting & batching, see Materials)
+    uint features = 0; // shader feature mask (see shader::bit())
+    texture tex = 0;
+
+    vec3 color;
+    float tmc = 0.0f;   // texture-mix-color
+    float alpha = 1.0f; // opacity
+
+    mat4 model;
+
+    // World-Space Bounds
+    vec3 min, max;
+    vec3 center;
+    float radius = 0.0f;
+};
+
+/**
+ * @brief Material ids (equal materials share an id, so their draws are sorted & batched together)
+ * @details Ids are handed out in order, the sort keys keep their low 10 bits
+ */
+class Materials
+{
+private:
+    typedef std::tuple<bool, bool, float, texture, texture, float> fields; // every field of a material
+
+    std::map<fields, uint> ids;
+
+public:
+    uint id(const material &m);
+};
+
+/**
+ * @brief Get a material's id (not thread-safe)
+ *
+ * @param m The material
+ * @return The id (1 - the first material)
+ */
+uint Materials::id(const material &m)
+{
+    fields f = {m.lit, m.textured, m.d, m.diffuse, m.specular, m.shininess};
+
+    auto it = ids.find(f);
+    if (it != ids.end())
+        return it->second;
+
+    uint id = (uint)ids.size() + 1;
+    ids[f] = id;
+    return id;
+}
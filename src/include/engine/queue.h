@@ -0,0 +1,237 @@
+// Render Queue for the Game Engine
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+
+#include <tools/types.h>
+
+/**
+ * @brief The render passes (in drawing order)
+ */
+typedef enum
+{
+    PASS_OPAQUE = 0,
+    PASS_TRANSPARENT,
+    PASS_OVERLAY
+} RENDER_PASS;
+
+/**
+ * @brief One queued draw
+ */
+struct drawitem
+{
+    uint64_t key; // sort key (see renderkey)
+    uint index;   // what to draw (index into the submitter's list)
+};
+
+/**
+ * @brief Consecutive queued draws that are drawn with one (instanced) draw call
+ */
+struct drawbatch
+{
+    uint first;    // the first draw's position in the queue
+    uint count;    // number of draws (instances)
+    size_t offset; // instance data's offset in the instance buffer (in bytes)
+};
+
+/**
+ * @brief The draws one worker thread queued (merged into the queue in the workers' order, see RenderQueue::append())
+ */
+struct drawlist
+{
+    std::vector<drawitem> items;
+
+    // Statistics of the worker's objects
+    uint visible = 0;
+    uint culled = 0;   // outside the frustum
+    uint tested = 0;   // occlusion tested
+    uint occluded = 0; // hidden by the occluders
+};
+
+/**
+ * @brief Sort key builders
+ * @details Opaque:      [pass 2][shader 10][material 10][texture 14][mesh 12][depth 16]
+ *          Transparent: [pass 2][inverted depth 24][shader 10][material 10][texture 18]
+ */
+namespace renderkey
+{
+    /**
+     * @brief Quantize a depth
+     *
+     * @param depth The depth (0 - 1)
+     * @param bits The number of bits
+     * @return The quantized depth
+     */
+    uint64_t quantize(float depth, int bits)
+    {
+        uint64_t max = (1ull << bits) - 1;
+        if (!(depth > 0.0f)) // also catches NaN
+            return 0;
+        if (depth >= 1.0f)
+            return max;
+        return (uint64_t)(depth * (float)max);
+    }
+
+    /**
+     * @brief Build an opaque draw's key (sorted by state, then front-to-back)
+     *
+     * @param shader The shader program
+     * @param material The material's id
+     * @param tex The texture
+     * @param mesh The mesh's id (see gpumesh)
+     * @param depth The normalized distance from the camera (0 - 1)
+     * @return The key
+     */
+    uint64_t opaque(uint shader, uint material, uint tex, uint mesh, float depth)
+    {
+        return ((uint64_t)PASS_OPAQUE << 62) |
+               ((uint64_t)(shader & 0x3FF) << 52) |
+               ((uint64_t)(material & 0x3FF) << 42) |
+               ((uint64_t)(tex & 0x3FFF) << 28) |
+               ((uint64_t)(mesh & 0xFFF) << 16) |
+               quantize(depth, 16);
+    }
+
+    /**
+     * @brief Build a transparent draw's key (sorted back-to-front, then by state)
+     *
+     * @param shader The shader program
+     * @param material The material's id
+     * @param tex The texture
+     * @param depth The normalized distance from the camera (0 - 1)
+     * @return The key
+     */
+    uint64_t transparent(uint shader, uint material, uint tex, float depth)
+    {
+        return ((uint64_t)PASS_TRANSPARENT << 62) |
+               (((1ull << 24) - 1 - quantize(depth, 24)) << 38) |
+               ((uint64_t)(shader & 0x3FF) << 28) |
+               ((uint64_t)(material & 0x3FF) << 18) |
+               (uint64_t)(tex & 0x3FFFF);
+    }
+
+    /**
+     * @brief Get the pass of a key
+     *
+     * @param key The key
+     * @return The pass
+     */
+    RENDER_PASS pass(uint64_t key)
+    {
+        return (RENDER_PASS)(key >> 62);
+    }
+};
+
+/**
+ * @brief The render queue
+ * @details Draws are submitted with a sort key, radix-sorted once per frame and then executed in order
+ */
+class RenderQueue
+{
+private:
+    std::vector<drawitem> items;
+    std::vector<drawitem> temp;
+
+public:
+    void clear();
+    void submit(uint64_t key, uint index);
+    void append(const drawlist &list);
+    void sort();
+
+    size_t size();
+    drawitem &operator[](size_t i);
+};
+
+/**
+ * @brief Remove every draw (call at the start of the frame)
+ */
+void RenderQueue::clear()
+{
+    items.clear();
+}
+
+/**
+ * @brief Queue a draw
+ *
+ * @param key The sort key (see renderkey)
+ * @param index What to draw
+ */
+void RenderQueue::submit(uint64_t key, uint index)
+{
+    items.push_back({key, index});
+}
+
+/**
+ * @brief Queue a worker's draws (in order, so the queue is the same with any number of workers)
+ *
+ * @param list The worker's draws
+ */
+void RenderQueue::append(const drawlist &list)
+{
+    items.insert(items.end(), list.items.begin(), list.items.end());
+}
+
+/**
+ * @brief Sort the draws by their keys (LSD radix sort, 8 bits per pass)
+ */
+void RenderQueue::sort()
+{
+    size_t n = items.size();
+    if (n < 2)
+        return;
+
+    temp.resize(n);
+
+    drawitem *src = &items[0];
+    drawitem *dst = &temp[0];
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256] = {0};
+        for (size_t i = 0; i < n; i++)
+            histogram[(src[i].key >> shift) & 0xFF]++;
+
+        // Skip the pass if every key has the same byte here
+        if (histogram[(src[0].key >> shift) & 0xFF] == n)
+            continue;
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            size_t c = histogram[b];
+            histogram[b] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < n; i++)
+            dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+        std::swap(src, dst);
+    }
+
+    if (src != &items[0])
+        items.swap(temp);
+}
+
+/**
+ * @brief Get the number of queued draws
+ *
+ * @return The number of draws
+ */
+size_t RenderQueue::size()
+{
+    return items.size();
+}
+
+/**
+ * @brief Get a queued draw
+ *
+ * @param i The draw's position in the queue
+ * @return The draw
+ */
+drawitem &RenderQueue::operator[](size_t i)
+{
+    return items[i];
+}
@@ -0,0 +1,192 @@
+// Render Thread for the Game Engine
+#pragma once
+
+#include <pthread.h>
+#include <functional>
+#include <vector>
+
+#include <tools/device.h>
+
+/**
+ * @brief A thread that owns the OpenGL context & draws the frames the main thread hands to it
+ * @details frame() waits until the last frame is drawn, runs the handoff on the render thread (the main thread waits,
+ * so the handoff can read the simulation's state) and returns while the frame is drawn. So at most one frame is in
+ * flight: frame N is drawn while frame N + 1 is simulated
+ */
+class RenderThread
+{
+private:
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+
+    Device *device = NULL;
+    std::function<void()> handoff, draw;
+
+    bool online = false;
+    bool requested = false; // a frame is waiting for the render thread
+    bool handed = false;    // the waiting frame's handoff is done
+
+    std::vector<std::function<void()>> tasks;
+    uint queued = 0, finished = 0; // tasks since start()
+
+    static void *render_thread(void *pointer);
+
+public:
+    void start(Device *device, std::function<void()> handoff, std::function<void()> draw);
+    void stop();
+
+    bool running();
+    void frame();
+    void call(std::function<void()> fn);
+};
+
+// Private Functions
+
+void *RenderThread::render_thread(void *pointer)
+{
+    RenderThread *rt = (RenderThread *)pointer;
+    rt->device->current(true);
+
+    pthread_mutex_lock(&rt->lock);
+    while (true)
+    {
+        while (rt->online && !rt->requested && rt->tasks.empty())
+            pthread_cond_wait(&rt->wake, &rt->lock);
+
+        // Tasks (their callers wait, see call())
+        while (!rt->tasks.empty())
+        {
+            std::function<void()> task = rt->tasks.front();
+            rt->tasks.erase(rt->tasks.begin());
+
+            pthread_mutex_unlock(&rt->lock);
+            task();
+            pthread_mutex_lock(&rt->lock);
+
+            rt->finished++;
+            pthread_cond_broadcast(&rt->done);
+        }
+
+        if (rt->requested)
+        {
+            rt->requested = false;
+
+            pthread_mutex_unlock(&rt->lock);
+            rt->handoff();
+            pthread_mutex_lock(&rt->lock);
+
+            // The main thread continues while the frame is drawn
+            rt->handed = true;
+            pthread_cond_broadcast(&rt->done);
+
+            pthread_mutex_unlock(&rt->lock);
+            rt->draw();
+            pthread_mutex_lock(&rt->lock);
+            continue;
+        }
+
+        if (!rt->online)
+            break;
+    }
+    pthread_mutex_unlock(&rt->lock);
+
+    rt->device->current(false);
+    return NULL;
+}
+
+// Public Functions
+
+/**
+ * @brief Start the render thread (it takes the device's context from the calling thread)
+ *
+ * @param device The device
+ * @param handoff Copies a frame from the simulation (the calling thread waits while it runs)
+ * @param draw Draws the handed frame
+ */
+void RenderThread::start(Device *device, std::function<void()> handoff, std::function<void()> draw)
+{
+    if (online)
+        return;
+
+    this->device = device;
+    this->handoff = handoff;
+    this->draw = draw;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&wake, NULL);
+    pthread_cond_init(&done, NULL);
+
+    requested = handed = false;
+    queued = finished = 0;
+    online = true;
+
+    device->current(false);
+    if (pthread_create(&thread, NULL, render_thread, this) != 0)
+    {
+        debug::warning("RenderThread::start()", "can't create the render thread", "rendering on the main thread");
+        online = false;
+        device->current(true);
+    }
+}
+
+/**
+ * @brief Finish the last frame & stop the render thread (the context is given back to the calling thread)
+ */
+void RenderThread::stop()
+{
+    if (!online)
+        return;
+
+    pthread_mutex_lock(&lock);
+    online = false;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    pthread_join(thread, NULL);
+    device->current(true);
+
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&wake);
+    pthread_cond_destroy(&done);
+}
+
+/**
+ * @brief Is the render thread running?
+ */
+bool RenderThread::running()
+{
+    return online;
+}
+
+/**
+ * @brief Hand the next frame to the render thread (waits for the last frame & the handoff)
+ */
+void RenderThread::frame()
+{
+    pthread_mutex_lock(&lock);
+    requested = true;
+    handed = false;
+    pthread_cond_broadcast(&wake);
+
+    while (!handed)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Run a function on the render thread between two frames & wait for it (ex. to create OpenGL resources)
+ *
+ * @param fn The function
+ */
+void RenderThread::call(std::function<void()> fn)
+{
+    pthread_mutex_lock(&lock);
+    tasks.push_back(fn);
+    uint ticket = ++queued;
+    pthread_cond_broadcast(&wake);
+
+    while (finished < ticket)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,169 @@
+// Dynamic Resolution for the Game Engine
+#pragma once
+
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+#include <GL/glad.h>
+
+#include <tools/debug.h>
+#include <tools/glstate.h>
+
+#include <engine/profiler.h>
+
+/**
+ * @brief Renders the 3D scene at a lower resolution when it's too slow (the result is upscaled to the window)
+ * @details The controller compares the GPU time of a pass (the profiler's "scene") to the target & scales the resolution,
+ * the cost of a pass grows with the pixels (scale^2). The target has the window's size, the scene is drawn into a part of it
+ */
+class Resolution
+{
+private:
+    uint fbo = 0, color = 0, depth = 0;
+    int width = 0, height = 0;    // the target's size
+    int drawn_w = 0, drawn_h = 0; // the scaled size of the last begin()
+
+    uint samples = 0; // the profiler's frames that were used
+
+    void resize(int w, int h);
+
+public:
+    bool enabled = false;
+
+    float target = 12.0f;       // the pass' GPU time budget (in ms)
+    float min = 0.5f;           // the smallest scale (per axis)
+    float max = 1.0f;           // the largest scale
+    float scale = 1.0f;         // the current scale (per axis)
+    std::string pass = "scene"; // the measured pass
+
+    void setup(float target, float min = 0.5f, float max = 1.0f);
+    void update(Profiler &profiler);
+
+    uint begin(int w, int h, int &sw, int &sh);
+    void end(int w, int h);
+};
+
+// Private Functions
+
+/**
+ * @brief (Re)allocate the target
+ *
+ * @param w The width
+ * @param h The height
+ */
+void Resolution::resize(int w, int h)
+{
+    if (fbo == 0)
+    {
+        glGenTextures(1, &color);
+        glGenTextures(1, &depth);
+        glGenFramebuffers(1, &fbo);
+    }
+
+    glstate::bind_texture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glstate::bind_texture(GL_TEXTURE_2D, depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+    glstate::bind_framebuffer(fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        debug::warning("Resolution::resize()", "the framebuffer is incomplete");
+
+    width = w;
+    height = h;
+}
+
+// Public Functions
+
+/**
+ * @brief Enable dynamic resolution (needs the profiler)
+ *
+ * @param target The measured pass' GPU time budget (in ms, ex. 12 for 60 FPS with time left for the rest)
+ * @param min The smallest scale (per axis)
+ * @param max The largest scale
+ */
+void Resolution::setup(float target, float min, float max)
+{
+    this->target = target;
+    this->min = min;
+    this->max = max;
+    this->scale = max;
+    this->enabled = true;
+}
+
+/**
+ * @brief Adjust the scale to the last measured frame (call once per frame, changes only with new measurements)
+ *
+ * @param profiler The profiler
+ */
+void Resolution::update(Profiler &profiler)
+{
+    if (!enabled || profiler.collected == samples)
+        return;
+    samples = profiler.collected;
+
+    float time = 0.0f;
+    for (auto &p : profiler.timeline)
+        if (p.name == pass)
+            time += p.gpu;
+
+    if (time <= 0.0f)
+        return;
+
+    // The scale that would hit the target (the time grows with the area)
+    float ideal = scale * sqrtf(target / time);
+
+    // Over the target, or well under it (so it doesn't oscillate around the target)
+    if (time > target || time < target * 0.85f)
+    {
+        // Step part of the way (the measurement is PROFILER_FRAMES frames old)
+        scale += (ideal - scale) * 0.25f;
+        scale = fminf(fmaxf(scale, min), max);
+    }
+}
+
+/**
+ * @brief Bind & clear the target for the 3D scene
+ *
+ * @param w The window's width
+ * @param h The window's height
+ * @param sw The scene's width (scaled)
+ * @param sh The scene's height (scaled)
+ * @return The target's framebuffer
+ */
+uint Resolution::begin(int w, int h, int &sw, int &sh)
+{
+    if (w != width || h != height)
+        resize(w, h);
+
+    sw = drawn_w = std::max((int)(w * scale + 0.5f), 1);
+    sh = drawn_h = std::max((int)(h * scale + 0.5f), 1);
+
+    glstate::bind_framebuffer(fbo);
+    glstate::viewport(0, 0, sw, sh);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    return fbo;
+}
+
+/**
+ * @brief Upscale the scene to the window
+ *
+ * @param w The window's width
+ * @param h The window's height
+ */
+void Resolution::end(int w, int h)
+{
+    // Read from the target (bound through the cache, so the next bind_framebuffer() binds both again)
+    glstate::bind_framebuffer(fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, glstate::screen);
+    glBlitFramebuffer(0, 0, drawn_w, drawn_h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    glstate::bind_framebuffer(0);
+    glstate::viewport(0, 0, w, h);
+}
@@ -0,0 +1,561 @@
+// Shadows for the Game Engine
+#pragma once
+
+#include <vector>
+#include <string.h>
+
+#include <tools/shader.h>
+#include <tools/glstate.h>
+
+#include <engine/proxy.h>
+#include <engine/culling.h>
+#include <engine/clusters.h>
+#include <engine/cascades.h>
+
+// The texture units of the shadow atlas & the cascades (see light.fs)
+#define SHADOW_UNIT 7
+#define CASCADE_UNIT 8
+
+// The uniform buffer binding point of the cascades (see light.fs)
+#define CASCADE_BINDING 1
+
+// The cube's faces (+X, -X, +Y, -Y, +Z, -Z): forward & up (same as in light.fs)
+const float __shadow_faces[6][2][3] = {
+    {{1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}},
+    {{-1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}},
+    {{0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+    {{0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+    {{0.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}},
+    {{0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}}};
+
+/**
+ * @brief A shadow casting light (one cube in the atlas)
+ */
+struct __shadow_light_t
+{
+    bool used = false;
+
+    vec3 position;
+    float range = 0.0f; // the shadow's far
+
+    uint dirty = 0; // faces to render (bit i is face i)
+
+    mat4 matrices[6]; // view-projection per face
+    frustum faces[6];
+};
+
+/**
+ * @brief The cascades, as laid out in the uniform buffer (std140)
+ */
+struct __cascade_block_t
+{
+    float matrices[CASCADE_COUNT][16]; // world-space to the maps' clip-space
+    float splits[CASCADE_COUNT][4];    // x: the cascades' far (a float array's stride is a vec4)
+    int count[4] = {0};                // x: cascades in use
+};
+
+/**
+ * @brief A shadow caster's last known state
+ */
+struct __shadow_caster_t
+{
+    bool casts = false;
+    vec3 min, max; // world-space bounds
+};
+
+/**
+ * @brief Cached point light shadows & the sun's cascaded shadows
+ * @details Every light gets 6 layers (one cube) of a shared depth texture array. The faces are only
+ * rendered again when a caster moves inside them (or the light moves), and every caster is only drawn
+ * into the faces it's in. Where the vertex shader can select the layer (ARB_shader_viewport_layer_array
+ * or AMD_vertex_shader_layer) the faces are instances of one draw, otherwise a geometry shader copies the
+ * triangles into the faces.
+ * The sun (one directional light) gets cascades, they follow the camera so they're rendered every frame & their
+ * matrices are published to the cascades' uniform block (at CASCADE_BINDING) with the maps.
+ * @warning Call setup() before adding lights
+ */
+class Shadows
+{
+private:
+    gls s = 0;
+    bool layered = false; // the layer is selected in the vertex shader?
+
+    // The depth shader's uniform locations (looked up once in setup())
+    int position_location = -1, far_location = -1, layer_location = -1, matrices_location = -1;
+    int faces_location = -1, mask_location = -1, model_location = -1;
+
+    uint atlas = 0;
+    uint fbo = 0;      // all layers attached (for drawing)
+    uint clearfbo = 0; // one layer attached (for clearing a face)
+
+    std::vector<__shadow_light_t> lights;
+    std::vector<__shadow_caster_t> casters; // per proxy
+
+    // Cascades
+    gls cascade_shader = 0;
+    uint cascademap = 0, cascadefbo = 0;
+    int cascade_location = -1, cascade_model_location = -1; // cascadeMatrix & model (looked up in sun())
+
+    bool sunlit = false;
+    vec3 sundir;
+    float distance = 100.0f, lambda = 0.75f;
+    uint cascade_resolution = 0;
+
+    uint cascadeubo = 0;
+    __cascade_block_t block;
+
+    void invalidate(vec3 min, vec3 max);
+    void publish();
+
+public:
+    uint resolution = 0; // size of the faces
+
+    cascade cascades[CASCADE_COUNT];
+    uint cascade_count = 0; // cascades in use (0 if there's no sun)
+
+    // Render Statistics (of the last frame)
+    uint faces = 0; // rendered faces (& cascades)
+    uint draws = 0; // caster draw calls
+
+    void setup(uint resolution = 512, uint capacity = 4);
+
+    int add(vec3 position, float range);
+    void move(int slot, vec3 position, float range);
+    void remove(int slot);
+    int layer(int slot);
+
+    void sun(vec3 direction, float distance = 100.0f, uint count = CASCADE_COUNT, uint resolution = 2048, float lambda = 0.75f);
+    void nosun();
+    void fit(mat4 view, mat4 projection, float near, float far);
+
+    void caster(uint id, vec3 min, vec3 max, bool casts, bool deformed = false);
+    void render(const std::vector<proxy> &proxies);
+};
+
+/**
+ * @brief Create the shadow atlas & load the depth shader
+ *
+ * @param resolution The size of a cube's faces
+ * @param capacity The maximal number of shadow casting lights
+ */
+void Shadows::setup(uint resolution, uint capacity)
+{
+    this->resolution = resolution;
+    lights.assign(capacity, __shadow_light_t());
+
+    // Depth Shader
+    layered = debug::glextension("GL_ARB_shader_viewport_layer_array") || debug::glextension("GL_AMD_vertex_shader_layer");
+
+    std::string vertex = shader::read("shadow_depth.vs");
+    std::string fragment = shader::read("shadow_depth.fs");
+
+    if (layered)
+        s = shader::load_raw(shader::define(vertex, {"LAYERED"}).c_str(), fragment.c_str());
+    else
+        s = shader::load_raw(vertex.c_str(), fragment.c_str(), shader::read("shadow_depth.gs").c_str());
+
+    position_location = glGetUniformLocation(s, "lightPos");
+    far_location = glGetUniformLocation(s, "far_plane");
+    layer_location = glGetUniformLocation(s, "layer");
+    matrices_location = glGetUniformLocation(s, "shadowMatrices");
+    faces_location = glGetUniformLocation(s, "faces");
+    mask_location = glGetUniformLocation(s, "faceMask");
+    model_location = glGetUniformLocation(s, "model");
+
+    // The Atlas
+    glGenTextures(1, &atlas);
+    glstate::bind_texture(GL_TEXTURE_2D_ARRAY, atlas, SHADOW_UNIT);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, capacity * 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &fbo);
+    glGenFramebuffers(1, &clearfbo);
+
+    glstate::bind_framebuffer(fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        debug::error("shadows::setup()", "shadow atlas is incomplete");
+
+    glstate::bind_framebuffer(clearfbo);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    glstate::bind_framebuffer(0);
+}
+
+/**
+ * @brief Add a shadow casting light
+ *
+ * @param position The light's position
+ * @param range The shadow's range (see clusters::radius())
+ * @return The light's slot (-1 if the atlas is full)
+ */
+int Shadows::add(vec3 position, float range)
+{
+    for (int i = 0; i < (int)lights.size(); i++)
+    {
+        if (!lights[i].used)
+        {
+            lights[i].used = true;
+            move(i, position, range);
+            return i;
+        }
+    }
+
+    debug::warning("shadows::add()", "too many shadow casting lights", ("max " + itos(lights.size())).c_str());
+    return -1;
+}
+
+/**
+ * @brief Move a shadow casting light (renders all of it's faces again)
+ *
+ * @param slot The light's slot
+ * @param position The new position
+ * @param range The new range
+ */
+void Shadows::move(int slot, vec3 position, float range)
+{
+    if (slot < 0 || slot >= (int)lights.size())
+        return;
+
+    __shadow_light_t &l = lights[slot];
+    l.position = position;
+    l.range = range;
+    l.dirty = 63;
+
+    mat4 projection = matrix::perspective(90.0f, 1.0f, 0.1f, range);
+    for (int f = 0; f < 6; f++)
+    {
+        vec3 forward = {__shadow_faces[f][0][0], __shadow_faces[f][0][1], __shadow_faces[f][0][2]};
+        vec3 up = {__shadow_faces[f][1][0], __shadow_faces[f][1][1], __shadow_faces[f][1][2]};
+
+        l.matrices[f] = matrix::lookAt(position, position + forward, up) * projection;
+        l.faces[f] = culling::extract(l.matrices[f]);
+    }
+}
+
+/**
+ * @brief Remove a shadow casting light
+ *
+ * @param slot The light's slot
+ */
+void Shadows::remove(int slot)
+{
+    if (slot >= 0 && slot < (int)lights.size())
+        lights[slot].used = false;
+}
+
+/**
+ * @brief Get the first layer of a light's cube in the atlas (see Light::set_shadow())
+ *
+ * @param slot The light's slot
+ * @return The layer (-1 if the light has no shadow)
+ */
+int Shadows::layer(int slot)
+{
+    if (slot < 0 || slot >= (int)lights.size() || !lights[slot].used)
+        return -1;
+    return slot * 6;
+}
+
+/**
+ * @brief Cast cascaded shadows from a directional light (the map is created at the first call)
+ *
+ * @param direction The light's direction
+ * @param distance The shadows' distance from the camera
+ * @param count The number of cascades (1 - CASCADE_COUNT)
+ * @param resolution The size of the cascades' maps
+ * @param lambda The split scheme (0 - uniform, 1 - logarithmic, see cascades::splits())
+ */
+void Shadows::sun(vec3 direction, float distance, uint count, uint resolution, float lambda)
+{
+    this->sunlit = true;
+    this->sundir = direction;
+    this->distance = distance;
+    this->lambda = lambda;
+    this->cascade_count = clamp(count, 1, CASCADE_COUNT);
+
+    if (cascade_shader == 0)
+    {
+        cascade_shader = shader::load("shadow_cascade");
+        cascade_location = glGetUniformLocation(cascade_shader, "cascadeMatrix");
+        cascade_model_location = glGetUniformLocation(cascade_shader, "model");
+        glGenTextures(1, &cascademap);
+
+        glGenFramebuffers(1, &cascadefbo);
+        glstate::bind_framebuffer(cascadefbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glstate::bind_framebuffer(0);
+    }
+
+    if (resolution != cascade_resolution)
+    {
+        cascade_resolution = resolution;
+
+        // Compared in the shader (sampler2DArrayShadow, with 2x2 filtering), outside the maps is lit
+        float border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+        glstate::bind_texture(GL_TEXTURE_2D_ARRAY, cascademap, CASCADE_UNIT);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, CASCADE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+}
+
+/**
+ * @brief Stop the cascaded shadows
+ */
+void Shadows::nosun()
+{
+    sunlit = false;
+    cascade_count = 0;
+}
+
+/**
+ * @brief Fit the cascades to the camera's view (call every frame, before render())
+ *
+ * @param view The camera's view matrix
+ * @param projection The camera's projection matrix (symmetric perspective)
+ * @param near The camera's near
+ * @param far The camera's far
+ */
+void Shadows::fit(mat4 view, mat4 projection, float near, float far)
+{
+    if (!sunlit)
+        return;
+
+    float split[CASCADE_COUNT + 1];
+    cascades::splits(near, fminf(far, distance), cascade_count, lambda, split);
+
+    for (uint i = 0; i < cascade_count; i++)
+    {
+        vec3 corners[8];
+        cascades::corners(view, projection, split[i], split[i + 1], corners);
+
+        // The casters can be up to the shadows' distance away from the slice
+        cascades[i] = cascades::fit(corners, sundir, cascade_resolution, distance);
+        cascades[i].near = split[i];
+        cascades[i].far = split[i + 1];
+    }
+}
+
+/**
+ * @brief Upload the cascades to their uniform block (the lit shaders read the same frame's cascades as the maps)
+ */
+void Shadows::publish()
+{
+    if (cascadeubo == 0)
+    {
+        glGenBuffers(1, &cascadeubo);
+        glstate::bind_buffer(GL_UNIFORM_BUFFER, cascadeubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(__cascade_block_t), NULL, GL_DYNAMIC_DRAW);
+    }
+
+    for (uint i = 0; i < cascade_count; i++)
+    {
+        memcpy(block.matrices[i], &cascades[i].matrix.m[0][0], sizeof(float) * 16);
+        block.splits[i][0] = cascades[i].far;
+    }
+    block.count[0] = (int)cascade_count;
+
+    glstate::bind_buffer(GL_UNIFORM_BUFFER, cascadeubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(__cascade_block_t), &block);
+    glstate::bind_buffer_base(GL_UNIFORM_BUFFER, CASCADE_BINDING, cascadeubo);
+}
+
+/**
+ * @brief Mark the faces that see a box for rendering
+ *
+ * @param min The box's minimum
+ * @param max The box's maximum
+ */
+void Shadows::invalidate(vec3 min, vec3 max)
+{
+    for (auto &l : lights)
+    {
+        if (!l.used || l.dirty == 63 || !clusters::touches(l.position, l.range, min, max))
+            continue;
+
+        for (int f = 0; f < 6; f++)
+            if (culling::aabb(l.faces[f], min, max) >= 0)
+                l.dirty |= 1 << f;
+    }
+}
+
+/**
+ * @brief Update a shadow caster (the faces it left & entered are rendered again)
+ *
+ * @param id The caster's render proxy
+ * @param min The world-space bounds' minimum
+ * @param max The world-space bounds' maximum
+ * @param casts does it cast shadows?
+ * @param deformed did it's vertices change? (the faces it's in are rendered again)
+ */
+void Shadows::caster(uint id, vec3 min, vec3 max, bool casts, bool deformed)
+{
+    if (id >= casters.size())
+        casters.resize(id + 1);
+
+    __shadow_caster_t &c = casters[id];
+
+    bool moved = c.min.x != min.x || c.min.y != min.y || c.min.z != min.z ||
+                 c.max.x != max.x || c.max.y != max.y || c.max.z != max.z;
+    if (c.casts == casts && (!casts || (!moved && !deformed)))
+        return;
+
+    if (c.casts)
+        invalidate(c.min, c.max);
+    if (casts)
+        invalidate(min, max);
+
+    c.casts = casts;
+    c.min = min;
+    c.max = max;
+}
+
+/**
+ * @brief Render the changed faces & the cascades (call once per frame, after fit() & before the scene)
+ *
+ * @param proxies The render proxies (indexed like the casters)
+ */
+void Shadows::render(const std::vector<proxy> &proxies)
+{
+    faces = 0;
+    draws = 0;
+
+    for (uint slot = 0; slot < (uint)lights.size() && atlas != 0; slot++)
+    {
+        __shadow_light_t &l = lights[slot];
+        if (!l.used || l.dirty == 0)
+            continue;
+
+        // Clear the faces
+        glstate::bind_framebuffer(clearfbo);
+        glstate::viewport(0, 0, resolution, resolution);
+        glstate::depthmask(true);
+
+        for (int f = 0; f < 6; f++)
+        {
+            if (l.dirty & (1 << f))
+            {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0, slot * 6 + f);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                faces++;
+            }
+        }
+
+        // Draw the casters
+        glstate::bind_framebuffer(fbo);
+        glstate::enable(GL_DEPTH_TEST);
+        glstate::depthfunc(GL_LESS);
+
+        shader::use(s);
+        glUniform3f(position_location, l.position.x, l.position.y, l.position.z);
+        glUniform1f(far_location, l.range);
+        glUniform1i(layer_location, slot * 6);
+        glUniformMatrix4fv(matrices_location, 6, GL_FALSE, &l.matrices[0].m[0][0]);
+
+        for (uint id = 0; id < (uint)casters.size() && id < (uint)proxies.size(); id++)
+        {
+            const __shadow_caster_t &c = casters[id];
+            if (!c.casts || !clusters::touches(l.position, l.range, c.min, c.max))
+                continue;
+
+            // The changed faces the caster is in
+            uint mask = 0, count = 0;
+            int list[6];
+            for (int f = 0; f < 6; f++)
+            {
+                if ((l.dirty & (1 << f)) && culling::aabb(l.faces[f], c.min, c.max) >= 0)
+                {
+                    list[count++] = f;
+                    mask |= 1 << f;
+                }
+            }
+
+            if (mask == 0)
+                continue;
+
+            const proxy &p = proxies[id];
+            glUniformMatrix4fv(model_location, 1, GL_FALSE, &p.model.m[0][0]);
+
+            glstate::bind_vertexarray(p.VAO);
+            if (layered)
+            {
+                glUniform1iv(faces_location, count, list);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, p.count, GL_UNSIGNED_INT, (void *)(sizeof(uint) * p.first_index), count, p.base_vertex);
+            }
+            else
+            {
+                glUniform1i(mask_location, mask);
+                glDrawElementsBaseVertex(GL_TRIANGLES, p.count, GL_UNSIGNED_INT, (void *)(sizeof(uint) * p.first_index), p.base_vertex);
+            }
+            glstate::stats.draws++;
+            draws++;
+        }
+
+        l.dirty = 0;
+    }
+
+    // The Cascades (casters in front of the maps are clamped to their near plane)
+    if (sunlit)
+    {
+        glstate::bind_framebuffer(cascadefbo);
+        glstate::viewport(0, 0, cascade_resolution, cascade_resolution);
+        glstate::enable(GL_DEPTH_TEST);
+        glstate::depthfunc(GL_LESS);
+        glstate::depthmask(true);
+        glstate::enable(GL_DEPTH_CLAMP);
+
+        shader::use(cascade_shader);
+
+        for (uint i = 0; i < cascade_count; i++)
+        {
+            const cascade &c = cascades[i];
+
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascademap, 0, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            faces++;
+
+            glUniformMatrix4fv(cascade_location, 1, GL_FALSE, &c.matrix.m[0][0]);
+
+            for (uint id = 0; id < (uint)casters.size() && id < (uint)proxies.size(); id++)
+            {
+                const __shadow_caster_t &k = casters[id];
+                if (!k.casts || culling::aabb(c.bounds, k.min, k.max) < 0)
+                    continue;
+
+                const proxy &p = proxies[id];
+                glUniformMatrix4fv(cascade_model_location, 1, GL_FALSE, &p.model.m[0][0]);
+
+                glstate::bind_vertexarray(p.VAO);
+                glDrawElementsBaseVertex(GL_TRIANGLES, p.count, GL_UNSIGNED_INT, (void *)(sizeof(uint) * p.first_index), p.base_vertex);
+                glstate::stats.draws++;
+                draws++;
+            }
+        }
+
+        glstate::disable(GL_DEPTH_CLAMP);
+    }
+
+    // (also without a sun, so the block is bound & it's count is 0)
+    publish();
+
+    glstate::bind_framebuffer(0);
+    if (atlas != 0)
+        glstate::bind_texture(GL_TEXTURE_2D_ARRAY, atlas, SHADOW_UNIT);
+    if (sunlit)
+        glstate::bind_texture(GL_TEXTURE_2D_ARRAY, cascademap, CASCADE_UNIT);
+}
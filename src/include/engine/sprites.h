@@ -0,0 +1,313 @@
+// 2D Sprite Batcher for the Game Engine
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <tools/glstate.h>
+#include <tools/shader.h>
+
+/**
+ * @brief The sprite types (same as in the 2D shader)
+ */
+typedef enum
+{
+    SPRITE_TEXTURED = 0, // only textured
+    SPRITE_COLORED = 1,  // only colored
+    SPRITE_MIXED = 2,    // texture mixed with the color (by the alpha)
+    SPRITE_TEXT = 3      // colored, the texture's red channel is the alpha
+} SPRITE_TYPE;
+
+/**
+ * @brief One queued quad
+ */
+struct sprite
+{
+    vec2 center, size; // in screen-space (-1 - 1)
+    vec3 color;
+    float alpha = 1.0f;
+
+    texture tex = 0;
+    SPRITE_TYPE type = SPRITE_COLORED;
+
+    int layer = 0; // z-order (higher is drawn later)
+    int clip = -1; // scissor rectangle (-1 if none)
+};
+
+/**
+ * @brief A scissor rectangle (in screen-space, -1 - 1)
+ */
+struct __sprite_clip_t
+{
+    vec2 center, size;
+};
+
+/**
+ * @brief Collects the 2D quads of a frame and draws them with as few draw calls as possible
+ * @details Quads are sorted by their layer (stable, so the order of calls is kept inside a layer), written into
+ * a streaming vertex buffer and drawn in runs, a new run only starts when the texture or the scissor changes
+ */
+class SpriteBatch
+{
+private:
+    gls s = 0;
+    uint VAO = 0, VBO = 0, EBO = 0;
+    uint capacity = 0; // quads in the index buffer
+
+    std::vector<sprite> sprites;
+    std::vector<__sprite_clip_t> clips;
+
+    std::vector<uint> order;
+    std::vector<float> vertices;
+
+    void reserve(uint quads);
+
+public:
+    int layer = 0; // layer of the next quads
+    int clip = -1; // scissor of the next quads
+
+    uint runs = 0; // draw calls of the last flush
+
+    void init(gls shader);
+    void add(vec2 center, vec2 size, vec3 color, texture tex, SPRITE_TYPE type, float alpha = 1.0f);
+
+    void scissor(vec2 center, vec2 size);
+    void noscissor();
+
+    void take(SpriteBatch &from);
+    void flush(int width, int height);
+};
+
+/**
+ * @brief Create the buffers
+ *
+ * @param shader The 2D shader
+ */
+void SpriteBatch::init(gls shader)
+{
+    this->s = shader;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glstate::bind_vertexarray(VAO);
+    glstate::bind_buffer(GL_ARRAY_BUFFER, VBO);
+
+    // {x, y, u, v, r, g, b, a, type} per vertex
+    int stride = 9 * sizeof(float);
+
+    // position attribute
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    // texture coord attribute
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void *)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    // color attribute
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void *)(4 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    // type attribute
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void *)(8 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+
+    reserve(256);
+}
+
+/**
+ * @brief Grow the index buffer (the indices of quads never change)
+ *
+ * @param quads The number of quads
+ */
+void SpriteBatch::reserve(uint quads)
+{
+    if (quads <= capacity)
+        return;
+
+    capacity = std::max(quads, capacity * 2);
+
+    std::vector<uint> indices;
+    indices.reserve(capacity * 6);
+    for (uint q = 0; q < capacity; q++)
+    {
+        uint v = q * 4;
+        indices.insert(indices.end(), {v + 0, v + 1, v + 3, // first triangle
+                                       v + 1, v + 2, v + 3}); // second triangle
+    }
+
+    glstate::bind_vertexarray(VAO);
+    glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Queue a quad
+ *
+ * @param center The center
+ * @param size The size
+ * @param color The color
+ * @param tex The texture
+ * @param type How to mix the texture and the color
+ * @param alpha The opacity (the mix factor for SPRITE_MIXED)
+ */
+void SpriteBatch::add(vec2 center, vec2 size, vec3 color, texture tex, SPRITE_TYPE type, float alpha)
+{
+    sprite sp;
+    sp.center = center;
+    sp.size = size;
+    sp.color = color;
+    sp.alpha = alpha;
+    sp.tex = tex;
+    sp.type = type;
+    sp.layer = this->layer;
+    sp.clip = this->clip;
+
+    sprites.push_back(sp);
+}
+
+/**
+ * @brief Clip the next quads to a rectangle
+ *
+ * @param center The rectangle's center
+ * @param size The rectangle's size
+ */
+void SpriteBatch::scissor(vec2 center, vec2 size)
+{
+    clips.push_back({center, size});
+    this->clip = (int)clips.size() - 1;
+}
+
+/**
+ * @brief Stop clipping the next quads
+ */
+void SpriteBatch::noscissor()
+{
+    this->clip = -1;
+}
+
+/**
+ * @brief Take another batch's quads (replaces the queued quads, the other batch starts a new frame)
+ * @details The batch that draws doesn't have to be the one that's filled (ex. the render thread draws while the next frame is queued)
+ *
+ * @param from The other batch
+ */
+void SpriteBatch::take(SpriteBatch &from)
+{
+    sprites.clear();
+    clips.clear();
+
+    sprites.swap(from.sprites);
+    clips.swap(from.clips);
+
+    from.clip = -1;
+    from.layer = 0;
+}
+
+/**
+ * @brief Draw the queued quads (call once, at the end of the frame)
+ *
+ * @param width The window's width
+ * @param height The window's height
+ */
+void SpriteBatch::flush(int width, int height)
+{
+    runs = 0;
+
+    if (!sprites.empty())
+    {
+        // Sort by layer (keeps the order of calls inside a layer)
+        order.resize(sprites.size());
+        for (uint i = 0; i < (uint)order.size(); i++)
+            order[i] = i;
+
+        std::stable_sort(order.begin(), order.end(), [this](uint a, uint b)
+                         { return sprites[a].layer < sprites[b].layer; });
+
+        // Build the vertices
+        vertices.clear();
+        vertices.reserve(sprites.size() * 4 * 9);
+
+        const float corners[4][4] = {
+            // positions      // texture coords
+            {1.0f, 1.0f, 1.0f, 1.0f},   // top right
+            {1.0f, -1.0f, 1.0f, 0.0f},  // bottom right
+            {-1.0f, -1.0f, 0.0f, 0.0f}, // bottom left
+            {-1.0f, 1.0f, 0.0f, 1.0f}   // top left
+        };
+
+        for (uint i : order)
+        {
+            const sprite &sp = sprites[i];
+            for (int c = 0; c < 4; c++)
+            {
+                vertices.insert(vertices.end(), {sp.center.x + corners[c][0] * sp.size.x / 2,
+                                                 sp.center.y + corners[c][1] * sp.size.y / 2,
+                                                 corners[c][2], corners[c][3],
+                                                 sp.color.x, sp.color.y, sp.color.z, sp.alpha,
+                                                 (float)sp.type});
+            }
+        }
+
+        reserve(sprites.size());
+
+        // Upload (re-specifying the buffer orphans the last frame's data)
+        glstate::bind_buffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STREAM_DRAW);
+
+        glstate::disable(GL_DEPTH_TEST);
+        glstate::enable(GL_BLEND);
+        glstate::blendfunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        shader::use(s);
+        glstate::bind_vertexarray(VAO);
+
+        // Draw in runs of the same texture & scissor (colored quads fit into any run)
+        for (size_t first = 0; first < order.size();)
+        {
+            const sprite &a = sprites[order[first]];
+            texture tex = a.type == SPRITE_COLORED ? 0 : a.tex;
+
+            size_t last = first + 1;
+            while (last < order.size())
+            {
+                const sprite &b = sprites[order[last]];
+                if (b.clip != a.clip)
+                    break;
+                if (b.type != SPRITE_COLORED)
+                {
+                    if (tex == 0)
+                        tex = b.tex;
+                    else if (b.tex != tex)
+                        break;
+                }
+                last++;
+            }
+
+            if (a.clip >= 0)
+            {
+                const __sprite_clip_t &c = clips[a.clip];
+                int x = (int)((c.center.x - c.size.x / 2 + 1.0f) / 2 * width);
+                int y = (int)((c.center.y - c.size.y / 2 + 1.0f) / 2 * height);
+
+                glstate::enable(GL_SCISSOR_TEST);
+                glstate::scissor(x, y, (int)(c.size.x / 2 * width), (int)(c.size.y / 2 * height));
+            }
+            else
+                glstate::disable(GL_SCISSOR_TEST);
+
+            glstate::bind_texture(GL_TEXTURE_2D, tex);
+            glDrawElements(GL_TRIANGLES, (last - first) * 6, GL_UNSIGNED_INT, (void *)(sizeof(uint) * 6 * first));
+            glstate::stats.draws++;
+            runs++;
+
+            first = last;
+        }
+
+        glstate::disable(GL_SCISSOR_TEST);
+        glstate::disable(GL_BLEND);
+    }
+
+    sprites.clear();
+    clips.clear();
+    this->clip = -1;
+    this->layer = 0;
+}
@@ -0,0 +1,511 @@
+// Heightmap Terrain for the Game Engine
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <math.h>
+
+#include <GL/glad.h>
+
+#include <tools/types.h>
+#include <tools/debug.h>
+#include <tools/glstate.h>
+#include <tools/shader.h>
+#include <tools/loadin.h>
+
+#include <engine/culling.h>
+
+// Quads per side of a patch (the shared grid mesh, even for the morphing)
+#define TERRAIN_PATCH 32
+
+// The most LOD levels (the size of the terrain shader's morph array)
+#define TERRAIN_LEVELS 16
+
+/**
+ * @brief A heightfield collider (heights on a regular grid, so a ground query is O(1))
+ * @details The heights are interpolated on the same triangles as the terrain's finest level
+ */
+struct heightfield
+{
+    int width = 0, depth = 0;   // samples along x & z
+    vec3 position;              // the minimum corner (y is the height of black)
+    vec3 size;                  // in world-space (y is the height of white)
+    std::vector<float> heights; // in world-space, per sample (rows along x, from the minimum z)
+
+    bool inside(float x, float z);
+    float sample(int i, int j);
+    float height(float x, float z);
+    vec3 normal(float x, float z);
+    bool below(vec3 point, float *depth = NULL);
+};
+
+/**
+ * @brief Is a point above the heightfield? (outside it the edges are extended)
+ *
+ * @param x The point's x
+ * @param z The point's z
+ */
+bool heightfield::inside(float x, float z)
+{
+    return x >= this->position.x && x <= this->position.x + this->size.x && z >= this->position.z && z <= this->position.z + this->size.z;
+}
+
+/**
+ * @brief Get a sample (clamped to the edges)
+ *
+ * @param i The sample's column (along x)
+ * @param j The sample's row (along z)
+ * @return The sample's height
+ */
+float heightfield::sample(int i, int j)
+{
+    i = std::min(std::max(i, 0), this->width - 1);
+    j = std::min(std::max(j, 0), this->depth - 1);
+    return this->heights[(size_t)j * this->width + i];
+}
+
+/**
+ * @brief Get the height of the ground
+ *
+ * @param x The point's x
+ * @param z The point's z
+ * @return The ground's height under (or over) the point
+ */
+float heightfield::height(float x, float z)
+{
+    if (this->width < 2 || this->depth < 2)
+        return this->position.y;
+
+    float gx = (x - this->position.x) / this->size.x * (float)(this->width - 1);
+    float gz = (z - this->position.z) / this->size.z * (float)(this->depth - 1);
+    gx = fminf(fmaxf(gx, 0.0f), (float)(this->width - 1));
+    gz = fminf(fmaxf(gz, 0.0f), (float)(this->depth - 1));
+
+    int i = std::min((int)gx, this->width - 2);
+    int j = std::min((int)gz, this->depth - 2);
+    float fx = gx - (float)i, fz = gz - (float)j;
+
+    float a = sample(i, j), b = sample(i + 1, j);
+    float c = sample(i, j + 1), d = sample(i + 1, j + 1);
+
+    // The quads are split from (i + 1, j) to (i, j + 1), like the terrain's patches
+    if (fx + fz <= 1.0f)
+        return a + (b - a) * fx + (c - a) * fz;
+    return d + (c - d) * (1.0f - fx) + (b - d) * (1.0f - fz);
+}
+
+/**
+ * @brief Get the normal of the ground (central differences)
+ *
+ * @param x The point's x
+ * @param z The point's z
+ * @return The ground's normal
+ */
+vec3 heightfield::normal(float x, float z)
+{
+    float sx = this->size.x / (float)std::max(this->width - 1, 1);
+    float sz = this->size.z / (float)std::max(this->depth - 1, 1);
+
+    float dx = height(x + sx, z) - height(x - sx, z);
+    float dz = height(x, z + sz) - height(x, z - sz);
+
+    return vector::normalize({-dx / (2.0f * sx), 1.0f, -dz / (2.0f * sz)});
+}
+
+/**
+ * @brief Is a point under the ground?
+ *
+ * @param point The point
+ * @param depth The point's depth under the ground (negative above it, optional)
+ */
+bool heightfield::below(vec3 point, float *depth)
+{
+    float d = height(point.x, point.z) - point.y;
+    if (depth != NULL)
+        *depth = d;
+    return d > 0.0f;
+}
+
+/**
+ * @brief A node of the terrain's quadtree
+ */
+struct __terrain_node_t
+{
+    int x = 0, z = 0;       // the first sample
+    int size = 0;           // in samples (TERRAIN_PATCH << level)
+    uint level = 0;         // 0 - the finest
+    float min = 0, max = 0; // the heights under the node
+    int children[4] = {-1, -1, -1, -1};
+};
+
+/**
+ * @brief A heightmap terrain, drawn with continuous LOD (CDLOD)
+ * @details The heightmap is split into a quadtree, every node is drawn with the same grid mesh (TERRAIN_PATCH quads per side),
+ * so a node of level L has a sample per 2^L samples. A node is divided when the camera is in the next level's range (ranges
+ * double per level), so neighbours differ by at most one level. Near the end of their range the vertices morph to the next
+ * level's grid, so there are no cracks or pops. The nodes outside the view are culled & every visible node is one instance
+ * of a single draw. The ground is a heightfield collider
+ */
+class Terrain
+{
+private:
+    gls s = 0;
+    uint VAO = 0, VBO = 0, EBO = 0, instanceVBO = 0;
+    uint heightmap = 0; // the heights' texture (one texel per sample)
+    uint indices = 0;
+
+    std::vector<__terrain_node_t> nodes; // the root is the first
+    uint levels = 0;
+
+    std::vector<float> diagonals;      // per level: the longest diagonal of it's nodes' bounds
+    std::vector<float> ranges, morphs; // per level: the range & the start of the morphing
+
+    std::vector<float> instances; // {x, z, size, level} per selected node
+
+    int build(int x, int z, uint level);
+    void fit();
+    vec3 corner(float x, float height, float z);
+    void select(int node, const frustum &f, vec3 eye);
+
+public:
+    heightfield ground; // the collider (see heightfield::height())
+
+    texture tex = 0;                 // the surface's texture (0 - only colored)
+    vec3 color = {1.0f, 1.0f, 1.0f}; // multiplies the texture
+    float tiling = 1.0f;             // the texture's repeats over the terrain
+    vec3 light = {0.4f, 1.0f, 0.3f}; // the direction of the light
+    float detail = 3.0f;             // the finest level's range (in the finest patches' sizes)
+
+    // Statistics (of the last draw)
+    uint patches = 0; // drawn nodes
+    uint culled = 0;  // nodes outside the view
+
+    bool load(std::string path, vec3 size, vec3 position = {});
+    bool load(const bitmap &image, vec3 size, vec3 position = {});
+    bool loaded();
+
+    void draw(mat4 view, mat4 projection, vec3 eye);
+};
+
+// Private Functions
+
+/**
+ * @brief Build a node & it's children (with their bounds)
+ *
+ * @param x The node's first sample (along x)
+ * @param z The node's first sample (along z)
+ * @param level The node's level
+ * @return The node's index (-1 if it's outside the heightmap)
+ */
+int Terrain::build(int x, int z, uint level)
+{
+    if (x >= ground.width - 1 || z >= ground.depth - 1)
+        return -1;
+
+    int index = (int)nodes.size();
+    nodes.push_back(__terrain_node_t());
+
+    __terrain_node_t n;
+    n.x = x;
+    n.z = z;
+    n.size = TERRAIN_PATCH << level;
+    n.level = level;
+
+    if (level == 0)
+    {
+        n.min = n.max = ground.sample(x, z);
+        for (int j = z; j <= std::min(z + n.size, ground.depth - 1); j++)
+            for (int i = x; i <= std::min(x + n.size, ground.width - 1); i++)
+            {
+                n.min = fminf(n.min, ground.sample(i, j));
+                n.max = fmaxf(n.max, ground.sample(i, j));
+            }
+    }
+    else
+    {
+        int half = n.size / 2;
+        n.min = INFINITY;
+        n.max = -INFINITY;
+
+        for (int c = 0; c < 4; c++)
+        {
+            n.children[c] = build(x + (c % 2) * half, z + (c / 2) * half, level - 1);
+            if (n.children[c] >= 0)
+            {
+                n.min = fminf(n.min, nodes[n.children[c]].min);
+                n.max = fmaxf(n.max, nodes[n.children[c]].max);
+            }
+        }
+    }
+
+    // The node's diagonal (see fit())
+    float sx = (float)n.size * ground.size.x / (float)(ground.width - 1);
+    float sz = (float)n.size * ground.size.z / (float)(ground.depth - 1);
+    float sy = n.max - n.min;
+    diagonals[level] = fmaxf(diagonals[level], sqrtf(sx * sx + sy * sy + sz * sz));
+
+    nodes[index] = n;
+    return index;
+}
+
+/**
+ * @brief Fit the levels' ranges to the detail
+ * @details The nodes of a level border the next level's nodes at most a diagonal farther than the previous level's range,
+ * so every level's morphing starts there: at the borders of two levels the finer one is fully morphed & the coarser one isn't
+ */
+void Terrain::fit()
+{
+    float spacing = fmaxf(ground.size.x / (float)(ground.width - 1), ground.size.z / (float)(ground.depth - 1));
+
+    ranges.assign(levels, 0.0f);
+    morphs.assign(levels, 0.0f);
+
+    ranges[0] = fmaxf(detail, 1.0f) * TERRAIN_PATCH * spacing;
+    morphs[0] = ranges[0] * 0.7f;
+
+    for (uint l = 1; l < levels; l++)
+    {
+        morphs[l] = ranges[l - 1] + diagonals[l];
+        ranges[l] = fmaxf(ranges[l - 1] * 2.0f, morphs[l] * 1.25f);
+    }
+}
+
+/**
+ * @brief Get the world-space position of a sample
+ *
+ * @param x The sample's x (clamped to the heightmap)
+ * @param height The height
+ * @param z The sample's z
+ */
+vec3 Terrain::corner(float x, float height, float z)
+{
+    x = fminf(x, (float)(ground.width - 1));
+    z = fminf(z, (float)(ground.depth - 1));
+
+    return {ground.position.x + x * ground.size.x / (float)(ground.width - 1), height,
+            ground.position.z + z * ground.size.z / (float)(ground.depth - 1)};
+}
+
+/**
+ * @brief Select the drawn nodes of a subtree (culls the nodes outside the view)
+ *
+ * @param node The subtree's root
+ * @param f The camera's frustum
+ * @param eye The camera's position
+ */
+void Terrain::select(int node, const frustum &f, vec3 eye)
+{
+    const __terrain_node_t &n = nodes[node];
+
+    vec3 min = corner((float)n.x, n.min, (float)n.z);
+    vec3 max = corner((float)(n.x + n.size), n.max, (float)(n.z + n.size));
+
+    if (culling::aabb(f, min, max) < 0)
+    {
+        culled++;
+        return;
+    }
+
+    // The distance of the camera from the node's bounds
+    float dx = fmaxf(fmaxf(min.x - eye.x, eye.x - max.x), 0.0f);
+    float dy = fmaxf(fmaxf(min.y - eye.y, eye.y - max.y), 0.0f);
+    float dz = fmaxf(fmaxf(min.z - eye.z, eye.z - max.z), 0.0f);
+
+    // Divided, if the camera is in the next level's range
+    if (n.level > 0 && dx * dx + dy * dy + dz * dz < ranges[n.level - 1] * ranges[n.level - 1])
+    {
+        for (int c = 0; c < 4; c++)
+            if (n.children[c] >= 0)
+                select(n.children[c], f, eye);
+        return;
+    }
+
+    instances.push_back((float)n.x);
+    instances.push_back((float)n.z);
+    instances.push_back((float)n.size);
+    instances.push_back((float)n.level);
+    patches++;
+}
+
+// Public Functions
+
+/**
+ * @brief Load a terrain from a heightmap image (needs the OpenGL context, see Engine::gl())
+ *
+ * @param path The heightmap's path (the red channel is the height)
+ * @param size The terrain's size (y is the height of white)
+ * @param position The terrain's minimum corner (y is the height of black)
+ * @return is it loaded?
+ */
+bool Terrain::load(std::string path, vec3 size, vec3 position)
+{
+    return load(loadin::decode(path), size, position);
+}
+
+/**
+ * @brief Load a terrain from the pixels of a heightmap (needs the OpenGL context, see Engine::gl())
+ *
+ * @param image The heightmap (the red channel is the height)
+ * @param size The terrain's size (y is the height of white)
+ * @param position The terrain's minimum corner (y is the height of black)
+ * @return is it loaded?
+ */
+bool Terrain::load(const bitmap &image, vec3 size, vec3 position)
+{
+    if (image.width < 2 || image.height < 2 || image.channels < 1)
+    {
+        debug::warning("Terrain::load()", "the heightmap is too small");
+        return false;
+    }
+
+    // The Collider
+    ground.width = image.width;
+    ground.depth = image.height;
+    ground.position = position;
+    ground.size = size;
+
+    ground.heights.resize((size_t)image.width * image.height);
+    for (size_t i = 0; i < ground.heights.size(); i++)
+        ground.heights[i] = position.y + (float)image.pixels[i * image.channels] / 255.0f * size.y;
+
+    // The Quadtree (the root covers the whole heightmap)
+    levels = 1;
+    while ((TERRAIN_PATCH << (levels - 1)) < std::max(image.width, image.height) - 1 && levels < TERRAIN_LEVELS)
+        levels++;
+
+    nodes.clear();
+    diagonals.assign(levels, 0.0f);
+    build(0, 0, levels - 1);
+
+    // The Heights' Texture
+    if (heightmap == 0)
+        glGenTextures(1, &heightmap);
+
+    glstate::bind_texture(GL_TEXTURE_2D, heightmap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, ground.width, ground.depth, 0, GL_RED, GL_FLOAT, &ground.heights[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // The Patch (a grid, shared by every node)
+    if (VAO == 0)
+    {
+        std::vector<float> grid;
+        for (int j = 0; j <= TERRAIN_PATCH; j++)
+            for (int i = 0; i <= TERRAIN_PATCH; i++)
+            {
+                grid.push_back((float)i);
+                grid.push_back((float)j);
+            }
+
+        // Split from (i + 1, j) to (i, j + 1), like heightfield::height()
+        std::vector<uint> quads;
+        for (uint j = 0; j < TERRAIN_PATCH; j++)
+            for (uint i = 0; i < TERRAIN_PATCH; i++)
+            {
+                uint a = j * (TERRAIN_PATCH + 1) + i, b = a + 1;
+                uint c = a + TERRAIN_PATCH + 1, d = c + 1;
+                quads.insert(quads.end(), {a, c, b, b, c, d});
+            }
+        indices = (uint)quads.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &instanceVBO);
+
+        glstate::bind_vertexarray(VAO);
+        glstate::bind_buffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * grid.size(), &grid[0], GL_STATIC_DRAW);
+        glstate::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * quads.size(), &quads[0], GL_STATIC_DRAW);
+
+        // grid attribute
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+
+        // node attribute (per instance)
+        glstate::bind_buffer(GL_ARRAY_BUFFER, instanceVBO);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+    }
+
+    debug::log("Terrain::load()", "loaded terrain");
+    return true;
+}
+
+/**
+ * @brief Is a terrain loaded?
+ */
+bool Terrain::loaded()
+{
+    return !nodes.empty();
+}
+
+/**
+ * @brief Select the nodes & draw them (one instanced draw)
+ *
+ * @param view The camera's view matrix
+ * @param projection The camera's projection matrix
+ * @param eye The camera's position (the LOD's center)
+ */
+void Terrain::draw(mat4 view, mat4 projection, vec3 eye)
+{
+    patches = culled = 0;
+    if (nodes.empty())
+        return;
+
+    // Select & upload the nodes
+    fit();
+    instances.clear();
+    select(0, culling::extract(view * projection), eye);
+
+    if (patches == 0)
+        return;
+
+    glstate::bind_buffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * instances.size(), &instances[0], GL_STREAM_DRAW);
+
+    if (s == 0)
+        s = shader::load("terrain");
+
+    shader::use(s);
+    shader::set(s, "view", view);
+    shader::set(s, "projection", projection);
+    shader::set(s, "camera", eye);
+
+    vec2 samples = {(float)ground.width, (float)ground.depth};
+    vec2 spacing = {ground.size.x / (float)(ground.width - 1), ground.size.z / (float)(ground.depth - 1)};
+
+    shader::set(s, "samples", samples);
+    shader::set(s, "origin", ground.position);
+    shader::set(s, "spacing", spacing);
+    shader::set(s, "cells", (float)TERRAIN_PATCH);
+
+    for (uint l = 0; l < levels; l++)
+    {
+        vec2 morph = {morphs[l], ranges[l]};
+        shader::set(s, "morph[" + std::to_string(l) + "]", morph);
+    }
+
+    shader::set(s, "color", color);
+    shader::set(s, "light", light);
+    shader::set(s, "tiling", tiling);
+    shader::set(s, "textured", tex != 0);
+    shader::set(s, "tex", 0);
+    shader::set(s, "heights", 1);
+
+    if (tex != 0)
+        glstate::bind_texture(GL_TEXTURE_2D, tex);
+    glstate::bind_texture(GL_TEXTURE_2D, heightmap, 1);
+
+    glstate::enable(GL_DEPTH_TEST);
+    glstate::disable(GL_BLEND);
+
+    glstate::bind_vertexarray(VAO);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indices, GL_UNSIGNED_INT, (void *)0, patches, 0);
+}
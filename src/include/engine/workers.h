@@ -0,0 +1,213 @@
+// Worker Threads for the Game Engine
+#pragma once
+
+#include <pthread.h>
+#include <functional>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include <tools/debug.h>
+
+#define WORKER_GRAIN 1024 // the smallest range worth sending to another thread (in items)
+
+class Workers;
+
+/**
+ * @brief A worker thread's data
+ */
+struct __worker_t
+{
+    Workers *pool;
+    uint index; // the thread's range (0 is the calling thread)
+    pthread_t thread;
+};
+
+/**
+ * @brief A pool of worker threads that split loops into contiguous ranges
+ * @details run() gives every thread (the calling thread too) one contiguous range of the items & returns when all of them
+ * are done. Jobs only write their own range (or their own worker's output), so the results don't depend on the number of threads
+ */
+class Workers
+{
+private:
+    std::vector<__worker_t> threads;
+
+    pthread_mutex_t lock;
+    pthread_mutex_t busy; // held by run() (the main & the render thread can both use the pool)
+    pthread_cond_t wake, done;
+
+    bool online = false;
+    uint generation = 0; // increased by every run()
+    uint pending = 0;    // threads still working on the current run()
+
+    // The current job
+    std::function<void(size_t, size_t, uint)> job;
+    size_t items = 0;
+    uint ranges = 0;
+
+    static void *worker_thread(void *pointer);
+
+public:
+    ~Workers();
+
+    void setup(int count = -1);
+    void stop();
+
+    uint size();
+    void run(size_t n, std::function<void(size_t first, size_t last, uint worker)> fn, size_t grain = WORKER_GRAIN);
+};
+
+// Private Functions
+
+void *Workers::worker_thread(void *pointer)
+{
+    __worker_t *w = (__worker_t *)pointer;
+    Workers *pool = w->pool;
+
+    uint seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true)
+    {
+        // Wait for the next run()
+        while (pool->online && pool->generation == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+
+        if (!pool->online)
+            break;
+
+        seen = pool->generation;
+        size_t n = pool->items;
+        uint r = pool->ranges;
+        pthread_mutex_unlock(&pool->lock);
+
+        // The job isn't changed until every thread is done
+        if (w->index < r)
+            pool->job(n * w->index / r, n * (w->index + 1) / r, w->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+// Public Functions
+
+Workers::~Workers()
+{
+    stop();
+}
+
+/**
+ * @brief Start the worker threads
+ *
+ * @param count The number of threads besides the calling thread (-1 = one per core, except the calling thread's)
+ */
+void Workers::setup(int count)
+{
+    stop();
+
+    if (count < 0)
+        count = std::max(SDL_GetCPUCount() - 1, 0);
+    if (count == 0)
+        return;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_mutex_init(&busy, NULL);
+    pthread_cond_init(&wake, NULL);
+    pthread_cond_init(&done, NULL);
+
+    online = true;
+    generation = 0;
+
+    // The threads keep pointers to their data (so it's not resized after this)
+    threads.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        threads[i].pool = this;
+        threads[i].index = i + 1;
+
+        if (pthread_create(&threads[i].thread, NULL, worker_thread, &threads[i]) != 0)
+        {
+            debug::warning("Workers::setup()", "can't create a worker thread", "using less threads");
+            threads.resize(i);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Stop the worker threads (run() works on the calling thread after this)
+ */
+void Workers::stop()
+{
+    if (!online)
+        return;
+
+    pthread_mutex_lock(&lock);
+    online = false;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    for (auto &w : threads)
+        pthread_join(w.thread, NULL);
+    threads.clear();
+
+    pthread_mutex_destroy(&lock);
+    pthread_mutex_destroy(&busy);
+    pthread_cond_destroy(&wake);
+    pthread_cond_destroy(&done);
+}
+
+/**
+ * @brief Get the number of threads (the worker indices of run() are below this)
+ *
+ * @return The worker threads + the calling thread
+ */
+uint Workers::size()
+{
+    return (uint)threads.size() + 1;
+}
+
+/**
+ * @brief Run a job on every thread & wait for it (don't call run() from a job, other threads' run() calls wait)
+ *
+ * @param n The number of items
+ * @param fn The job, called with a contiguous range of the items ([first, last)) & the worker's index (0 - size())
+ * @param grain The smallest range (less items run on fewer threads)
+ */
+void Workers::run(size_t n, std::function<void(size_t first, size_t last, uint worker)> fn, size_t grain)
+{
+    if (n == 0)
+        return;
+
+    size_t r = std::min((size_t)size(), (n + grain - 1) / std::max(grain, (size_t)1));
+    if (r <= 1)
+    {
+        fn(0, n, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&busy);
+    pthread_mutex_lock(&lock);
+    job = fn;
+    items = n;
+    ranges = (uint)r;
+    pending = (uint)threads.size();
+    generation++;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    // The calling thread takes the first range
+    fn(0, n / r, 0);
+
+    pthread_mutex_lock(&lock);
+    while (pending > 0)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&busy);
+}
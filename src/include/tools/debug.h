@@ -5,6 +5,8 @@
 #include <tools/utility.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <iostream>
+#include <fstream>
 
 /**
  * @brief The log library
@@ -214,6 +216,32 @@ namespace debug
         va_end(l);
     }
 
+    /**
+     * @brief Check if the OpenGL driver supports an extension
+     *
+     * @param name The extension's name (ex. "GL_ARB_multi_draw_indirect")
+     * @return is it supported?
+     */
+    bool glextension(std::string name)
+    {
+        static std::vector<std::string> extensions;
+        static bool queried = false;
+
+        if (!queried)
+        {
+            int n = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+            for (int i = 0; i < n; i++)
+                extensions.push_back((const char *)glGetStringi(GL_EXTENSIONS, i));
+            queried = true;
+        }
+
+        for (auto &e : extensions)
+            if (e == name)
+                return true;
+        return false;
+    }
+
     /**
      * @brief Print out GL Info
      */
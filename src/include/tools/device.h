@@ -0,0 +1,777 @@
+// Render Devices for the Game Engine
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <GL/glad.h>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <tools/debug.h>
+#include <tools/glstate.h>
+
+/**
+ * @brief The OpenGL functions of the engine (used by the devices that replace OpenGL, see NullDevice)
+ * @warning Add new functions here, when the engine starts using them
+ */
+#define GL_FUNCTIONS(X)              \
+    X(glActiveTexture)               \
+    X(glAttachShader)                \
+    X(glBindBuffer)                  \
+    X(glBindBufferBase)              \
+    X(glBindFramebuffer)             \
+    X(glBindTexture)                 \
+    X(glBindVertexArray)             \
+    X(glBlendFunc)                   \
+    X(glBlitFramebuffer)             \
+    X(glBufferData)                  \
+    X(glBufferStorage)               \
+    X(glBufferSubData)               \
+    X(glCheckFramebufferStatus)      \
+    X(glClear)                       \
+    X(glClearColor)                  \
+    X(glClientWaitSync)              \
+    X(glColorMask)                   \
+    X(glCompileShader)               \
+    X(glCopyBufferSubData)           \
+    X(glCreateProgram)               \
+    X(glCreateShader)                \
+    X(glDeleteBuffers)               \
+    X(glDeleteProgram)               \
+    X(glDeleteShader)                \
+    X(glDeleteSync)                  \
+    X(glDepthFunc)                   \
+    X(glDepthMask)                   \
+    X(glDisable)                     \
+    X(glDisableVertexAttribArray)    \
+    X(glDrawBuffer)                  \
+    X(glDrawElements)                \
+    X(glDrawElementsBaseVertex)      \
+    X(glDrawElementsInstancedBaseVertex) \
+    X(glEnable)                      \
+    X(glEnableVertexAttribArray)     \
+    X(glFenceSync)                   \
+    X(glFramebufferTexture)          \
+    X(glFramebufferTextureLayer)     \
+    X(glGenBuffers)                  \
+    X(glGenFramebuffers)             \
+    X(glGenQueries)                  \
+    X(glGenTextures)                 \
+    X(glGenVertexArrays)             \
+    X(glGetAttribLocation)           \
+    X(glGetError)                    \
+    X(glGetIntegerv)                 \
+    X(glGetProgramBinary)            \
+    X(glGetProgramInfoLog)           \
+    X(glGetProgramiv)                \
+    X(glGetQueryObjectiv)            \
+    X(glGetQueryObjectui64v)         \
+    X(glGetShaderInfoLog)            \
+    X(glGetShaderiv)                 \
+    X(glGetString)                   \
+    X(glGetStringi)                  \
+    X(glGetUniformBlockIndex)        \
+    X(glGetUniformLocation)          \
+    X(glLinkProgram)                 \
+    X(glMapBufferRange)              \
+    X(glMultiDrawElementsIndirect)   \
+    X(glPixelStorei)                 \
+    X(glProgramBinary)               \
+    X(glProgramParameteri)           \
+    X(glQueryCounter)                \
+    X(glReadBuffer)                  \
+    X(glReadPixels)                  \
+    X(glScissor)                     \
+    X(glShaderSource)                \
+    X(glTexBuffer)                   \
+    X(glTexImage2D)                  \
+    X(glTexImage3D)                  \
+    X(glTexParameterfv)              \
+    X(glTexParameteri)               \
+    X(glUniform1f)                   \
+    X(glUniform1i)                   \
+    X(glUniform1iv)                  \
+    X(glUniform2f)                   \
+    X(glUniform3f)                   \
+    X(glUniformBlockBinding)         \
+    X(glUniformMatrix4fv)            \
+    X(glUseProgram)                  \
+    X(glVertexAttribDivisor)         \
+    X(glVertexAttribPointer)         \
+    X(glViewport)
+
+/**
+ * @brief The OpenGL functions' ids (GLF_glDrawElements, ...)
+ */
+typedef enum
+{
+#define __GL_FUNCTION_ID(name) GLF_##name,
+    GL_FUNCTIONS(__GL_FUNCTION_ID)
+#undef __GL_FUNCTION_ID
+        GL_FUNCTION_COUNT
+} GL_FUNCTION;
+
+/**
+ * @brief The OpenGL functions' names (by GL_FUNCTION)
+ */
+const char *gl_function_names[GL_FUNCTION_COUNT] = {
+#define __GL_FUNCTION_NAME(name) #name,
+    GL_FUNCTIONS(__GL_FUNCTION_NAME)
+#undef __GL_FUNCTION_NAME
+};
+
+/**
+ * @brief The device types
+ */
+typedef enum
+{
+    DEVICE_GL = 0,      // SDL2 window with an OpenGL context
+    DEVICE_NULL = 1,    // no OpenGL, the commands are only counted (see NullDevice)
+    DEVICE_HEADLESS = 2 // OpenGL without a window (EGL surfaceless, ex. Mesa llvmpipe), renders into a framebuffer
+} DEVICE_TYPE;
+
+/**
+ * @brief A render device (owns the OpenGL context & the surface it renders to)
+ * @details The engine talks to OpenGL through glad's function table, a device fills that table when it opens
+ */
+class Device
+{
+public:
+    DEVICE_TYPE type;
+
+    Device(DEVICE_TYPE type) : type(type) {}
+    virtual ~Device() {}
+
+    /**
+     * @brief Create the context (& the surface) and load OpenGL
+     *
+     * @param title The window's title
+     * @param width The surface's width (the window's size is returned)
+     * @param height The surface's height (the window's size is returned)
+     * @param fullscreen is the window fullscreen?
+     * @param vsync is vsync enabled?
+     */
+    virtual void open(std::string title, int &width, int &height, bool fullscreen, bool vsync) = 0;
+
+    /**
+     * @brief Show the frame
+     */
+    virtual void present() = 0;
+
+    /**
+     * @brief Get the surface's size
+     *
+     * @param width The width
+     * @param height The height
+     */
+    virtual void size(int &width, int &height) = 0;
+
+    /**
+     * @brief Destroy the context & the surface
+     */
+    virtual void close() = 0;
+
+    /**
+     * @brief Get an OpenGL function (ex. extension functions, that glad doesn't load)
+     *
+     * @param name The function's name
+     * @return The function (NULL if not found)
+     */
+    virtual void *proc(const char *name) = 0;
+
+    /**
+     * @brief Read the last frame's pixels
+     *
+     * @param pixels The pixels (RGBA, bottom row first)
+     * @return could it be read?
+     */
+    virtual bool read(std::vector<unsigned char> &pixels) { return false; }
+
+    /**
+     * @brief Does the device have a window (with mouse & keyboard inputs)?
+     */
+    virtual bool windowed() { return false; }
+
+    /**
+     * @brief Make the context current on the calling thread, or release it (so another thread can take it)
+     *
+     * @param on take it? (else release it)
+     */
+    virtual void current(bool on) {}
+};
+
+// OpenGL (SDL2 Window)
+
+/**
+ * @brief The default device: an SDL2 window with an OpenGL 3.3 Core (or higher) context
+ */
+class GLDevice : public Device
+{
+private:
+    SDL_Window *window = NULL;
+    SDL_GLContext glcontext = NULL;
+
+public:
+    GLDevice() : Device(DEVICE_GL) {}
+
+    void open(std::string title, int &width, int &height, bool fullscreen, bool vsync);
+    void present();
+    void size(int &width, int &height);
+    void close();
+    void *proc(const char *name);
+    bool read(std::vector<unsigned char> &pixels);
+    bool windowed() { return true; }
+    void current(bool on);
+};
+
+void GLDevice::open(std::string title, int &width, int &height, bool fullscreen, bool vsync)
+{
+    // Init SDL2 & OpenGL
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+        debug::error("GLDevice::open()", "failed to init SDL2", SDL_GetError());
+
+    this->window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_FULLSCREEN_DESKTOP * fullscreen); // Init Window with OpenGL and Maximized
+    if (this->window == NULL)
+        debug::error("GLDevice::open()", "failed to create window", SDL_GetError());
+
+    SDL_SetWindowMinimumSize(this->window, 720, 480);
+
+    SDL_ShowCursor((SDL_bool)!fullscreen);
+    SDL_SetRelativeMouseMode((SDL_bool)fullscreen);
+
+    // Request OpenGL 3.3 Core (or higher)
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    this->glcontext = SDL_GL_CreateContext(this->window);
+
+    if (!gladLoadGLLoader(SDL_GL_GetProcAddress) || this->glcontext == NULL)
+        debug::error("GLDevice::open()", "failed to init OpenGL");
+
+    // Enable VSync (for the editor)
+    SDL_GL_SetSwapInterval(vsync);
+    SDL_SetWindowIcon(this->window, IMG_Load("res/oof.jpg"));
+
+    SDL_GetWindowSize(this->window, &width, &height);
+}
+
+void GLDevice::present()
+{
+    SDL_GL_SwapWindow(this->window);
+}
+
+void GLDevice::size(int &width, int &height)
+{
+    SDL_GetWindowSize(this->window, &width, &height);
+}
+
+void GLDevice::close()
+{
+    SDL_GL_DeleteContext(this->glcontext);
+    SDL_DestroyWindow(this->window);
+    this->window = NULL;
+}
+
+void *GLDevice::proc(const char *name)
+{
+    return SDL_GL_GetProcAddress(name);
+}
+
+bool GLDevice::read(std::vector<unsigned char> &pixels)
+{
+    int w, h;
+    SDL_GL_GetDrawableSize(this->window, &w, &h);
+    pixels.resize((size_t)w * h * 4);
+
+    glstate::bind_framebuffer(0);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    return true;
+}
+
+void GLDevice::current(bool on)
+{
+    SDL_GL_MakeCurrent(this->window, on ? this->glcontext : NULL);
+}
+
+// Null
+
+/**
+ * @brief Null OpenGL (the functions only count their calls)
+ * @details Queries return values that let the engine run: objects get unique names, shaders compile,
+ * framebuffers are complete, fences are signaled, timer queries are ready & there are no extensions
+ */
+namespace nullgl
+{
+    uint calls[GL_FUNCTION_COUNT]; // calls of the current frame (per function)
+    uint last[GL_FUNCTION_COUNT];  // calls of the previous frame
+
+    uint names = 0;                               // the last generated object name
+    std::map<GLenum, std::vector<char>> mappings; // the memory of mapped buffers (per target)
+
+    /**
+     * @brief The default function (returns 0)
+     */
+    template <GL_FUNCTION id, typename F>
+    struct stub;
+
+    template <GL_FUNCTION id, typename R, typename... A>
+    struct stub<id, R(APIENTRYP)(A...)>
+    {
+        static R APIENTRY call(A...)
+        {
+            calls[id]++;
+            return R();
+        }
+    };
+
+    // Object names
+
+    void APIENTRY gen(GLsizei n, GLuint *out)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            out[i] = ++names;
+    }
+
+    void APIENTRY genbuffers(GLsizei n, GLuint *out)
+    {
+        calls[GLF_glGenBuffers]++;
+        gen(n, out);
+    }
+
+    void APIENTRY genframebuffers(GLsizei n, GLuint *out)
+    {
+        calls[GLF_glGenFramebuffers]++;
+        gen(n, out);
+    }
+
+    void APIENTRY genqueries(GLsizei n, GLuint *out)
+    {
+        calls[GLF_glGenQueries]++;
+        gen(n, out);
+    }
+
+    void APIENTRY gentextures(GLsizei n, GLuint *out)
+    {
+        calls[GLF_glGenTextures]++;
+        gen(n, out);
+    }
+
+    void APIENTRY genvertexarrays(GLsizei n, GLuint *out)
+    {
+        calls[GLF_glGenVertexArrays]++;
+        gen(n, out);
+    }
+
+    GLuint APIENTRY createshader(GLenum type)
+    {
+        calls[GLF_glCreateShader]++;
+        return ++names;
+    }
+
+    GLuint APIENTRY createprogram()
+    {
+        calls[GLF_glCreateProgram]++;
+        return ++names;
+    }
+
+    GLsync APIENTRY fencesync(GLenum condition, GLbitfield flags)
+    {
+        calls[GLF_glFenceSync]++;
+        return (GLsync)(uintptr_t)++names;
+    }
+
+    // Queries
+
+    void APIENTRY getshaderiv(GLuint shader, GLenum pname, GLint *params)
+    {
+        calls[GLF_glGetShaderiv]++;
+        *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+    }
+
+    void APIENTRY getprogramiv(GLuint program, GLenum pname, GLint *params)
+    {
+        calls[GLF_glGetProgramiv]++;
+        *params = pname == GL_LINK_STATUS ? GL_TRUE : 0;
+    }
+
+    void APIENTRY getqueryobjectiv(GLuint id, GLenum pname, GLint *params)
+    {
+        calls[GLF_glGetQueryObjectiv]++;
+        *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+    }
+
+    void APIENTRY getqueryobjectui64v(GLuint id, GLenum pname, GLuint64 *params)
+    {
+        calls[GLF_glGetQueryObjectui64v]++;
+        *params = 0; // no time passes
+    }
+
+    void APIENTRY getintegerv(GLenum pname, GLint *data)
+    {
+        calls[GLF_glGetIntegerv]++;
+        *data = 0; // no extensions, no binary formats
+    }
+
+    const GLubyte *APIENTRY getstring(GLenum name)
+    {
+        calls[GLF_glGetString]++;
+        switch (name)
+        {
+        case GL_VENDOR:
+            return (const GLubyte *)"none";
+        case GL_RENDERER:
+            return (const GLubyte *)"null device";
+        case GL_VERSION:
+            return (const GLubyte *)"3.3 null";
+        default:
+            return (const GLubyte *)"";
+        }
+    }
+
+    const GLubyte *APIENTRY getstringi(GLenum name, GLuint index)
+    {
+        calls[GLF_glGetStringi]++;
+        return (const GLubyte *)"";
+    }
+
+    GLenum APIENTRY checkframebufferstatus(GLenum target)
+    {
+        calls[GLF_glCheckFramebufferStatus]++;
+        return GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    GLenum APIENTRY clientwaitsync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+    {
+        calls[GLF_glClientWaitSync]++;
+        return GL_ALREADY_SIGNALED;
+    }
+
+    void *APIENTRY mapbufferrange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        calls[GLF_glMapBufferRange]++;
+
+        std::vector<char> &m = mappings[target];
+        if (m.size() < (size_t)(offset + length))
+            m.resize(offset + length);
+        return &m[offset];
+    }
+
+    /**
+     * @brief Fill glad's function table with the null functions
+     */
+    void load()
+    {
+#define __NULL_GL_LOAD(name) glad_##name = stub<GLF_##name, decltype(glad_##name)>::call;
+        GL_FUNCTIONS(__NULL_GL_LOAD)
+#undef __NULL_GL_LOAD
+
+        glad_glGenBuffers = genbuffers;
+        glad_glGenFramebuffers = genframebuffers;
+        glad_glGenQueries = genqueries;
+        glad_glGenTextures = gentextures;
+        glad_glGenVertexArrays = genvertexarrays;
+        glad_glCreateShader = createshader;
+        glad_glCreateProgram = createprogram;
+        glad_glFenceSync = fencesync;
+
+        glad_glGetShaderiv = getshaderiv;
+        glad_glGetProgramiv = getprogramiv;
+        glad_glGetQueryObjectiv = getqueryobjectiv;
+        glad_glGetQueryObjectui64v = getqueryobjectui64v;
+        glad_glGetIntegerv = getintegerv;
+        glad_glGetString = getstring;
+        glad_glGetStringi = getstringi;
+        glad_glCheckFramebufferStatus = checkframebufferstatus;
+        glad_glClientWaitSync = clientwaitsync;
+        glad_glMapBufferRange = mapbufferrange;
+    }
+
+    /**
+     * @brief Start a new frame (saves the counters to nullgl::last)
+     */
+    void frame()
+    {
+        for (int i = 0; i < GL_FUNCTION_COUNT; i++)
+        {
+            last[i] = calls[i];
+            calls[i] = 0;
+        }
+    }
+};
+
+/**
+ * @brief A device without OpenGL: every command is counted, but nothing is executed (for CPU-side profiling)
+ */
+class NullDevice : public Device
+{
+private:
+    int width = 0, height = 0;
+
+public:
+    NullDevice() : Device(DEVICE_NULL) {}
+
+    void open(std::string title, int &width, int &height, bool fullscreen, bool vsync);
+    void present();
+    void size(int &width, int &height);
+    void close() {}
+    void *proc(const char *name) { return NULL; }
+
+    uint calls(GL_FUNCTION f);
+    uint commands();
+};
+
+void NullDevice::open(std::string title, int &width, int &height, bool fullscreen, bool vsync)
+{
+    this->width = width;
+    this->height = height;
+
+    nullgl::load();
+}
+
+void NullDevice::present()
+{
+    nullgl::frame();
+}
+
+void NullDevice::size(int &width, int &height)
+{
+    width = this->width;
+    height = this->height;
+}
+
+/**
+ * @brief Get a function's calls in the last frame
+ *
+ * @param f The function (ex. GLF_glDrawElements)
+ * @return The number of calls
+ */
+uint NullDevice::calls(GL_FUNCTION f)
+{
+    return nullgl::last[f];
+}
+
+/**
+ * @brief Get the number of commands in the last frame
+ *
+ * @return The calls of every function
+ */
+uint NullDevice::commands()
+{
+    uint n = 0;
+    for (int i = 0; i < GL_FUNCTION_COUNT; i++)
+        n += nullgl::last[i];
+    return n;
+}
+
+// Headless (EGL)
+
+/**
+ * @brief OpenGL without a window: a surfaceless EGL context (EGL_MESA_platform_surfaceless) rendering into a framebuffer
+ * @details libEGL is loaded at runtime, so the engine doesn't depend on it. Works with Mesa's software renderer (llvmpipe),
+ * without a GPU or a display server
+ */
+class HeadlessDevice : public Device
+{
+private:
+    int width = 0, height = 0;
+    uint fbo = 0, color = 0, depth = 0;
+
+    void *egl = NULL; // libEGL
+#if defined(__linux__)
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+public:
+    HeadlessDevice() : Device(DEVICE_HEADLESS) {}
+
+    void open(std::string title, int &width, int &height, bool fullscreen, bool vsync);
+    void present();
+    void size(int &width, int &height);
+    void close();
+    void *proc(const char *name);
+    bool read(std::vector<unsigned char> &pixels);
+    void current(bool on);
+};
+
+#if defined(__linux__)
+// libEGL's eglGetProcAddress (loaded by HeadlessDevice::open())
+PFNEGLGETPROCADDRESSPROC __headless_getproc = NULL;
+
+void *__headless_proc(const char *name)
+{
+    return (void *)__headless_getproc(name);
+}
+#endif
+
+void HeadlessDevice::open(std::string title, int &width, int &height, bool fullscreen, bool vsync)
+{
+#if defined(__linux__)
+    this->width = width;
+    this->height = height;
+
+    // Load libEGL
+    this->egl = SDL_LoadObject("libEGL.so.1");
+    if (this->egl == NULL)
+        debug::error("HeadlessDevice::open()", "failed to load libEGL", SDL_GetError());
+
+    __headless_getproc = (PFNEGLGETPROCADDRESSPROC)SDL_LoadFunction(this->egl, "eglGetProcAddress");
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getdisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)__headless_getproc("eglGetPlatformDisplayEXT");
+    PFNEGLINITIALIZEPROC initialize = (PFNEGLINITIALIZEPROC)__headless_getproc("eglInitialize");
+    PFNEGLBINDAPIPROC bindapi = (PFNEGLBINDAPIPROC)__headless_getproc("eglBindAPI");
+    PFNEGLCREATECONTEXTPROC createcontext = (PFNEGLCREATECONTEXTPROC)__headless_getproc("eglCreateContext");
+    PFNEGLMAKECURRENTPROC makecurrent = (PFNEGLMAKECURRENTPROC)__headless_getproc("eglMakeCurrent");
+
+    if (getdisplay == NULL || initialize == NULL || bindapi == NULL || createcontext == NULL || makecurrent == NULL)
+        debug::error("HeadlessDevice::open()", "libEGL is incomplete", "EGL_EXT_platform_base is required");
+
+    // Surfaceless Display
+    this->display = getdisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (this->display == EGL_NO_DISPLAY || !initialize(this->display, NULL, NULL))
+        debug::error("HeadlessDevice::open()", "failed to init EGL", "EGL_MESA_platform_surfaceless is required");
+
+    // Request OpenGL 3.3 Core (or higher), without a config & a surface
+    EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                           EGL_CONTEXT_MINOR_VERSION, 3,
+                           EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                           EGL_NONE};
+
+    bindapi(EGL_OPENGL_API);
+    this->context = createcontext(this->display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (this->context == EGL_NO_CONTEXT || !makecurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context))
+        debug::error("HeadlessDevice::open()", "failed to create the context", "EGL_KHR_surfaceless_context is required");
+
+    if (!gladLoadGLLoader(__headless_proc))
+        debug::error("HeadlessDevice::open()", "failed to init OpenGL");
+
+    // The Surface (the engine's framebuffer 0, see glstate::screen)
+    glGenTextures(1, &this->color);
+    glBindTexture(GL_TEXTURE_2D, this->color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glGenTextures(1, &this->depth);
+    glBindTexture(GL_TEXTURE_2D, this->depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &this->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, this->color, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->depth, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        debug::error("HeadlessDevice::open()", "the framebuffer is incomplete");
+
+    glstate::screen = this->fbo;
+#else
+    debug::error("HeadlessDevice::open()", "headless rendering is only supported on linux");
+#endif
+}
+
+void HeadlessDevice::present()
+{
+    // Nothing to show, but the frame has to finish (so frames can be timed)
+    glFinish();
+}
+
+void HeadlessDevice::size(int &width, int &height)
+{
+    width = this->width;
+    height = this->height;
+}
+
+void HeadlessDevice::close()
+{
+#if defined(__linux__)
+    if (this->egl == NULL)
+        return;
+
+    PFNEGLMAKECURRENTPROC makecurrent = (PFNEGLMAKECURRENTPROC)__headless_getproc("eglMakeCurrent");
+    PFNEGLDESTROYCONTEXTPROC destroycontext = (PFNEGLDESTROYCONTEXTPROC)__headless_getproc("eglDestroyContext");
+    PFNEGLTERMINATEPROC terminate = (PFNEGLTERMINATEPROC)__headless_getproc("eglTerminate");
+
+    makecurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    destroycontext(this->display, this->context);
+    terminate(this->display);
+
+    glstate::screen = 0;
+    SDL_UnloadObject(this->egl);
+    this->egl = NULL;
+#endif
+}
+
+void *HeadlessDevice::proc(const char *name)
+{
+#if defined(__linux__)
+    return __headless_getproc != NULL ? __headless_proc(name) : NULL;
+#else
+    return NULL;
+#endif
+}
+
+void HeadlessDevice::current(bool on)
+{
+#if defined(__linux__)
+    if (this->egl == NULL)
+        return;
+
+    PFNEGLMAKECURRENTPROC makecurrent = (PFNEGLMAKECURRENTPROC)__headless_getproc("eglMakeCurrent");
+    makecurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, on ? this->context : EGL_NO_CONTEXT);
+#endif
+}
+
+bool HeadlessDevice::read(std::vector<unsigned char> &pixels)
+{
+    pixels.resize((size_t)this->width * this->height * 4);
+
+    glstate::bind_framebuffer(0);
+    glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    return true;
+}
+
+/**
+ * @brief Device creation & the current device
+ */
+namespace devices
+{
+    Device *current = NULL; // the engine's device
+
+    /**
+     * @brief Create a device
+     *
+     * @param type The device's type
+     * @return The device (not opened yet)
+     */
+    Device *create(DEVICE_TYPE type)
+    {
+        switch (type)
+        {
+        case DEVICE_NULL:
+            return new NullDevice();
+        case DEVICE_HEADLESS:
+            return new HeadlessDevice();
+        default:
+            return new GLDevice();
+        }
+    }
+
+    /**
+     * @brief Get an OpenGL function from the current device
+     *
+     * @param name The function's name
+     * @return The function (NULL if not found or there is no device)
+     */
+    void *proc(const char *name)
+    {
+        return current != NULL ? current->proc(name) : NULL;
+    }
+};
@@ -0,0 +1,440 @@
+// OpenGL State Cache for the Game Engine
+#pragma once
+
+#include <GL/glad.h>
+
+#include <tools/types.h>
+
+/**
+ * @brief The OpenGL state tracker
+ * @details Every state change of the engine goes through here, changes to the current state are skipped
+ * @warning Call glstate::invalidate() after changing the state with raw OpenGL calls
+ */
+namespace glstate
+{
+    /**
+     * @brief State change counters
+     */
+    struct counters
+    {
+        uint bound = 0;   // state changes requested
+        uint skipped = 0; // requests that were no-ops (not sent to OpenGL)
+        uint issued = 0;  // requests sent to OpenGL
+
+        uint draws = 0; // draw calls
+    };
+
+    counters stats; // The current frame's counters
+    counters last;  // The previous frame's counters
+
+    // The cached state (-1 / ~0 means unknown)
+    uint program = ~0u;
+    uint vertexarray = ~0u;
+    uint array_buffer = ~0u;
+    uint element_buffer = ~0u;
+    uint uniform_buffer = ~0u;
+    uint framebuffer = ~0u;
+
+    uint screen = 0; // the framebuffer behind framebuffer 0 (the window's, or the surface of a headless device)
+
+    uint active_unit = ~0u;
+    uint textures[16];
+    GLenum texture_targets[16];
+
+    // Capabilities: depth test, blend, cull face, scissor test
+    int caps[4] = {-1, -1, -1, -1};
+
+    int depth_mask = -1;
+    int color_mask = -1;
+    GLenum depth_func = 0;
+    GLenum blend_src = 0, blend_dst = 0;
+    int view[4] = {-1, -1, -1, -1};
+    int clip[4] = {-1, -1, -1, -1};
+
+    /**
+     * @brief Count a request
+     *
+     * @param changed is it a real state change?
+     * @return changed
+     */
+    bool count(bool changed)
+    {
+        stats.bound++;
+        if (changed)
+            stats.issued++;
+        else
+            stats.skipped++;
+        return changed;
+    }
+
+    /**
+     * @brief Forget the cached state (the next requests will be issued)
+     */
+    void invalidate()
+    {
+        program = vertexarray = array_buffer = element_buffer = uniform_buffer = framebuffer = ~0u;
+        active_unit = ~0u;
+        for (int i = 0; i < 16; i++)
+        {
+            textures[i] = ~0u;
+            texture_targets[i] = 0;
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            caps[i] = -1;
+            view[i] = -1;
+            clip[i] = -1;
+        }
+
+        depth_mask = -1;
+        color_mask = -1;
+        depth_func = 0;
+        blend_src = blend_dst = 0;
+    }
+
+    /**
+     * @brief Start a new frame (saves the counters to glstate::last)
+     */
+    void frame()
+    {
+        last = stats;
+        stats = counters();
+    }
+
+    /**
+     * @brief Select a shader program
+     *
+     * @param s The shader program
+     */
+    void use(uint s)
+    {
+        if (count(program != s))
+        {
+            glUseProgram(s);
+            program = s;
+        }
+    }
+
+    /**
+     * @brief Bind a vertex array
+     *
+     * @param vao The vertex array
+     */
+    void bind_vertexarray(uint vao)
+    {
+        if (count(vertexarray != vao))
+        {
+            glBindVertexArray(vao);
+            vertexarray = vao;
+
+            // The element buffer is part of the vertex array's state
+            element_buffer = ~0u;
+        }
+    }
+
+    /**
+     * @brief Bind a buffer
+     *
+     * @param target The target (ex. GL_ARRAY_BUFFER)
+     * @param buffer The buffer
+     */
+    void bind_buffer(GLenum target, uint buffer)
+    {
+        uint *cached = NULL;
+        if (target == GL_ARRAY_BUFFER)
+            cached = &array_buffer;
+        else if (target == GL_ELEMENT_ARRAY_BUFFER)
+            cached = &element_buffer;
+        else if (target == GL_UNIFORM_BUFFER)
+            cached = &uniform_buffer;
+
+        if (cached == NULL)
+        {
+            count(true);
+            glBindBuffer(target, buffer);
+        }
+        else if (count(*cached != buffer))
+        {
+            glBindBuffer(target, buffer);
+            *cached = buffer;
+        }
+    }
+
+    /**
+     * @brief Bind a buffer to an indexed binding point (also binds it to the generic target)
+     *
+     * @param target The target (ex. GL_UNIFORM_BUFFER)
+     * @param index The binding point
+     * @param buffer The buffer
+     */
+    void bind_buffer_base(GLenum target, uint index, uint buffer)
+    {
+        count(true);
+        glBindBufferBase(target, index, buffer);
+
+        if (target == GL_UNIFORM_BUFFER)
+            uniform_buffer = buffer;
+    }
+
+    /**
+     * @brief Forget a buffer (call before deleting it, OpenGL may reuse it's name)
+     *
+     * @param buffer The buffer
+     */
+    void forget(uint buffer)
+    {
+        if (array_buffer == buffer)
+            array_buffer = ~0u;
+        if (element_buffer == buffer)
+            element_buffer = ~0u;
+        if (uniform_buffer == buffer)
+            uniform_buffer = ~0u;
+    }
+
+    /**
+     * @brief Forget a texture (call before deleting it, OpenGL may reuse it's name)
+     *
+     * @param tex The texture
+     */
+    void forget_texture(uint tex)
+    {
+        for (int i = 0; i < 16; i++)
+            if (textures[i] == tex)
+                textures[i] = ~0u;
+    }
+
+    /**
+     * @brief Forget a shader program (call before deleting it, OpenGL may reuse it's name)
+     *
+     * @param s The shader program
+     */
+    void forget_program(uint s)
+    {
+        if (program == s)
+            program = ~0u;
+    }
+
+    /**
+     * @brief Forget a vertex array (call before deleting it, OpenGL may reuse it's name)
+     *
+     * @param vao The vertex array
+     */
+    void forget_vertexarray(uint vao)
+    {
+        // Deleting the bound vertex array binds 0 (& it's element buffer)
+        if (vertexarray == vao)
+            vertexarray = element_buffer = ~0u;
+    }
+
+    /**
+     * @brief Forget a framebuffer (call before deleting it, OpenGL may reuse it's name)
+     *
+     * @param fbo The framebuffer
+     */
+    void forget_framebuffer(uint fbo)
+    {
+        // Deleting the bound framebuffer binds OpenGL's 0 (not glstate::screen)
+        if (framebuffer == fbo)
+            framebuffer = ~0u;
+    }
+
+    /**
+     * @brief Bind a texture
+     *
+     * @param target The target (ex. GL_TEXTURE_2D)
+     * @param tex The texture
+     * @param unit The texture unit (0 - 15)
+     */
+    void bind_texture(GLenum target, uint tex, uint unit = 0)
+    {
+        unit &= 15;
+        if (count(textures[unit] != tex || texture_targets[unit] != target))
+        {
+            if (active_unit != unit)
+            {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                active_unit = unit;
+            }
+
+            glBindTexture(target, tex);
+            textures[unit] = tex;
+            texture_targets[unit] = target;
+        }
+    }
+
+    /**
+     * @brief Bind a framebuffer
+     *
+     * @param fbo The framebuffer (0 for the window, see glstate::screen)
+     */
+    void bind_framebuffer(uint fbo)
+    {
+        if (count(framebuffer != fbo))
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo != 0 ? fbo : screen);
+            framebuffer = fbo;
+        }
+    }
+
+    /**
+     * @brief Enable or disable a capability
+     *
+     * @param cap The capability (GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE or GL_SCISSOR_TEST)
+     * @param on enable?
+     */
+    void set(GLenum cap, bool on)
+    {
+        int i;
+        switch (cap)
+        {
+        case GL_DEPTH_TEST:
+            i = 0;
+            break;
+        case GL_BLEND:
+            i = 1;
+            break;
+        case GL_CULL_FACE:
+            i = 2;
+            break;
+        case GL_SCISSOR_TEST:
+            i = 3;
+            break;
+        default: // Not cached
+            count(true);
+            if (on)
+                glEnable(cap);
+            else
+                glDisable(cap);
+            return;
+        }
+
+        if (count(caps[i] != (int)on))
+        {
+            if (on)
+                glEnable(cap);
+            else
+                glDisable(cap);
+            caps[i] = on;
+        }
+    }
+
+    /**
+     * @brief Enable a capability
+     *
+     * @param cap The capability
+     */
+    void enable(GLenum cap)
+    {
+        set(cap, true);
+    }
+
+    /**
+     * @brief Disable a capability
+     *
+     * @param cap The capability
+     */
+    void disable(GLenum cap)
+    {
+        set(cap, false);
+    }
+
+    /**
+     * @brief Enable or disable depth writes
+     *
+     * @param on enable?
+     */
+    void depthmask(bool on)
+    {
+        if (count(depth_mask != (int)on))
+        {
+            glDepthMask(on ? GL_TRUE : GL_FALSE);
+            depth_mask = on;
+        }
+    }
+
+    /**
+     * @brief Enable or disable color writes (of every channel)
+     *
+     * @param on enable?
+     */
+    void colormask(bool on)
+    {
+        if (count(color_mask != (int)on))
+        {
+            GLboolean b = on ? GL_TRUE : GL_FALSE;
+            glColorMask(b, b, b, b);
+            color_mask = on;
+        }
+    }
+
+    /**
+     * @brief Set the depth test's function
+     *
+     * @param func The function (ex. GL_LESS)
+     */
+    void depthfunc(GLenum func)
+    {
+        if (count(depth_func != func))
+        {
+            glDepthFunc(func);
+            depth_func = func;
+        }
+    }
+
+    /**
+     * @brief Set the blending function
+     *
+     * @param src The source factor
+     * @param dst The destination factor
+     */
+    void blendfunc(GLenum src, GLenum dst)
+    {
+        if (count(blend_src != src || blend_dst != dst))
+        {
+            glBlendFunc(src, dst);
+            blend_src = src;
+            blend_dst = dst;
+        }
+    }
+
+    /**
+     * @brief Set the viewport
+     *
+     * @param x The left side
+     * @param y The bottom side
+     * @param w The width
+     * @param h The height
+     */
+    void viewport(int x, int y, int w, int h)
+    {
+        if (count(view[0] != x || view[1] != y || view[2] != w || view[3] != h))
+        {
+            glViewport(x, y, w, h);
+            view[0] = x;
+            view[1] = y;
+            view[2] = w;
+            view[3] = h;
+        }
+    }
+
+    /**
+     * @brief Set the scissor rectangle
+     *
+     * @param x The left side
+     * @param y The bottom side
+     * @param w The width
+     * @param h The height
+     */
+    void scissor(int x, int y, int w, int h)
+    {
+        if (count(clip[0] != x || clip[1] != y || clip[2] != w || clip[3] != h))
+        {
+            glScissor(x, y, w, h);
+            clip[0] = x;
+            clip[1] = y;
+            clip[2] = w;
+            clip[3] = h;
+        }
+    }
+};
@@ -12,6 +12,56 @@
 namespace loadin
 {
     bool enable_logs = true;
+
+    /**
+     * @brief Decode an image from a file (i.e.: .png or .jpg), ex. for heightmaps
+     *
+     * @param path The path of the image
+     * @return The pixels (empty if the image can't be loaded)
+     */
+    bitmap decode(std::string path)
+    {
+        bitmap out;
+
+        // Load the image into a surface
+        SDL_Surface *surface = IMG_Load(("res/" + path).c_str());
+        if (surface == NULL)
+        {
+            debug::warning("loadin::decode()", "can't load image", path.c_str());
+            return out;
+        }
+
+        // Other formats (ex. grayscale or paletted images) are converted to RGBA
+        if (surface->format->BytesPerPixel != 3 && surface->format->BytesPerPixel != 4)
+        {
+            SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(surface);
+
+            if (converted == NULL)
+            {
+                debug::warning("loadin::decode()", "can't convert image", path.c_str());
+                return out;
+            }
+            surface = converted;
+        }
+
+        out.width = surface->w;
+        out.height = surface->h;
+        out.channels = surface->format->BytesPerPixel;
+        out.pixels.resize((size_t)out.width * out.height * out.channels);
+
+        // Copy the rows flipped (the surface's rows may be padded)
+        size_t row = (size_t)out.width * out.channels;
+
+        SDL_LockSurface(surface);
+        for (int y = 0; y < out.height; y++)
+            memcpy(&out.pixels[y * row], (unsigned char *)surface->pixels + (size_t)(out.height - 1 - y) * surface->pitch, row);
+        SDL_UnlockSurface(surface);
+
+        SDL_FreeSurface(surface);
+        return out;
+    }
+
     /**
      * @brief Load an image from a file (i.e.: .png or .jpg)
      *
@@ -23,33 +73,27 @@ namespace loadin
     {
         texture out;
 
-        // Load the image into a surface
-        SDL_Surface *surface = IMG_Load(("res/" + path).c_str());
-        if (surface != NULL)
+        bitmap img = decode(path);
+        if (!img.pixels.empty())
         {
-            // Flip the surface & generate textures
-            flip_surface(surface);
+            // Generate textures
             glGenTextures(1, &out);
-            glBindTexture(GL_TEXTURE_2D, out);
+            glstate::bind_texture(GL_TEXTURE_2D, out);
 
             // Decide, whether it has an alpha channel or not
             int Mode = GL_RGB;
-            if (surface->format->BytesPerPixel == 4)
+            if (img.channels == 4)
                 Mode = GL_RGBA;
 
-            // Load texture into OpenGL
-            glTexImage2D(GL_TEXTURE_2D, 0, Mode, surface->w, surface->h, 0, Mode, GL_UNSIGNED_BYTE, surface->pixels);
+            // Load texture into OpenGL (the rows are tightly packed)
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, Mode, img.width, img.height, 0, Mode, GL_UNSIGNED_BYTE, &img.pixels[0]);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
 
-            // Free surface
-            SDL_FreeSurface(surface);
-
             if (enable_logs)
                 debug::log("loadin::image()", "loaded texture");
         }
-        else
-            debug::warning("loadin::image()", "can't load image", path.c_str());
 
         return out;
     }
@@ -90,7 +134,7 @@ namespace loadin
                 // generate texture
                 unsigned int texture;
                 glGenTextures(1, &texture);
-                glBindTexture(GL_TEXTURE_2D, texture);
+                glstate::bind_texture(GL_TEXTURE_2D, texture);
                 glTexImage2D(
                     GL_TEXTURE_2D,
                     0,
@@ -159,6 +203,39 @@ namespace loadin
         return out;
     }
 
+    /**
+     * @brief Calculate a mesh's local bounds (axis-aligned box & sphere)
+     *
+     * @param m The mesh
+     */
+    void bounds(mesh &m)
+    {
+        m.min = {0.0f, 0.0f, 0.0f};
+        m.max = {0.0f, 0.0f, 0.0f};
+
+        for (int i = 0; i < (int)m.vertices.size() / 3; i++)
+        {
+            vec3 v = {m.vertices[i * 3], m.vertices[i * 3 + 1], m.vertices[i * 3 + 2]};
+            if (i == 0)
+            {
+                m.min = v;
+                m.max = v;
+            }
+
+            m.min = {fminf(m.min.x, v.x), fminf(m.min.y, v.y), fminf(m.min.z, v.z)};
+            m.max = {fmaxf(m.max.x, v.x), fmaxf(m.max.y, v.y), fmaxf(m.max.z, v.z)};
+        }
+
+        // The sphere around the box's center
+        m.center = vector::avg(m.min, m.max);
+        m.radius = 0.0f;
+        for (int i = 0; i < (int)m.vertices.size() / 3; i++)
+        {
+            vec3 v = {m.vertices[i * 3], m.vertices[i * 3 + 1], m.vertices[i * 3 + 2]};
+            m.radius = fmaxf(m.radius, vector::distance(v, m.center));
+        }
+    }
+
     /**
      * @brief Load a Wavefront .OBJ file
      * @details See wikipedia for reference:
@@ -300,6 +377,10 @@ namespace loadin
                     // Line Element
                     // TODO
                 }
+                else if (index == "j" || index == "vw")
+                {
+                    // Joints & Vertex Weights (see loadin::rig())
+                }
                 else if (index == "mtllib")
                 {
                     // Load a material template library
@@ -327,6 +408,7 @@ namespace loadin
             }
 
             f.close();
+            bounds(out);
 
             if (enable_logs)
                 debug::log("loadin::obj()", "loaded mesh");
@@ -336,4 +418,182 @@ namespace loadin
 
         return out;
     }
+
+    /**
+     * @brief Load the skeleton of a skinned .OBJ file
+     * @details Joints: "j name parent x y z qx qy qz qw" (the rest pose, relative to the parent, parents first),
+     * Vertex Weights: "vw joint weight [joint weight ...]" (max. 4, the n-th "vw" belongs to the n-th "v")
+     *
+     * @param path The path of the file
+     * @return The skeleton (with the influences of the mesh's vertices in the order of loadin::obj())
+     */
+    skeleton rig(std::string path)
+    {
+        skeleton out;
+
+        std::ifstream f("res/" + path);
+        if (f.is_open())
+        {
+            std::vector<unsigned char> influences; // per "v"
+            std::vector<float> weights;
+            uint vertices = 0;
+
+            std::string line;
+            while (getline(f, line))
+            {
+                std::string index = despace(split(line, " ", 0));
+
+                if (index == "v")
+                {
+                    vertices++;
+                    influences.resize(vertices * 4, 0);
+                    weights.resize(vertices * 4, 0.0f);
+                }
+                else if (index == "j")
+                {
+                    if (count(line, ' ') != 9)
+                    {
+                        debug::warning("loadin::rig()", "argument mismatch", "joint");
+                        continue;
+                    }
+
+                    joint j;
+                    j.name = split(line, " ", 1);
+                    j.parent = isplit(line, " ", 2);
+                    j.position = {fsplit(line, " ", 3), fsplit(line, " ", 4), fsplit(line, " ", 5)};
+                    j.rotation = {fsplit(line, " ", 6), fsplit(line, " ", 7), fsplit(line, " ", 8), fsplit(line, " ", 9)};
+
+                    if (j.parent >= (int)out.joints.size() || out.joints.size() >= 256)
+                    {
+                        debug::warning("loadin::rig()", "invalid joint", j.name.c_str());
+                        continue;
+                    }
+                    out.joints.push_back(j);
+                }
+                else if (index == "vw")
+                {
+                    if (vertices == 0)
+                        continue;
+
+                    // The weights of the last vertex (normalized)
+                    int n = std::min(count(line, ' ') / 2, 4);
+                    float sum = 0.0f;
+                    for (int i = 0; i < n; i++)
+                    {
+                        influences[(vertices - 1) * 4 + i] = isplit(line, " ", 1 + i * 2);
+                        weights[(vertices - 1) * 4 + i] = fsplit(line, " ", 2 + i * 2);
+                        sum += weights[(vertices - 1) * 4 + i];
+                    }
+
+                    for (int i = 0; i < n && sum > 0.0f; i++)
+                        weights[(vertices - 1) * 4 + i] /= sum;
+                }
+                else if (index == "f" && count(line, '/') % 3 == 0)
+                {
+                    // Every corner of the face is a vertex of the mesh
+                    for (int i = 0; i < 3; i++)
+                    {
+                        int v = isplit(split(line, " ", 1 + i), "/", 0) - 1;
+                        if (v < 0 || v >= (int)vertices)
+                            v = 0;
+
+                        for (int k = 0; k < 4; k++)
+                        {
+                            out.influences.push_back(vertices > 0 ? influences[v * 4 + k] : 0);
+                            out.weights.push_back(vertices > 0 ? weights[v * 4 + k] : (k == 0 ? 1.0f : 0.0f));
+                        }
+                    }
+                }
+            }
+
+            f.close();
+
+            // The inverse of the rest pose (the joints have no scale)
+            std::vector<mat4> models(out.joints.size());
+            for (size_t i = 0; i < out.joints.size(); i++)
+            {
+                joint &j = out.joints[i];
+                models[i] = matrix::rotate(j.rotation) * matrix::translate(j.position);
+                if (j.parent >= 0)
+                    models[i] = models[i] * models[j.parent];
+
+                j.inverse_bind = matrix::inverse(models[i]);
+            }
+
+            for (auto i : out.influences)
+                if (i >= out.joints.size())
+                    debug::warning("loadin::rig()", "vertex weight of a missing joint", path.c_str());
+
+            if (enable_logs)
+                debug::log("loadin::rig()", "loaded skeleton");
+        }
+        else
+            debug::warning("loadin::rig()", "can't open file", path.c_str());
+
+        return out;
+    }
+
+    /**
+     * @brief Load an animation (.ANIM file)
+     * @details Animation: "a name duration" (in seconds), Keys: "k joint time x y z qx qy qz qw [sx sy sz]" (the joint's
+     * pose at the time, relative to it's parent)
+     *
+     * @param path The path of the file
+     * @return The keys (see animation::compress())
+     */
+    keyframes anim(std::string path)
+    {
+        keyframes out;
+
+        std::ifstream f("res/" + path);
+        if (f.is_open())
+        {
+            std::string line;
+            while (getline(f, line))
+            {
+                std::string index = despace(split(line, " ", 0));
+
+                if (line[0] == '#' || index == "" || index == " " || index == "\n")
+                {
+                    // Line is a comment
+                }
+                else if (index == "a")
+                {
+                    out.name = split(line, " ", 1);
+                    out.duration = fsplit(line, " ", 2);
+                }
+                else if (index == "k")
+                {
+                    int n = count(line, ' ');
+                    int j = isplit(line, " ", 1);
+                    if ((n != 9 && n != 12) || j < 0 || j >= 256)
+                    {
+                        debug::warning("loadin::anim()", "argument mismatch", "key");
+                        continue;
+                    }
+
+                    if (j >= (int)out.keys.size())
+                        out.keys.resize(j + 1);
+
+                    for (int i = 2; i <= 9; i++)
+                        out.keys[j].push_back(fsplit(line, " ", i));
+                    for (int i = 10; i <= 12; i++)
+                        out.keys[j].push_back(n == 12 ? fsplit(line, " ", i) : 1.0f);
+                }
+                else
+                {
+                    debug::warning("loadin::anim()", "unrecognized element(s)", index.c_str());
+                }
+            }
+
+            f.close();
+
+            if (enable_logs)
+                debug::log("loadin::anim()", "loaded animation");
+        }
+        else
+            debug::warning("loadin::anim()", "can't open file", path.c_str());
+
+        return out;
+    }
 }
\ No newline at end of file
@@ -9,102 +9,328 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <filesystem>
 
 #include <tools/debug.h>
+#include <tools/glstate.h>
+#include <tools/device.h>
 
 /**
  * @brief OpenGL shader
  */
 typedef uint gls;
 
+/**
+ * @brief Every compiled permutation of a shader's feature keywords
+ */
+struct permutations
+{
+    std::vector<std::string> keywords; // keyword i is bit (1 << i) of the mask
+    std::vector<gls> programs;         // indexed by the feature mask
+};
+
+/**
+ * @brief A shader program that is being compiled & linked by the driver
+ */
+struct __shader_build_t
+{
+    gls s = 0;
+    gls vs = 0, fs = 0, gs = 0;
+
+    std::string key;     // program binary cache key ("" if not cached)
+    bool cached = false; // loaded from the program binary cache ?
+};
+
 namespace shader
 {
+    /**
+     * @brief Program binary cache (skips compiling & linking on later launches)
+     */
+    namespace cache
+    {
+        // The local cache-folder's path
+        std::string folder = "cache/shaders/";
+
+        bool enabled = true; // use the program binary cache ?
+
+        /**
+         * @brief Check if the driver can save & load program binaries (queried once)
+         *
+         * @return is it supported?
+         */
+        bool supported()
+        {
+            static bool queried = false;
+            static bool formats = false;
+
+            if (!enabled)
+                return false;
+
+            if (!queried)
+            {
+                // Earlier errors would look like the probe's, they're reported & cleared first
+                for (GLenum e = glGetError(); e != GL_NO_ERROR; e = glGetError())
+                    debug::warning("shader::cache::supported()", "pending OpenGL error", std::to_string(e).c_str());
+
+                int n = 0;
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n);
+                formats = glGetError() != GL_INVALID_ENUM && n > 0; // drivers without ARB_get_program_binary
+                queried = true;
+            }
+
+            return formats;
+        }
+
+        /**
+         * @brief Generate a program's cache key from it's sources & the driver
+         * @details The driver's vendor, renderer & version are part of the key, so driver updates invalidate the cache
+         *
+         * @param vShaderCode The Vertex Shader's code
+         * @param fShaderCode The Fragment Shader's code
+         * @param gShaderCode The Geometry Shader's code (NULL if not used)
+         * @return The key
+         */
+        std::string key(const char *vShaderCode, const char *fShaderCode, const char *gShaderCode = NULL)
+        {
+            uint64_t h = hash(std::string((const char *)glGetString(GL_VENDOR)));
+            h = hash(std::string((const char *)glGetString(GL_RENDERER)), h);
+            h = hash(std::string((const char *)glGetString(GL_VERSION)), h);
+
+            h = hash(std::string(vShaderCode), h);
+            h = hash(std::string("\n#vs#\n"), h); // so moving code between stages changes the key
+            h = hash(std::string(fShaderCode), h);
+            h = hash(std::string("\n#fs#\n"), h);
+            if (gShaderCode != NULL)
+                h = hash(std::string(gShaderCode), h);
+
+            return htos(h);
+        }
+
+        /**
+         * @brief Try to load a program from the cache
+         *
+         * @param s The (empty) shader program
+         * @param key The program's cache key
+         * @return was the binary loaded & accepted by the driver?
+         */
+        bool load(gls s, std::string key)
+        {
+            std::ifstream f(folder + key + ".bin", std::ios::binary);
+            if (!f.is_open())
+                return false;
+
+            char magic[4];
+            uint32_t format, length;
+
+            f.read(magic, 4);
+            f.read((char *)&format, sizeof(format));
+            f.read((char *)&length, sizeof(length));
+
+            if (!f || std::string(magic, 4) != "GLPB" || length == 0)
+                return false;
+
+            std::vector<char> binary(length);
+            f.read(&binary[0], length);
+            if (!f)
+                return false;
+
+            glProgramBinary(s, format, &binary[0], length);
+
+            // The driver may reject the binary (ex. after an update), then we have to compile
+            int success;
+            glGetProgramiv(s, GL_LINK_STATUS, &success);
+            if (!success)
+                debug::log("shader::cache::load()", "binary rejected by the driver", key.c_str());
+
+            return success;
+        }
+
+        /**
+         * @brief Save a linked program to the cache
+         *
+         * @param s The linked shader program
+         * @param key The program's cache key
+         */
+        void save(gls s, std::string key)
+        {
+            int length = 0;
+            glGetProgramiv(s, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0)
+                return;
+
+            std::vector<char> binary(length);
+            GLenum format;
+            glGetProgramBinary(s, length, NULL, &format, &binary[0]);
+
+            std::error_code ec;
+            std::filesystem::create_directories(folder, ec);
+
+            std::ofstream f(folder + key + ".bin", std::ios::binary);
+            if (!f.is_open())
+            {
+                debug::warning("shader::cache::save()", "can't open cache file", (folder + key + ".bin").c_str());
+                return;
+            }
+
+            uint32_t format32 = format, length32 = length;
+
+            f.write("GLPB", 4);
+            f.write((const char *)&format32, sizeof(format32));
+            f.write((const char *)&length32, sizeof(length32));
+            f.write(&binary[0], length);
+        }
+    };
 
     /**
-     * @brief Load shader from variable(s)
+     * @brief Start building a shader program from variable(s)
+     * @details Compiling & linking is only submitted to the driver here, the results are checked in shader::end(),
+     * so drivers with KHR_parallel_shader_compile can build many programs at the same time
      *
      * @param vShaderCode The Vertex Shader's variable
      * @param fShaderCode The Fragment Shader's variable
      * @param gShaderCode The Geometry Shader's variable (NULL if not used)
-     * @return The shader program's id
+     * @return The unfinished build
      */
-    gls load_raw(const char *vShaderCode, const char *fShaderCode, const char *gShaderCode = NULL)
+    __shader_build_t begin(const char *vShaderCode, const char *fShaderCode, const char *gShaderCode = NULL)
     {
-        // Define Variables
-        bool gshader = gShaderCode != NULL;
+        __shader_build_t b;
 
-        gls s;
-        gls vs, fs, gs;
+        // Try the Program Binary Cache
+        if (cache::supported())
+        {
+            b.key = cache::key(vShaderCode, fShaderCode, gShaderCode);
 
-        int success;
-        char infoLog[1024];
+            b.s = glCreateProgram();
+            if (cache::load(b.s, b.key))
+            {
+                b.cached = true;
+                return b;
+            }
+            glstate::forget_program(b.s);
+            glDeleteProgram(b.s);
+        }
 
         // Compile Vertex Shader
-        vs = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vs, 1, &vShaderCode, NULL);
-        glCompileShader(vs);
+        b.vs = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(b.vs, 1, &vShaderCode, NULL);
+        glCompileShader(b.vs);
+
+        // Compile Fragment Shader
+        b.fs = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(b.fs, 1, &fShaderCode, NULL);
+        glCompileShader(b.fs);
+
+        // Compile Geometry Shader
+        if (gShaderCode != NULL)
+        {
+            b.gs = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(b.gs, 1, &gShaderCode, NULL);
+            glCompileShader(b.gs);
+        }
+
+        // Create Shader Program
+        b.s = glCreateProgram();
+        glAttachShader(b.s, b.vs);
+        glAttachShader(b.s, b.fs);
+        if (b.gs != 0)
+            glAttachShader(b.s, b.gs);
+
+        if (b.key != "")
+            glProgramParameteri(b.s, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        glLinkProgram(b.s);
+
+        return b;
+    }
+
+    /**
+     * @brief Finish building a shader program (waits for the driver)
+     *
+     * @param b The build started by shader::begin()
+     * @return The shader program's id
+     */
+    gls end(__shader_build_t b)
+    {
+        if (b.cached)
+            return b.s;
+
+        int success;
+        char infoLog[1024];
 
         // Check if compilation was successfull
-        glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
+        glGetShaderiv(b.vs, GL_COMPILE_STATUS, &success);
         if (!success)
         {
-            glGetShaderInfoLog(vs, 1024, NULL, infoLog);
+            glGetShaderInfoLog(b.vs, 1024, NULL, infoLog);
             debug::error("shader::load_raw()", "can't compile vertex code", infoLog);
         }
 
-        // Compile Fragment Shader
-        fs = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fs, 1, &fShaderCode, NULL);
-        glCompileShader(fs);
-
-        // Check if compilation was successful
-        glGetShaderiv(fs, GL_COMPILE_STATUS, &success);
+        glGetShaderiv(b.fs, GL_COMPILE_STATUS, &success);
         if (!success)
         {
-            glGetShaderInfoLog(fs, 1024, NULL, infoLog);
+            glGetShaderInfoLog(b.fs, 1024, NULL, infoLog);
             debug::error("shader::load_raw()", "can't compile fragment code", infoLog);
         }
 
-        // Compile Geometry Shader
-        if (gshader)
+        if (b.gs != 0)
         {
-            gs = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(gs, 1, &gShaderCode, NULL);
-            glCompileShader(gs);
-
-            // Check if compilation was successful
-            glGetShaderiv(gs, GL_COMPILE_STATUS, &success);
+            glGetShaderiv(b.gs, GL_COMPILE_STATUS, &success);
             if (!success)
             {
-                glGetShaderInfoLog(gs, 1024, NULL, infoLog);
+                glGetShaderInfoLog(b.gs, 1024, NULL, infoLog);
                 debug::error("shader::load_raw()", "can't compile geometry code", infoLog);
             }
         }
 
-        // Create Shader Program
-        s = glCreateProgram();
-        glAttachShader(s, vs);
-        glAttachShader(s, fs);
-        if (gshader)
-            glAttachShader(s, gs);
-
-        glLinkProgram(s);
-
-        // Check if compilation was successful
-        glGetProgramiv(s, GL_LINK_STATUS, &success);
+        // Check if linking was successful
+        glGetProgramiv(b.s, GL_LINK_STATUS, &success);
         if (!success)
         {
-            glGetProgramInfoLog(s, 1024, NULL, infoLog);
+            glGetProgramInfoLog(b.s, 1024, NULL, infoLog);
             debug::error("shader::load_raw()", "can't link", infoLog);
         }
 
+        // Save to the Program Binary Cache
+        if (b.key != "")
+            cache::save(b.s, b.key);
+
         // Delete unnecessary shaders
-        glDeleteShader(vs);
-        glDeleteShader(fs);
-        if (gshader)
-            glDeleteShader(gs);
+        glDeleteShader(b.vs);
+        glDeleteShader(b.fs);
+        if (b.gs != 0)
+            glDeleteShader(b.gs);
+
+        return b.s;
+    }
+
+    /**
+     * @brief Load shader from variable(s)
+     *
+     * @param vShaderCode The Vertex Shader's variable
+     * @param fShaderCode The Fragment Shader's variable
+     * @param gShaderCode The Geometry Shader's variable (NULL if not used)
+     * @return The shader program's id
+     */
+    gls load_raw(const char *vShaderCode, const char *fShaderCode, const char *gShaderCode = NULL)
+    {
+        return end(begin(vShaderCode, fShaderCode, gShaderCode));
+    }
+
+    /**
+     * @brief Read a shader file
+     *
+     * @param path The file's path (inside res/shaders/)
+     * @return The code ("" if the file can't be opened)
+     */
+    std::string read(std::string path)
+    {
+        std::ifstream f("res/shaders/" + path);
+        if (!f.is_open())
+            return "";
 
-        return s;
+        std::stringstream stream;
+        stream << f.rdbuf();
+        return stream.str();
     }
 
     /**
@@ -117,58 +343,166 @@ namespace shader
      */
     gls load(std::string vertexPath, std::string fragmentPath, std::string geometryPath = "")
     {
-        // Define variables
-        bool gshader = geometryPath != "";
+        std::string vertexCode = read(vertexPath);
+        std::string fragmentCode = read(fragmentPath);
+        std::string geometryCode = geometryPath != "" ? read(geometryPath) : "";
 
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
+        if (vertexCode == "" || fragmentCode == "")
+            debug::error("shader::load", "can't open file(s)", (vertexPath + "; " + fragmentPath).c_str());
 
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
+        return load_raw(vertexCode.c_str(), fragmentCode.c_str(), (geometryCode != "" ? geometryCode.c_str() : NULL));
+    }
 
-        // Open Files
-        vShaderFile.open("res/shaders/" + vertexPath);
-        fShaderFile.open("res/shaders/" + fragmentPath);
-        if (gshader)
-            gShaderFile.open("res/shaders/" + geometryPath);
+    /**
+     * @brief Load a shader from one path + name (ex. "light" -> loads light.vs, light.fs (maybe light.gs))
+     *
+     * @param path The shaders' path
+     * @return The shader program's id
+     */
+    gls load(std::string path)
+    {
+        return load(path + ".vs", path + ".fs", path + ".gs");
+    }
 
-        if (!vShaderFile.is_open() || !vShaderFile.is_open())
-            debug::error("shader::load", "can't open file(s)", (vertexPath + "; " + fragmentPath).c_str());
-        if (gshader && !gShaderFile.is_open())
-            gshader = false;
+    // Permutations
 
-        // Read Lines
-        std::stringstream vShaderStream, fShaderStream, gShaderStream;
+    /**
+     * @brief Add #define-s to a shader's code (right after the #version line)
+     * @details A define with a value (ex. "MAX_LIGHTS 16") replaces the code's own define with the same name
+     *
+     * @param code The shader's code
+     * @param defines The defines (ex. {"SHADOWS", "MAX_LIGHTS 16"})
+     * @return The new code
+     */
+    std::string define(std::string code, std::vector<std::string> defines)
+    {
+        if (defines.empty())
+            return code;
 
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        if (gshader)
-            gShaderStream << gShaderFile.rdbuf();
+        std::string head, body;
+        std::stringstream in(code);
 
-        vShaderFile.close();
-        fShaderFile.close();
-        if (gshader)
-            gShaderFile.close();
+        std::string line;
+        bool version = false;
+        while (getline(in, line))
+        {
+            if (!version && isin(line, "#version"))
+            {
+                head += line + "\n";
+                version = true;
+                continue;
+            }
+
+            // Drop the code's own define, if we override it
+            bool replaced = false;
+            for (auto &d : defines)
+                if (isin(line, "#define " + split(d, " ", 0) + " "))
+                    replaced = true;
+
+            if (!replaced)
+                body += line + "\n";
+        }
 
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        if (gshader)
-            geometryCode = gShaderStream.str();
+        for (auto &d : defines)
+            head += "#define " + d + "\n";
 
-        return load_raw(vertexCode.c_str(), fragmentCode.c_str(), (gshader ? geometryCode.c_str() : NULL));
+        // The line numbers in the driver's error messages should still match the file
+        if (version)
+            head += "#line 2\n";
+        else
+            head += "#line 1\n";
+
+        return head + body;
     }
 
     /**
-     * @brief Load a shader from one path + name (ex. "light" -> loads light.vs, light.fs (maybe light.gs))
+     * @brief Get the bit of a feature keyword in a permutation mask
      *
-     * @param path The shaders' path
+     * @param p The permutations
+     * @param keyword The feature keyword
+     * @return The bit (0 if the shader doesn't have this keyword)
+     */
+    uint bit(const permutations &p, std::string keyword)
+    {
+        for (int i = 0; i < (int)p.keywords.size(); i++)
+            if (p.keywords[i] == keyword)
+                return 1u << i;
+        return 0;
+    }
+
+    /**
+     * @brief Select the program compiled for a set of features
+     *
+     * @param p The permutations
+     * @param mask The features' bitmask (see shader::bit())
      * @return The shader program's id
      */
-    gls load(std::string path)
+    gls select(const permutations &p, uint mask)
     {
-        return load(path + ".vs", path + ".fs", path + ".gs");
+        return p.programs[mask & (p.programs.size() - 1)];
+    }
+
+    /**
+     * @brief Compile every permutation of a shader's feature keywords (ex. "3d" with {"TEXTURED", "COLORED"} -> 4 programs)
+     * @details All programs are submitted first and checked afterwards, so they are built in parallel where the driver can
+     *
+     * @param path The shaders' path
+     * @param keywords The feature keywords (turned into #define-s), max. 8
+     * @param defines Defines used by every permutation (ex. {"MAX_LIGHTS 16"})
+     * @return The permutations
+     */
+    permutations permute(std::string path, std::vector<std::string> keywords, std::vector<std::string> defines = {})
+    {
+        permutations out;
+
+        if (keywords.size() > 8)
+        {
+            debug::warning("shader::permute()", "too many feature keywords", path.c_str());
+            keywords.resize(8);
+        }
+        out.keywords = keywords;
+
+        std::string vertexCode = read(path + ".vs");
+        std::string fragmentCode = read(path + ".fs");
+        std::string geometryCode = read(path + ".gs");
+
+        if (vertexCode == "" || fragmentCode == "")
+            debug::error("shader::permute()", "can't open file(s)", (path + ".vs; " + path + ".fs").c_str());
+
+        // Let the driver use as many compiler threads as it wants
+        typedef void (*maxthreads_t)(GLuint);
+        if (debug::glextension("GL_KHR_parallel_shader_compile") || debug::glextension("GL_ARB_parallel_shader_compile"))
+        {
+            maxthreads_t maxthreads = (maxthreads_t)devices::proc("glMaxShaderCompilerThreadsKHR");
+            if (maxthreads == NULL)
+                maxthreads = (maxthreads_t)devices::proc("glMaxShaderCompilerThreadsARB");
+            if (maxthreads != NULL)
+                maxthreads(0xFFFFFFFF);
+        }
+
+        // Submit every permutation
+        uint n = 1u << keywords.size();
+        std::vector<__shader_build_t> builds;
+
+        for (uint mask = 0; mask < n; mask++)
+        {
+            std::vector<std::string> d = defines;
+            for (int i = 0; i < (int)keywords.size(); i++)
+                if (mask & (1u << i))
+                    d.push_back(keywords[i]);
+
+            std::string v = define(vertexCode, d);
+            std::string f = define(fragmentCode, d);
+            std::string g = define(geometryCode, d);
+
+            builds.push_back(begin(v.c_str(), f.c_str(), (geometryCode != "" ? g.c_str() : NULL)));
+        }
+
+        // Collect the results
+        for (auto &b : builds)
+            out.programs.push_back(end(b));
+
+        return out;
     }
 
     /**
@@ -178,7 +512,7 @@ namespace shader
      */
     void use(gls s)
     {
-        glUseProgram(s);
+        glstate::use(s);
     }
 
     /**
@@ -0,0 +1,804 @@
+// OpenGL Command Traces for the Game Engine
+#pragma once
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <GL/glad.h>
+
+#include <tools/debug.h>
+#include <tools/glstate.h>
+#include <tools/device.h>
+
+// The trace's format: a header, then the commands ({uint16 function, uint32 size, arguments, payload, return value})
+#define TRACE_MAGIC 0x52544C47 // "GLTR"
+#define TRACE_VERSION 4
+#define TRACE_FRAME 0xFFFF // the command that ends a frame (the first one ends the setup)
+
+/**
+ * @brief The trace file's header
+ */
+struct __trace_header_t
+{
+    uint magic = TRACE_MAGIC;
+    uint version = TRACE_VERSION;
+
+    uint frames = 0;            // recorded frames (after the setup)
+    uint width = 0, height = 0; // the surface's size
+    uint screen = 0;            // the recording's framebuffer 0 (see glstate::screen)
+};
+
+/**
+ * @brief The call categories (for the replay's timings)
+ */
+typedef enum
+{
+    TRACE_DRAW = 0,     // draws & clears
+    TRACE_UPLOAD = 1,   // buffer & texture data
+    TRACE_STATE = 2,    // binds, capabilities & fixed function state
+    TRACE_UNIFORM = 3,  // uniforms
+    TRACE_SHADER = 4,   // shader compiling & linking
+    TRACE_SYNC = 5,     // fences
+    TRACE_RESOURCE = 6, // object creation & deletion
+    TRACE_CATEGORY_COUNT
+} TRACE_CATEGORY;
+
+const char *trace_category_names[TRACE_CATEGORY_COUNT] = {"draw", "upload", "state", "uniform", "shader", "sync", "resource"};
+
+/**
+ * @brief The names of the objects of a trace (recorded name -> replayed name)
+ */
+struct __trace_names_t
+{
+    std::unordered_map<uint, uint> buffers, textures, vertexarrays, framebuffers;
+    std::unordered_map<uint, uint> programs; // programs & shaders (they share their names)
+    std::unordered_map<uint64_t, GLsync> syncs;
+
+    // Per program (program << 32 | recorded value)
+    std::unordered_map<uint64_t, int> locations;
+    std::unordered_map<uint64_t, uint> blocks;
+
+    uint program = 0; // the recorded program in use
+    uint queried = 0; // the recorded program of the last location query
+
+    // Temporary arrays of the current command
+    std::vector<GLuint> scratch;
+    std::vector<const GLchar *> strings;
+    std::vector<GLint> lengths;
+};
+
+/**
+ * @brief The command trace recorder & player
+ * @details Recording wraps glad's function table (the functions of GL_FUNCTIONS), so every command of the engine
+ * is written to the trace with it's arguments and the data it reads (buffer, texture & shader data).
+ * A recording starts with the device (so the trace creates every object it uses) and ends after it's frames
+ */
+namespace trace
+{
+    std::string path;
+    uint frames = 0; // frames to record
+
+    bool armed = false;     // trace::start() was called
+    bool recording = false; // the functions are wrapped
+
+    __trace_header_t header;
+    std::vector<unsigned char> data;
+
+    void *original[GL_FUNCTION_COUNT]; // glad's functions before recording
+    int unpack_alignment = 4;          // GL_UNPACK_ALIGNMENT (texture rows are padded to it)
+
+    /**
+     * @brief Get a function's category
+     *
+     * @param f The function
+     * @return The category
+     */
+    TRACE_CATEGORY category(GL_FUNCTION f)
+    {
+        switch (f)
+        {
+        case GLF_glBlitFramebuffer:
+        case GLF_glClear:
+        case GLF_glDrawElements:
+        case GLF_glDrawElementsBaseVertex:
+        case GLF_glDrawElementsInstancedBaseVertex:
+        case GLF_glMultiDrawElementsIndirect:
+            return TRACE_DRAW;
+
+        case GLF_glBufferData:
+        case GLF_glBufferStorage:
+        case GLF_glBufferSubData:
+        case GLF_glCopyBufferSubData:
+        case GLF_glTexImage2D:
+        case GLF_glTexImage3D:
+            return TRACE_UPLOAD;
+
+        case GLF_glGetUniformBlockIndex:
+        case GLF_glGetUniformLocation:
+        case GLF_glUniform1f:
+        case GLF_glUniform1i:
+        case GLF_glUniform1iv:
+        case GLF_glUniform2f:
+        case GLF_glUniform3f:
+        case GLF_glUniformBlockBinding:
+        case GLF_glUniformMatrix4fv:
+            return TRACE_UNIFORM;
+
+        case GLF_glAttachShader:
+        case GLF_glCompileShader:
+        case GLF_glCreateProgram:
+        case GLF_glCreateShader:
+        case GLF_glDeleteProgram:
+        case GLF_glDeleteShader:
+        case GLF_glGetAttribLocation:
+        case GLF_glLinkProgram:
+        case GLF_glProgramBinary:
+        case GLF_glProgramParameteri:
+        case GLF_glShaderSource:
+            return TRACE_SHADER;
+
+        case GLF_glClientWaitSync:
+        case GLF_glDeleteSync:
+        case GLF_glFenceSync:
+            return TRACE_SYNC;
+
+        case GLF_glDeleteBuffers:
+        case GLF_glGenBuffers:
+        case GLF_glGenFramebuffers:
+        case GLF_glGenTextures:
+        case GLF_glGenVertexArrays:
+            return TRACE_RESOURCE;
+
+        default:
+            return TRACE_STATE;
+        }
+    }
+
+    /**
+     * @brief Is the function a query? (queries aren't recorded, they don't change anything)
+     *
+     * @param f The function
+     * @return is it a query?
+     */
+    bool query(GL_FUNCTION f)
+    {
+        switch (f)
+        {
+        case GLF_glCheckFramebufferStatus:
+        case GLF_glGetError:
+        case GLF_glGetIntegerv:
+        case GLF_glGetProgramBinary:
+        case GLF_glGetProgramInfoLog:
+        case GLF_glGetProgramiv:
+        case GLF_glGetShaderInfoLog:
+        case GLF_glGetShaderiv:
+        case GLF_glGetString:
+        case GLF_glGetStringi:
+        case GLF_glMapBufferRange: // not recorded, writes to mapped memory can't be seen (see geometry::restream())
+        case GLF_glReadPixels:
+        case GLF_glGenQueries: // timer queries (profiling, not rendering)
+        case GLF_glGetQueryObjectiv:
+        case GLF_glGetQueryObjectui64v:
+        case GLF_glQueryCounter:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief Get the size of a texture's data
+     *
+     * @param width The width
+     * @param height The height
+     * @param depth The depth (layers)
+     * @param format The format (ex. GL_RGBA)
+     * @param type The type (ex. GL_UNSIGNED_BYTE)
+     * @return The size (in bytes)
+     */
+    size_t image(size_t width, size_t height, size_t depth, GLenum format, GLenum type)
+    {
+        size_t components = 4;
+        if (format == GL_RED || format == GL_DEPTH_COMPONENT)
+            components = 1;
+        else if (format == GL_RG)
+            components = 2;
+        else if (format == GL_RGB)
+            components = 3;
+
+        size_t size = type == GL_FLOAT || type == GL_UNSIGNED_INT || type == GL_INT ? 4 : (type == GL_UNSIGNED_SHORT || type == GL_SHORT || type == GL_HALF_FLOAT ? 2 : 1);
+
+        size_t row = width * components * size;
+        row = (row + unpack_alignment - 1) / unpack_alignment * unpack_alignment;
+        return row * height * depth;
+    }
+
+    // Recording
+
+    template <typename T>
+    void put(T v)
+    {
+        const unsigned char *p = (const unsigned char *)&v;
+        data.insert(data.end(), p, p + sizeof(T));
+    }
+
+    /**
+     * @brief Write an argument (pointers are written as 64-bit values, they are offsets or have a payload)
+     */
+    template <typename T>
+    void arg(T v)
+    {
+        if constexpr (std::is_pointer<T>::value)
+            put<uint64_t>((uint64_t)(uintptr_t)v);
+        else
+            put<T>(v);
+    }
+
+    /**
+     * @brief Write a payload (size, then the data)
+     *
+     * @param p The data (NULL for none)
+     * @param n The size
+     */
+    void blob(const void *p, size_t n)
+    {
+        if (p == NULL)
+            n = 0;
+
+        put<uint32_t>((uint32_t)n);
+        data.insert(data.end(), (const unsigned char *)p, (const unsigned char *)p + n);
+    }
+
+    /**
+     * @brief Does the function have a payload?
+     */
+    constexpr bool payloaded(GL_FUNCTION f)
+    {
+        return f == GLF_glBufferData || f == GLF_glBufferSubData || f == GLF_glBufferStorage ||
+               f == GLF_glTexImage2D || f == GLF_glTexImage3D || f == GLF_glTexParameterfv ||
+               f == GLF_glShaderSource || f == GLF_glProgramBinary || f == GLF_glUniformMatrix4fv || f == GLF_glUniform1iv ||
+               f == GLF_glGenBuffers || f == GLF_glGenFramebuffers || f == GLF_glGenTextures || f == GLF_glGenVertexArrays ||
+               f == GLF_glDeleteBuffers ||
+               f == GLF_glGetUniformLocation || f == GLF_glGetUniformBlockIndex || f == GLF_glGetAttribLocation;
+    }
+
+    /**
+     * @brief Write the data a command reads (or the names it generates)
+     */
+    template <GL_FUNCTION id, typename... A>
+    void payload(A... args)
+    {
+        auto a = std::make_tuple(args...);
+
+        if constexpr (id == GLF_glBufferData || id == GLF_glBufferStorage) // (target, size, data, ...)
+            blob(std::get<2>(a), std::get<1>(a));
+        else if constexpr (id == GLF_glBufferSubData) // (target, offset, size, data)
+            blob(std::get<3>(a), std::get<2>(a));
+        else if constexpr (id == GLF_glTexImage2D) // (target, level, internal, width, height, border, format, type, pixels)
+            blob(std::get<8>(a), image(std::get<3>(a), std::get<4>(a), 1, std::get<6>(a), std::get<7>(a)));
+        else if constexpr (id == GLF_glTexImage3D) // (target, level, internal, width, height, depth, border, format, type, pixels)
+            blob(std::get<9>(a), image(std::get<3>(a), std::get<4>(a), std::get<5>(a), std::get<7>(a), std::get<8>(a)));
+        else if constexpr (id == GLF_glTexParameterfv) // (target, pname, params)
+            blob(std::get<2>(a), sizeof(float) * (std::get<1>(a) == GL_TEXTURE_BORDER_COLOR ? 4 : 1));
+        else if constexpr (id == GLF_glProgramBinary) // (program, format, binary, length)
+            blob(std::get<2>(a), std::get<3>(a));
+        else if constexpr (id == GLF_glUniformMatrix4fv) // (location, count, transpose, value)
+            blob(std::get<3>(a), sizeof(float) * 16 * std::get<1>(a));
+        else if constexpr (id == GLF_glUniform1iv) // (location, count, value)
+            blob(std::get<2>(a), sizeof(GLint) * std::get<1>(a));
+        else if constexpr (id == GLF_glGenBuffers || id == GLF_glGenFramebuffers || id == GLF_glGenTextures ||
+                           id == GLF_glGenVertexArrays || id == GLF_glDeleteBuffers) // (n, names)
+            blob(std::get<1>(a), sizeof(GLuint) * std::get<0>(a));
+        else if constexpr (id == GLF_glGetUniformLocation || id == GLF_glGetUniformBlockIndex || id == GLF_glGetAttribLocation) // (program, name)
+            blob(std::get<1>(a), strlen(std::get<1>(a)) + 1);
+        else if constexpr (id == GLF_glShaderSource) // (shader, count, strings, lengths), the strings are written as {uint32 length, chars}
+        {
+            std::string all;
+            for (GLsizei i = 0; i < std::get<1>(a); i++)
+            {
+                uint32_t n = std::get<3>(a) != NULL && std::get<3>(a)[i] >= 0 ? std::get<3>(a)[i] : strlen(std::get<2>(a)[i]);
+                all.append((const char *)&n, sizeof(n));
+                all.append(std::get<2>(a)[i], n);
+            }
+            blob(all.data(), all.size());
+        }
+        else if constexpr (id == GLF_glPixelStorei)
+        {
+            if (std::get<0>(a) == GL_UNPACK_ALIGNMENT)
+                unpack_alignment = std::get<1>(a);
+        }
+    }
+
+    /**
+     * @brief A recording function (calls the original, then writes the command)
+     */
+    template <GL_FUNCTION id, typename F>
+    struct recorder;
+
+    template <GL_FUNCTION id, typename R, typename... A>
+    struct recorder<id, R(APIENTRYP)(A...)>
+    {
+        typedef R(APIENTRYP function)(A...);
+
+        static size_t begin(A... args)
+        {
+            put<uint16_t>((uint16_t)id);
+            size_t at = data.size();
+            put<uint32_t>(0);
+
+            (arg(args), ...);
+            payload<id>(args...);
+            return at;
+        }
+
+        static void end(size_t at)
+        {
+            uint32_t size = (uint32_t)(data.size() - at - sizeof(uint32_t));
+            memcpy(&data[at], &size, sizeof(size));
+        }
+
+        static R APIENTRY call(A... args)
+        {
+            if constexpr (std::is_void<R>::value)
+            {
+                ((function)original[id])(args...);
+                end(begin(args...));
+            }
+            else
+            {
+                R r = ((function)original[id])(args...);
+                size_t at = begin(args...);
+                arg(r);
+                end(at);
+                return r;
+            }
+        }
+    };
+
+    /**
+     * @brief Record the next frames (call before creating the Engine, the recording starts with the device)
+     *
+     * @param file The trace's path
+     * @param n The number of frames
+     */
+    void start(std::string file, uint n)
+    {
+        path = file;
+        frames = n;
+        armed = true;
+    }
+
+    /**
+     * @brief Start recording (called by the engine, after the device is open)
+     *
+     * @param width The surface's width
+     * @param height The surface's height
+     */
+    void attach(int width, int height)
+    {
+        if (!armed || recording)
+            return;
+
+        header = __trace_header_t();
+        header.width = width;
+        header.height = height;
+        header.screen = glstate::screen;
+
+        data.clear();
+        unpack_alignment = 4;
+
+#define __TRACE_WRAP(name)                                                           \
+    original[GLF_##name] = (void *)glad_##name;                                      \
+    if (!query(GLF_##name))                                                          \
+        glad_##name = recorder<GLF_##name, decltype(glad_##name)>::call;
+        GL_FUNCTIONS(__TRACE_WRAP)
+#undef __TRACE_WRAP
+
+        recording = true;
+    }
+
+    /**
+     * @brief Stop recording & save the trace
+     */
+    void stop()
+    {
+        if (!recording)
+            return;
+
+#define __TRACE_UNWRAP(name) glad_##name = (decltype(glad_##name))original[GLF_##name];
+        GL_FUNCTIONS(__TRACE_UNWRAP)
+#undef __TRACE_UNWRAP
+
+        recording = false;
+        armed = false;
+
+        std::ofstream f(path, std::ios::binary);
+        if (!f.is_open())
+        {
+            debug::warning("trace::stop()", "can't save the trace", path.c_str());
+            return;
+        }
+
+        f.write((const char *)&header, sizeof(header));
+        f.write((const char *)data.data(), data.size());
+        debug::log("trace::stop()", "saved the trace", path.c_str());
+
+        data.clear();
+        data.shrink_to_fit();
+    }
+
+    /**
+     * @brief End a frame (called by the engine after presenting, stops after the last frame)
+     */
+    void frame()
+    {
+        if (!recording)
+            return;
+
+        put<uint16_t>(TRACE_FRAME);
+        put<uint32_t>(0);
+
+        // The first marker ends the setup
+        if (header.frames++ == frames)
+        {
+            header.frames = frames;
+            stop();
+        }
+    }
+
+    // Playing
+
+    template <typename T>
+    void take(const unsigned char *&p, T &v)
+    {
+        if constexpr (std::is_pointer<T>::value)
+        {
+            uint64_t u;
+            memcpy(&u, p, sizeof(u));
+            p += sizeof(u);
+            v = (T)(uintptr_t)u;
+        }
+        else
+        {
+            memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+        }
+    }
+
+    /**
+     * @brief Get a replayed name
+     *
+     * @param m The names
+     * @param recorded The recorded name
+     * @return The replayed name (the recorded one, if it's unknown)
+     */
+    uint name(const std::unordered_map<uint, uint> &m, uint recorded)
+    {
+        auto it = m.find(recorded);
+        return it != m.end() ? it->second : recorded;
+    }
+
+    uint64_t key(uint program, uint64_t value)
+    {
+        return ((uint64_t)program << 32) | (value & 0xFFFFFFFFu);
+    }
+
+    /**
+     * @brief A playing function (reads the command, translates it's names & calls OpenGL)
+     */
+    template <GL_FUNCTION id, typename F>
+    struct player;
+
+    template <GL_FUNCTION id, typename R, typename... A>
+    struct player<id, R(APIENTRYP)(A...)>
+    {
+        typedef R(APIENTRYP function)(A...);
+
+        static void play(void *fn, __trace_names_t &n, const unsigned char *p)
+        {
+            std::tuple<A...> a;
+            std::apply([&](A &...v)
+                       { (take(p, v), ...); },
+                       a);
+
+            // The payload
+            const unsigned char *payload = NULL;
+            uint32_t size = 0;
+            if constexpr (payloaded(id))
+            {
+                take(p, size);
+                payload = size > 0 ? p : NULL;
+                p += size;
+            }
+
+            // Point the arguments at the payload & translate the names
+            if constexpr (id == GLF_glBufferData || id == GLF_glBufferStorage)
+                std::get<2>(a) = payload;
+            else if constexpr (id == GLF_glBufferSubData)
+                std::get<3>(a) = payload;
+            else if constexpr (id == GLF_glTexImage2D)
+                std::get<8>(a) = payload;
+            else if constexpr (id == GLF_glTexImage3D)
+                std::get<9>(a) = payload;
+            else if constexpr (id == GLF_glTexParameterfv)
+                std::get<2>(a) = (const GLfloat *)payload;
+            else if constexpr (id == GLF_glUniformMatrix4fv)
+            {
+                std::get<0>(a) = n.locations.count(key(n.program, std::get<0>(a))) ? n.locations[key(n.program, std::get<0>(a))] : std::get<0>(a);
+                std::get<3>(a) = (const GLfloat *)payload;
+            }
+            else if constexpr (id == GLF_glUniform1iv)
+            {
+                std::get<0>(a) = n.locations.count(key(n.program, std::get<0>(a))) ? n.locations[key(n.program, std::get<0>(a))] : std::get<0>(a);
+                std::get<2>(a) = (const GLint *)payload;
+            }
+            else if constexpr (id == GLF_glUniform1f || id == GLF_glUniform1i || id == GLF_glUniform2f || id == GLF_glUniform3f)
+                std::get<0>(a) = n.locations.count(key(n.program, std::get<0>(a))) ? n.locations[key(n.program, std::get<0>(a))] : std::get<0>(a);
+            else if constexpr (id == GLF_glGenBuffers || id == GLF_glGenFramebuffers || id == GLF_glGenTextures || id == GLF_glGenVertexArrays)
+            {
+                n.scratch.resize(std::get<0>(a));
+                std::get<1>(a) = n.scratch.data();
+            }
+            else if constexpr (id == GLF_glDeleteBuffers)
+            {
+                n.scratch.resize(std::get<0>(a));
+                for (GLsizei i = 0; i < std::get<0>(a); i++)
+                {
+                    uint recorded;
+                    memcpy(&recorded, payload + i * sizeof(uint), sizeof(uint));
+                    n.scratch[i] = name(n.buffers, recorded);
+                    n.buffers.erase(recorded);
+                }
+                std::get<1>(a) = n.scratch.data();
+            }
+            else if constexpr (id == GLF_glShaderSource)
+            {
+                n.strings.clear();
+                n.lengths.clear();
+                for (const unsigned char *s = payload; s != NULL && s < payload + size;)
+                {
+                    uint32_t length;
+                    memcpy(&length, s, sizeof(length));
+                    n.strings.push_back((const GLchar *)s + sizeof(length));
+                    n.lengths.push_back((GLint)length);
+                    s += sizeof(length) + length;
+                }
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+                std::get<2>(a) = n.strings.data();
+                std::get<3>(a) = n.lengths.data();
+            }
+            else if constexpr (id == GLF_glProgramBinary)
+            {
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+                std::get<2>(a) = payload;
+            }
+            else if constexpr (id == GLF_glGetUniformLocation || id == GLF_glGetUniformBlockIndex || id == GLF_glGetAttribLocation)
+            {
+                n.queried = std::get<0>(a);
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+                std::get<1>(a) = (const GLchar *)payload;
+            }
+            else if constexpr (id == GLF_glBindBuffer)
+                std::get<1>(a) = name(n.buffers, std::get<1>(a));
+            else if constexpr (id == GLF_glBindBufferBase || id == GLF_glTexBuffer)
+                std::get<2>(a) = name(n.buffers, std::get<2>(a));
+            else if constexpr (id == GLF_glBindTexture)
+                std::get<1>(a) = name(n.textures, std::get<1>(a));
+            else if constexpr (id == GLF_glFramebufferTexture || id == GLF_glFramebufferTextureLayer)
+                std::get<2>(a) = name(n.textures, std::get<2>(a));
+            else if constexpr (id == GLF_glBindFramebuffer)
+                std::get<1>(a) = name(n.framebuffers, std::get<1>(a));
+            else if constexpr (id == GLF_glBindVertexArray)
+                std::get<0>(a) = name(n.vertexarrays, std::get<0>(a));
+            else if constexpr (id == GLF_glUseProgram)
+            {
+                n.program = std::get<0>(a);
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+            }
+            else if constexpr (id == GLF_glAttachShader)
+            {
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+                std::get<1>(a) = name(n.programs, std::get<1>(a));
+            }
+            else if constexpr (id == GLF_glCompileShader || id == GLF_glLinkProgram || id == GLF_glDeleteShader ||
+                               id == GLF_glDeleteProgram || id == GLF_glProgramParameteri)
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+            else if constexpr (id == GLF_glUniformBlockBinding)
+            {
+                uint64_t k = key(std::get<0>(a), std::get<1>(a));
+                std::get<0>(a) = name(n.programs, std::get<0>(a));
+                std::get<1>(a) = n.blocks.count(k) ? n.blocks[k] : std::get<1>(a);
+            }
+            else if constexpr (id == GLF_glClientWaitSync || id == GLF_glDeleteSync)
+            {
+                // Fences of frames before the loop's start are gone
+                auto it = n.syncs.find((uint64_t)(uintptr_t)std::get<0>(a));
+                if (it == n.syncs.end())
+                    return;
+                std::get<0>(a) = it->second;
+
+                if constexpr (id == GLF_glDeleteSync)
+                    n.syncs.erase(it);
+            }
+
+            // Call & remember the new names
+            if constexpr (std::is_void<R>::value)
+            {
+                std::apply((function)fn, a);
+
+                if constexpr (id == GLF_glGenBuffers || id == GLF_glGenFramebuffers || id == GLF_glGenTextures || id == GLF_glGenVertexArrays)
+                {
+                    std::unordered_map<uint, uint> &m = id == GLF_glGenBuffers ? n.buffers : (id == GLF_glGenFramebuffers ? n.framebuffers : (id == GLF_glGenTextures ? n.textures : n.vertexarrays));
+                    for (GLsizei i = 0; i < std::get<0>(a); i++)
+                    {
+                        uint recorded;
+                        memcpy(&recorded, payload + i * sizeof(uint), sizeof(uint));
+                        m[recorded] = n.scratch[i];
+                    }
+                }
+            }
+            else
+            {
+                R r = std::apply((function)fn, a);
+                R recorded;
+                take(p, recorded);
+
+                if constexpr (id == GLF_glCreateShader || id == GLF_glCreateProgram)
+                    n.programs[recorded] = r;
+                else if constexpr (id == GLF_glFenceSync)
+                    n.syncs[(uint64_t)(uintptr_t)recorded] = r;
+                else if constexpr (id == GLF_glGetUniformLocation)
+                    n.locations[key(n.queried, recorded)] = r;
+                else if constexpr (id == GLF_glGetUniformBlockIndex)
+                    n.blocks[key(n.queried, recorded)] = r;
+            }
+        }
+    };
+};
+
+/**
+ * @brief A command in a loaded trace
+ */
+struct __trace_command_t
+{
+    uint16_t id;
+    size_t offset; // the arguments' offset
+};
+
+/**
+ * @brief A loaded trace (for replaying, see src/replay.cpp)
+ */
+class Replay
+{
+private:
+    std::vector<unsigned char> data;
+    std::vector<__trace_command_t> commands;
+    std::vector<size_t> starts; // the first command of the frames (the setup is frame 0)
+
+    void (*players[GL_FUNCTION_COUNT])(void *, __trace_names_t &, const unsigned char *);
+    void *functions[GL_FUNCTION_COUNT];
+
+    void play(size_t first, size_t last, double *times);
+
+public:
+    __trace_header_t header;
+    __trace_names_t names;
+
+    bool load(std::string path);
+
+    uint frames();
+    void setup();
+    float frame(uint i, double times[TRACE_CATEGORY_COUNT]);
+};
+
+/**
+ * @brief Load a trace (call after the device is open)
+ *
+ * @param path The trace's path
+ * @return could it be loaded?
+ */
+bool Replay::load(std::string path)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open())
+    {
+        debug::warning("Replay::load()", "can't open the trace", path.c_str());
+        return false;
+    }
+
+    f.read((char *)&this->header, sizeof(this->header));
+    if (!f || this->header.magic != TRACE_MAGIC || this->header.version != TRACE_VERSION)
+    {
+        debug::warning("Replay::load()", "not a trace (or an other version)", path.c_str());
+        return false;
+    }
+
+    this->data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+
+    // Index the commands
+    this->commands.clear();
+    this->starts = {0};
+
+    for (size_t at = 0; at + sizeof(uint16_t) + sizeof(uint32_t) <= this->data.size();)
+    {
+        __trace_command_t c;
+        uint32_t size;
+        memcpy(&c.id, &this->data[at], sizeof(c.id));
+        memcpy(&size, &this->data[at + sizeof(c.id)], sizeof(size));
+        c.offset = at + sizeof(c.id) + sizeof(size);
+        at = c.offset + size;
+
+        if (c.id == TRACE_FRAME)
+            this->starts.push_back(this->commands.size());
+        else if (c.id < GL_FUNCTION_COUNT)
+            this->commands.push_back(c);
+    }
+
+    // The functions of the device
+#define __TRACE_PLAYER(name)                                                      \
+    this->players[GLF_##name] = trace::player<GLF_##name, decltype(glad_##name)>::play; \
+    this->functions[GLF_##name] = (void *)glad_##name;
+    GL_FUNCTIONS(__TRACE_PLAYER)
+#undef __TRACE_PLAYER
+
+    // The recording's window is the replay's window
+    this->names = __trace_names_t();
+    this->names.framebuffers[this->header.screen] = glstate::screen;
+
+    return true;
+}
+
+/**
+ * @brief Get the number of recorded frames
+ *
+ * @return The frames
+ */
+uint Replay::frames()
+{
+    return this->starts.size() > 1 ? (uint)this->starts.size() - 2 : 0;
+}
+
+void Replay::play(size_t first, size_t last, double *times)
+{
+    double frequency = (double)SDL_GetPerformanceFrequency();
+
+    for (size_t i = first; i < last; i++)
+    {
+        const __trace_command_t &c = this->commands[i];
+
+        Uint64 start = times != NULL ? SDL_GetPerformanceCounter() : 0;
+        this->players[c.id](this->functions[c.id], this->names, &this->data[c.offset]);
+
+        if (times != NULL)
+            times[trace::category((GL_FUNCTION)c.id)] += (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+    }
+}
+
+/**
+ * @brief Replay the setup (the commands before the first frame: loading shaders, meshes & textures)
+ */
+void Replay::setup()
+{
+    if (this->starts.size() > 1)
+        this->play(this->starts[0], this->starts[1], NULL);
+}
+
+/**
+ * @brief Replay a frame
+ *
+ * @param i The frame (0 - frames() - 1)
+ * @param times The time spent in each category (in ms, added to)
+ * @return The time of the frame's commands (in ms, without waiting for the GPU)
+ */
+float Replay::frame(uint i, double times[TRACE_CATEGORY_COUNT])
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    this->play(this->starts[i + 1], this->starts[i + 2], times);
+    return (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+}
@@ -241,6 +241,17 @@ namespace vector
 #undef near
 #undef far
 
+/**
+ * @brief Quaternion (a rotation)
+ */
+struct quat
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 1.0f;
+};
+
 /**
  * @brief 4 by 4 matrix
  */
@@ -315,6 +326,19 @@ namespace matrix
         return result;
     }
 
+    mat4 ortho(float left, float right, float bottom, float top, float near, float far)
+    {
+        mat4 result;
+        result.m[0][0] = 2.0f / (right - left);
+        result.m[1][1] = 2.0f / (top - bottom);
+        result.m[2][2] = -2.0f / (far - near);
+        result.m[3][0] = -(right + left) / (right - left);
+        result.m[3][1] = -(top + bottom) / (top - bottom);
+        result.m[3][2] = -(far + near) / (far - near);
+        result.m[3][3] = 1.0f;
+        return result;
+    }
+
     mat4 rotationX(float rad)
     {
         mat4 matrix;
@@ -417,6 +441,24 @@ namespace matrix
         return matrix;
     }
 
+    mat4 rotate(quat q)
+    {
+        mat4 matrix = identity();
+
+        // Row vectors (v * matrix), like the other matrices
+        matrix.m[0][0] = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
+        matrix.m[0][1] = 2.0f * (q.x * q.y + q.z * q.w);
+        matrix.m[0][2] = 2.0f * (q.x * q.z - q.y * q.w);
+        matrix.m[1][0] = 2.0f * (q.x * q.y - q.z * q.w);
+        matrix.m[1][1] = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
+        matrix.m[1][2] = 2.0f * (q.y * q.z + q.x * q.w);
+        matrix.m[2][0] = 2.0f * (q.x * q.z + q.y * q.w);
+        matrix.m[2][1] = 2.0f * (q.y * q.z - q.x * q.w);
+        matrix.m[2][2] = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+
+        return matrix;
+    }
+
     mat4 rotateOffset(vec3 rad, vec3 point)
     {
         mat4 matrix, x, y, z;
@@ -470,6 +512,16 @@ namespace matrix
  */
 typedef uint texture;
 
+/**
+ * @brief Decoded pixels of an image (see loadin::decode())
+ */
+struct bitmap
+{
+    int width = 0, height = 0;
+    int channels = 0;                  // bytes per pixel (3 - RGB, 4 - RGBA)
+    std::vector<unsigned char> pixels; // tightly packed rows, from the bottom one (as OpenGL expects them)
+};
+
 /**
  * @brief One Renderable Character
  */
@@ -491,15 +543,15 @@ typedef std::map<char, character> font;
  */
 struct material
 {
-    bool lit;
-    bool textured;
+    bool lit = false;
+    bool textured = false;
 
-    float d;
+    float d = 1.0f; // opacity (transparent if < 1)
 
-    texture diffuse;
-    texture specular;
+    texture diffuse = 0;
+    texture specular = 0;
 
-    float shininess;
+    float shininess = 32.0f;
 };
 
 /**
@@ -519,6 +571,50 @@ struct mesh
     std::vector<float> normals;
     int tris = 0;
 
+    // The Local Bounds (see loadin::bounds())
+    vec3 min, max;
+    vec3 center;
+    float radius = 0.0f;
+
     // The Scale of the Mesh
     float scale;
+};
+
+/**
+ * @brief A joint of a skeleton
+ */
+struct joint
+{
+    std::string name;
+    int parent = -1; // the parent's index (-1 for roots, parents come before their children)
+
+    // The rest pose (relative to the parent)
+    vec3 position;
+    quat rotation;
+
+    mat4 inverse_bind; // mesh space -> the joint's space (of the rest pose)
+};
+
+/**
+ * @brief A skeleton & the influences of it's mesh's vertices (see loadin::rig())
+ */
+struct skeleton
+{
+    std::vector<joint> joints; // max. 256
+
+    // 4 per vertex (in the mesh's order, 3 vertices per triangle), the weights add up to 1
+    std::vector<unsigned char> influences;
+    std::vector<float> weights;
+};
+
+/**
+ * @brief An animation's keys (see loadin::anim(), compressed by animation::compress())
+ */
+struct keyframes
+{
+    std::string name;
+    float duration = 0.0f; // in seconds
+
+    // Per joint: {time, translation (3), rotation (4), scale (3)} per key, in time order
+    std::vector<std::vector<float>> keys;
 };
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
+#include <stdio.h>
 
 #include <tools/types.h>
 
@@ -294,6 +296,52 @@ std::string ctos(char c)
     return std::string("") + c;
 }
 
+// ---------- Hashing ----------
+
+/**
+ * @brief Hash a block of memory (64-bit FNV-1a)
+ *
+ * @param data The data to hash
+ * @param size The size of the data (in bytes)
+ * @param h The previous hash (to chain multiple blocks)
+ * @return The hash
+ */
+uint64_t hash(const void *data, size_t size, uint64_t h = 14695981039346656037ULL)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * @brief Hash a string (64-bit FNV-1a)
+ *
+ * @param s The string to hash
+ * @param h The previous hash (to chain multiple strings)
+ * @return The hash
+ */
+uint64_t hash(std::string s, uint64_t h = 14695981039346656037ULL)
+{
+    return hash(s.data(), s.size(), h);
+}
+
+/**
+ * @brief Convert a 64-bit integer to a hexadecimal string
+ *
+ * @param num the integer
+ * @return the generated string
+ */
+std::string htos(uint64_t num)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)num);
+    return buf;
+}
+
 // ---------- Surface ----------
 void flip_surface(SDL_Surface *surface)
 {
@@ -4,7 +4,7 @@ int main()
 {
 	// Init Engine & Camera
 	Engine e("Game Engine");
-	camera cam(&e.width, &e.height, shader::load("3d"));
+	camera cam(&e.width, &e.height, shader::permute("3d", {"TEXTURED", "COLORED", "INSTANCED"}));
 
 	cam.position.z = -25;
 	cam.position.y = 20;
@@ -19,6 +19,7 @@ int main()
 	e.objs["thing"].add("objects.lua");
 	e.objs["thing"].add(loadin::image("a.jpg"));
 	e.objs["thing"].add(e.objs["thing"].m, true, false);
+	e.objs["thing"].occluder = true;
 
 	e.objs["groundcheck"].add(loadin::obj("cube.obj"), true, false);
 
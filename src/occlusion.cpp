@@ -0,0 +1,121 @@
+// Benchmarks the CPU occlusion culling on a generated city (the draws it removes & the CPU time it costs)
+//
+// usage: occlusion [frames = 100] [props = 20000] [device: null, headless, gl]
+
+#include <engine/engine.h>
+
+/**
+ * @brief Generate a box (centered on the origin)
+ *
+ * @param size The box's size
+ * @return The box
+ */
+mesh box(vec3 size)
+{
+	static const int faces[6][4][3] = {
+		{{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}},
+		{{1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}},
+		{{1, -1, 1}, {1, -1, -1}, {1, 1, -1}, {1, 1, 1}},
+		{{-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}},
+		{{-1, 1, 1}, {1, 1, 1}, {1, 1, -1}, {-1, 1, -1}},
+		{{-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}}};
+	static const int corners[6] = {0, 1, 2, 0, 2, 3};
+	static const float normals[6][3] = {{0, 0, 1}, {0, 0, -1}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}};
+
+	mesh m;
+	for (int f = 0; f < 6; f++)
+	{
+		for (int c : corners)
+		{
+			m.vertices.push_back(faces[f][c][0] * size.x * 0.5f);
+			m.vertices.push_back(faces[f][c][1] * size.y * 0.5f);
+			m.vertices.push_back(faces[f][c][2] * size.z * 0.5f);
+
+			m.texcoords.push_back(c == 1 || c == 2 ? 1.0f : 0.0f);
+			m.texcoords.push_back(c >= 2 ? 1.0f : 0.0f);
+
+			m.normals.insert(m.normals.end(), normals[f], normals[f] + 3);
+		}
+	}
+	m.tris = 12;
+	return m;
+}
+
+int main(int argc, char **argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 100;
+	int props = argc > 2 ? atoi(argv[2]) : 20000;
+	std::string type = argc > 3 ? argv[3] : "null";
+
+	Engine e("Occlusion Benchmark", false, false, type == "gl" ? DEVICE_GL : (type == "headless" ? DEVICE_HEADLESS : DEVICE_NULL), 1280, 720);
+	camera cam(&e.width, &e.height, shader::permute("3d", {"TEXTURED", "COLORED", "INSTANCED"}));
+	e.select(&cam);
+
+	// The City: 10 x 10 blocks of buildings (20 x 20, 10 - 40 high) & 10 wide streets, the buildings are the occluders
+	uint32_t seed = 1;
+	auto random = [&](float min, float max)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return min + (max - min) * (float)(seed >> 8) / (float)(1 << 24);
+	};
+
+	for (int i = 0; i < 10; i++)
+	{
+		for (int j = 0; j < 10; j++)
+		{
+			float height = random(10.0f, 40.0f);
+			object &b = e.objs["building " + std::to_string(i) + " " + std::to_string(j)];
+			b.add(box({20.0f, height, 20.0f}));
+			b.position = {-150.0f + 30.0f * i + 15.0f, height * 0.5f, 30.0f * j + 15.0f};
+			b.occluder = true;
+		}
+	}
+
+	// The Props (in the streets, hidden by the buildings from most places)
+	mesh prop = box({1.0f, 1.0f, 1.0f});
+	for (int i = 0; i < props; i++)
+	{
+		float x, z;
+		do
+		{
+			x = random(-150.0f, 150.0f);
+			z = random(0.0f, 300.0f);
+		} while (fmodf(x + 150.0f, 30.0f) > 5.0f && fmodf(x + 150.0f, 30.0f) < 25.0f && fmodf(z, 30.0f) > 5.0f && fmodf(z, 30.0f) < 25.0f);
+
+		object &p = e.objs["prop " + std::to_string(i)];
+		p.add(prop);
+		p.position = {x, 0.5f, z};
+	}
+
+	// The Camera stands in a street, looking down it (along z)
+	cam.position = {0.0f, 1.7f, -10.0f};
+	cam.rotation.y = 90.0f;
+	cam.far = 500.0f;
+
+	// Results
+	printf("%d buildings, %d props, %d frames per run, %s device\n\n", 100, props, frames, type.c_str());
+	printf("occlusion   drawn   occluded   draws   occlusion (ms)   frame (ms)\n");
+
+	for (int on = 0; on < 2; on++)
+	{
+		e.occlusion.enabled = on;
+		e.update(0.0f, 0.0f, 0.0f); // (the proxies are prepared in the first frame)
+
+		float occlusion = 0.0f, frame = 0.0f;
+		uint draws = 0;
+		for (int i = 0; i < frames; i++)
+		{
+			Uint64 start = SDL_GetPerformanceCounter();
+			e.update(0.0f, 0.0f, 0.0f);
+			frame += (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+
+			occlusion += on ? e.occlusion.time : 0.0f;
+			draws = glstate::last.draws;
+		}
+
+		printf("%-9s %7u %10u %7u %16.3f %12.3f\n", on ? "on" : "off", e.visible, on ? e.occlusion.occluded : 0, draws, occlusion / frames, frame / frames);
+	}
+
+	e.clean();
+	return 0;
+}
@@ -0,0 +1,86 @@
+// Replays a command trace (see trace::start()) & times it's frames
+//
+// usage: replay <trace> [loops = 100] [device: gl, headless, null]
+
+#include <tools/device.h>
+#include <tools/trace.h>
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: replay <trace> [loops = 100] [device: gl, headless, null]\n");
+		return 1;
+	}
+
+	std::string path = argv[1];
+	int loops = argc > 2 ? atoi(argv[2]) : 100;
+	std::string type = argc > 3 ? argv[3] : "gl";
+
+	// Read the surface's size
+	Replay replay;
+	std::ifstream f(path, std::ios::binary);
+	if (!f.is_open() || !f.read((char *)&replay.header, sizeof(replay.header)))
+		debug::error("replay", "can't open the trace", path.c_str());
+	f.close();
+
+	// Open the Device
+	Device *device = devices::create(type == "null" ? DEVICE_NULL : (type == "headless" ? DEVICE_HEADLESS : DEVICE_GL));
+	devices::current = device;
+
+	int width = replay.header.width, height = replay.header.height;
+	device->open("Replay", width, height, false, false);
+	glstate::invalidate();
+
+	if (!replay.load(path))
+		return 1;
+
+	uint frames = replay.frames();
+	if (frames == 0)
+		debug::error("replay", "the trace has no frames", path.c_str());
+
+	// Setup (shaders, meshes, textures)
+	Uint64 start = SDL_GetPerformanceCounter();
+	replay.setup();
+	device->present();
+	float setup = (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+
+	// Replay the frames
+	std::vector<double> total(frames, 0.0), submit(frames, 0.0);
+	std::vector<float> best(frames, 1e30f);
+	double times[TRACE_CATEGORY_COUNT] = {};
+
+	for (int l = 0; l < loops; l++)
+	{
+		for (uint i = 0; i < frames; i++)
+		{
+			start = SDL_GetPerformanceCounter();
+			submit[i] += replay.frame(i, times);
+			device->present();
+
+			float t = (float)(SDL_GetPerformanceCounter() - start) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+			total[i] += t;
+			best[i] = fminf(best[i], t);
+		}
+	}
+
+	// Results
+	printf("%s: %u frames, %d loops, %ux%u, setup %.3f ms\n\n", path.c_str(), frames, loops, replay.header.width, replay.header.height, setup);
+
+	printf("frame    avg (ms)   best (ms)   submit (ms)\n");
+	double all = 0.0;
+	for (uint i = 0; i < frames; i++)
+	{
+		printf("%5u %11.3f %11.3f %13.3f\n", i, total[i] / loops, best[i], submit[i] / loops);
+		all += total[i];
+	}
+	printf("  all %11.3f\n\n", all / loops / frames);
+
+	printf("category    per frame (ms)\n");
+	for (int c = 0; c < TRACE_CATEGORY_COUNT; c++)
+		printf("%-8s %17.3f\n", trace_category_names[c], times[c] / loops / frames);
+
+	device->close();
+	delete device;
+	return 0;
+}
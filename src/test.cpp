@@ -0,0 +1,40 @@
+// Runs the unit tests of the engine's CPU code (no window or OpenGL needed)
+//
+// usage: tests
+
+#include "tests/queue.h"
+#include "tests/culling.h"
+#include "tests/occlusion.h"
+#include "tests/cascades.h"
+#include "tests/workers.h"
+#include "tests/animation.h"
+#include "tests/terrain.h"
+#include "tests/clusters.h"
+
+int main()
+{
+	struct
+	{
+		const char *name;
+		void (*run)();
+	} tests[] = {
+		{"queue", test_queue},
+		{"culling", test_culling},
+		{"occlusion", test_occlusion},
+		{"cascades", test_cascades},
+		{"workers", test_workers},
+		{"animation", test_animation},
+		{"terrain", test_terrain},
+		{"clusters", test_clusters},
+	};
+
+	for (auto &t : tests)
+	{
+		uint failed = test::failed;
+		t.run();
+		printf("%s %s\n", test::failed == failed ? "[ OK ]" : "[FAIL]", t.name);
+	}
+
+	printf("%u checks passed, %u failed\n", test::passed, test::failed);
+	return test::failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+// Skeletal Animation Tests
+#pragma once
+
+#include <vector>
+#include <math.h>
+
+#include <engine/animation.h>
+
+#include "test.h"
+
+/**
+ * @brief A rotation around an axis
+ *
+ * @param axis The axis (normalized)
+ * @param angle The angle (in radians)
+ * @return The rotation
+ */
+quat __test_rotation(vec3 axis, float angle)
+{
+    return {axis.x * sinf(angle / 2.0f), axis.y * sinf(angle / 2.0f), axis.z * sinf(angle / 2.0f), cosf(angle / 2.0f)};
+}
+
+/**
+ * @brief Compression (the kept keys & the error bound), sampling, blending, the palette & the skinning against scalar code
+ */
+void test_animation()
+{
+    test::random r;
+
+    // A chain of 3 joints (the rest pose's inverse bind matrices, so the rest pose skins to the mesh)
+    skeleton rig;
+    rig.joints.resize(3);
+    for (int i = 0; i < 3; i++)
+    {
+        joint &j = rig.joints[i];
+        j.parent = i - 1;
+        j.position = {0.0f, i == 0 ? 0.0f : 1.0f, 0.0f};
+        j.rotation = __test_rotation({0.0f, 0.0f, 1.0f}, 0.2f * i);
+    }
+
+    std::vector<mat4> models(3);
+    for (int i = 0; i < 3; i++)
+    {
+        const joint &j = rig.joints[i];
+        mat4 local = matrix::rotate(j.rotation);
+        local.m[3][0] = j.position.x;
+        local.m[3][1] = j.position.y;
+        local.m[3][2] = j.position.z;
+        models[i] = j.parent >= 0 ? local * models[j.parent] : local;
+        rig.joints[i].inverse_bind = matrix::inverse(models[i]);
+    }
+
+    // The keys: joint 0 moves linearly, turns (sine) & keeps it's scale, joint 1 has no keys, joint 2 scales with noise
+    keyframes k;
+    k.duration = 2.0f;
+    k.keys.resize(3);
+
+    const int n = 61;
+    for (int i = 0; i < n; i++)
+    {
+        float t = k.duration * i / (n - 1);
+
+        quat q = __test_rotation({0.0f, 1.0f, 0.0f}, sinf(t * 3.0f));
+        float key0[11] = {t, t * 2.0f, 0.5f, -t, q.x, q.y, q.z, q.w, 1.0f, 1.0f, 1.0f};
+        k.keys[0].insert(k.keys[0].end(), key0, key0 + 11);
+
+        quat rest = rig.joints[2].rotation;
+        float s = 1.0f + 0.5f * t + r.range(-0.01f, 0.01f);
+        float key2[11] = {t, 0.0f, 1.0f, 0.0f, rest.x, rest.y, rest.z, rest.w, s, s, s};
+        k.keys[2].insert(k.keys[2].end(), key2, key2 + 11);
+    }
+
+    const float tolerance = 0.001f;
+    clip c = animation::compress(k, rig, tolerance);
+
+    CHECK(c.tracks.size() == 9);
+    CHECK(c.tracks[0].count == 2);                               // linear translation: the ends
+    CHECK(c.tracks[1].count > 2 && c.tracks[1].count < (uint)n); // the sine: some keys
+    CHECK(c.tracks[2].count == 1);                               // constant scale
+    CHECK(c.tracks[8].count > (uint)n / 2);                      // the noise is mostly over the tolerance
+
+    // No keys: the rest pose
+    CHECK(c.tracks[3].count == 1 && c.tracks[4].count == 1 && c.tracks[5].count == 1);
+
+    // Every original key is sampled back within the tolerance (+ the quantization, without looping, so the end is the last key)
+    c.loop = false;
+    pose p;
+    std::vector<uint> cursors;
+    float error = 0.0f;
+    for (int j = 0; j < 3; j += 2)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            const float *key = &k.keys[j][i * 11];
+            animation::sample(c, key[0], p, cursors);
+
+            const float *o = &p.joints[j * 12];
+            float sign = o[4] * key[4] + o[5] * key[5] + o[6] * key[6] + o[7] * key[7] < 0.0f ? -1.0f : 1.0f;
+            for (int x = 0; x < 3; x++)
+                error = fmaxf(error, fmaxf(fabsf(o[x] - key[1 + x]), fabsf(o[8 + x] - key[8 + x])));
+            for (int x = 0; x < 4; x++)
+                error = fmaxf(error, fabsf(o[4 + x] * sign - key[4 + x]));
+        }
+    }
+    CHECK(error < tolerance * 2.0f);
+    c.loop = true;
+
+    // The joint without keys is in the rest pose
+    CHECK(test::near(p.joints[12 + 1], 1.0f) && test::near(p.joints[12 + 7], rig.joints[1].rotation.w) && test::near(p.joints[12 + 8], 1.0f));
+
+    // The cursors only speed up the search (random order gives the same poses) & looping clips wrap around
+    bool same = true;
+    pose fresh;
+    for (int i = 0; i < 200 && same; i++)
+    {
+        float t = r.range(-3.0f, 5.0f);
+        std::vector<uint> none;
+        animation::sample(c, t, p, cursors);
+        animation::sample(c, t + k.duration, fresh, none);
+
+        for (size_t x = 0; x < p.joints.size(); x++)
+            same = same && test::near(p.joints[x], fresh.joints[x], 1e-3f);
+    }
+    CHECK(same);
+
+    // A clip that doesn't loop holds it's last pose
+    c.loop = false;
+    animation::sample(c, k.duration * 3.0f, fresh, cursors);
+    CHECK(test::near(fresh.joints[0], 4.0f, 1e-3f) && test::near(fresh.joints[2], -2.0f, 1e-3f));
+    c.loop = true;
+
+    // Blending: the ends are the poses, the rotations take the short way
+    pose a, b;
+    animation::sample(c, 0.3f, a, cursors);
+    animation::sample(c, 1.1f, b, cursors);
+    pose flipped = b;
+    for (int j = 0; j < 3; j++)
+        for (int x = 4; x < 8; x++)
+            flipped.joints[j * 12 + x] *= -1.0f;
+
+    pose blended;
+    bool ends = true;
+    animation::blend(a, flipped, 0.0f, blended);
+    for (size_t x = 0; x < a.joints.size(); x++)
+        ends = ends && test::near(blended.joints[x], a.joints[x]);
+    animation::blend(a, flipped, 1.0f, blended);
+    for (size_t x = 0; x < b.joints.size(); x++)
+        ends = ends && test::near(fabsf(blended.joints[x]), fabsf(b.joints[x]));
+    CHECK(ends);
+
+    animation::blend(a, flipped, 0.5f, blended);
+    pose half;
+    animation::blend(a, b, 0.5f, half);
+    bool shortway = true;
+    for (size_t x = 0; x < half.joints.size(); x++)
+        shortway = shortway && test::near(blended.joints[x], half.joints[x]);
+    CHECK(shortway);
+
+    // The rest pose skins to the mesh
+    pose rest;
+    animation::rest(rig, rest);
+    std::vector<mat4> joints, palette;
+    animation::palette(rig, rest, joints, palette);
+
+    bool identity = palette.size() == 3;
+    for (size_t i = 0; i < palette.size(); i++)
+        for (int x = 0; x < 4; x++)
+            for (int y = 0; y < 4; y++)
+                identity = identity && test::near(palette[i].m[x][y], x == y ? 1.0f : 0.0f);
+    CHECK(identity);
+
+    // The palette of an animated pose against scalar matrices
+    animation::sample(c, 0.77f, p, cursors);
+    animation::palette(rig, p, joints, palette);
+
+    bool matches = true;
+    std::vector<mat4> reference(3);
+    for (int i = 0; i < 3; i++)
+    {
+        const float *t = &p.joints[i * 12];
+        mat4 scale = matrix::identity();
+        scale.m[0][0] = t[8];
+        scale.m[1][1] = t[9];
+        scale.m[2][2] = t[10];
+
+        mat4 local = scale * matrix::rotate((quat){t[4], t[5], t[6], t[7]});
+        local.m[3][0] = t[0];
+        local.m[3][1] = t[1];
+        local.m[3][2] = t[2];
+
+        reference[i] = rig.joints[i].parent >= 0 ? local * reference[rig.joints[i].parent] : local;
+        mat4 skinning = rig.joints[i].inverse_bind * reference[i];
+
+        for (int x = 0; x < 4; x++)
+            for (int y = 0; y < 4; y++)
+                matches = matches && test::near(palette[i].m[x][y], skinning.m[x][y], 1e-4f);
+    }
+    CHECK(matches);
+
+    // Skinning against the weighted matrices (2 triangles, a vertex without influences stays put)
+    mesh m;
+    m.tris = 2;
+    for (int v = 0; v < 6; v++)
+    {
+        vec3 pos = {r.range(-1.0f, 1.0f), r.range(0.0f, 2.0f), r.range(-1.0f, 1.0f)};
+        vec3 nor = vector::normalize((vec3){r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f), r.range(0.5f, 1.0f), 0.0f});
+        m.vertices.insert(m.vertices.end(), {pos.x, pos.y, pos.z});
+        m.normals.insert(m.normals.end(), {nor.x, nor.y, nor.z});
+
+        float w = v == 5 ? 0.0f : r.range(0.2f, 0.8f);
+        rig.influences.insert(rig.influences.end(), {(unsigned char)(v % 3), (unsigned char)((v + 1) % 3), 0, 0});
+        rig.weights.insert(rig.weights.end(), {w, v == 5 ? 0.0f : 1.0f - w, 0.0f, 0.0f});
+    }
+
+    std::vector<float> skinned(6 * 8, 0.0f);
+    vec3 min, max;
+    animation::skin(rig, palette, m, skinned.data(), min, max);
+
+    bool skins = true;
+    for (int v = 0; v < 6; v++)
+    {
+        mat4 s;
+        for (int i = 0; i < 2; i++)
+        {
+            float w = rig.weights[v * 4 + i];
+            const mat4 &j = palette[rig.influences[v * 4 + i]];
+            for (int x = 0; x < 4; x++)
+                for (int y = 0; y < 4; y++)
+                    s.m[x][y] += w * j.m[x][y];
+        }
+        if (v == 5)
+            s = matrix::identity();
+
+        vec3 pos = matrix::multiplyvec(s, {m.vertices[v * 3], m.vertices[v * 3 + 1], m.vertices[v * 3 + 2]});
+        vec3 nor = vector::normalize(matrix::multiplyvec(s, {m.normals[v * 3], m.normals[v * 3 + 1], m.normals[v * 3 + 2], 0.0f}));
+
+        const float *o = &skinned[v * 8];
+        skins = skins && test::near(o[0], pos.x) && test::near(o[1], pos.y) && test::near(o[2], pos.z);
+        skins = skins && test::near(o[5], nor.x, 1e-3f) && test::near(o[6], nor.y, 1e-3f) && test::near(o[7], nor.z, 1e-3f);
+        skins = skins && pos.x >= min.x - 1e-5f && pos.y >= min.y - 1e-5f && pos.z <= max.z + 1e-5f;
+    }
+    CHECK(skins);
+    CHECK(test::near(skinned[5 * 8], m.vertices[15]) && test::near(skinned[5 * 8 + 1], m.vertices[16]));
+}
@@ -0,0 +1,84 @@
+// Cascaded Shadow Map Tests
+#pragma once
+
+#include <math.h>
+
+#include <engine/cascades.h>
+
+#include "test.h"
+
+/**
+ * @brief The practical split scheme, the slice's bounding sphere fit & the texel snap
+ */
+void test_cascades()
+{
+    // Splits: the ends are the view's range, lambda blends uniform (0) & logarithmic (1) splits
+    float s[CASCADE_COUNT + 1];
+
+    cascades::splits(1.0f, 100.0f, 4, 0.0f, s);
+    CHECK(test::near(s[0], 1.0f) && test::near(s[4], 100.0f));
+    CHECK(test::near(s[1] - s[0], s[2] - s[1]) && test::near(s[2] - s[1], s[4] - s[3]));
+
+    cascades::splits(1.0f, 10000.0f, 4, 1.0f, s);
+    CHECK(test::near(s[1], 10.0f, 1e-2f) && test::near(s[2], 100.0f, 1e-1f) && test::near(s[3], 1000.0f, 1.0f));
+
+    cascades::splits(0.1f, 200.0f, 4, 0.75f, s);
+    bool ascending = test::near(s[0], 0.1f) && test::near(s[4], 200.0f, 1e-3f);
+    for (int i = 0; i < 4; i++)
+        ascending = ascending && s[i] < s[i + 1];
+    CHECK(ascending);
+    CHECK(s[1] < 0.1f + (200.0f - 0.1f) / 4.0f); // closer slices are thinner than uniform ones
+
+    // Fit: the slice is inside the map & the map's size doesn't change while the camera turns
+    mat4 projection = matrix::perspective(60.0f, 16.0f / 9.0f, 0.1f, 200.0f);
+    vec3 direction = {0.3f, -1.0f, 0.2f};
+    const uint resolution = 1024;
+
+    float radius = -1.0f;
+    bool constant = true, inside = true, snapped = true;
+    for (int turn = 0; turn < 16; turn++)
+    {
+        float yaw = turn * 0.4f, pitch = sinf(turn * 0.7f) * 0.5f;
+        vec3 eye = {turn * 3.7f - 20.0f, 5.0f + turn * 0.31f, turn * -1.3f};
+        vec3 at = eye + (vec3){cosf(pitch) * sinf(yaw), sinf(pitch), -cosf(pitch) * cosf(yaw)};
+        mat4 view = matrix::lookAt(eye, at, {0.0f, 1.0f, 0.0f});
+
+        vec3 corners[8];
+        cascades::corners(view, projection, 10.0f, 40.0f, corners);
+        cascade c = cascades::fit(corners, direction, resolution, 50.0f);
+
+        if (radius < 0.0f)
+            radius = c.radius;
+        constant = constant && c.radius == radius;
+
+        for (int i = 0; i < 8; i++)
+        {
+            vec3 p = matrix::multiplyvec(c.matrix, corners[i]);
+            inside = inside && fabsf(p.x) <= 1.0f && fabsf(p.y) <= 1.0f && p.z >= -1.0f && p.z <= 1.0f;
+            inside = inside && culling::sphere(c.bounds, corners[i], 0.0f);
+        }
+
+        // Snap: the world's origin lands on a texel's corner
+        vec3 origin = matrix::multiplyvec(c.matrix, {0.0f, 0.0f, 0.0f});
+        float x = origin.x * resolution / 2.0f, y = origin.y * resolution / 2.0f;
+        snapped = snapped && fabsf(x - roundf(x)) < 1e-2f && fabsf(y - roundf(y)) < 1e-2f;
+    }
+    CHECK(radius > 0.0f && constant);
+    CHECK(inside);
+    CHECK(snapped);
+
+    // The sphere holds the slice's far corners (the widest part)
+    vec3 corners[8];
+    cascades::corners(matrix::lookAt({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}), projection, 10.0f, 40.0f, corners);
+    cascade c = cascades::fit(corners, direction, resolution, 50.0f);
+    bool bounded = true;
+    for (int i = 0; i < 8; i++)
+        bounded = bounded && vector::distance(c.center, corners[i]) <= c.radius;
+    CHECK(bounded);
+    CHECK(test::near(corners[4].z, -40.0f) && test::near(corners[0].z, -10.0f));
+
+    // A snapped matrix stays put when snapped again
+    mat4 m = c.matrix;
+    cascades::snap(m, resolution);
+    CHECK(test::near(m.m[3][0], c.matrix.m[3][0], 1e-5f) && test::near(m.m[3][1], c.matrix.m[3][1], 1e-5f));
+}
@@ -0,0 +1,179 @@
+// Clustered Light Assignment Tests
+#pragma once
+
+#include <vector>
+#include <math.h>
+
+#include <engine/clusters.h>
+
+#include "test.h"
+
+/**
+ * @brief Are two assignments the same?
+ *
+ * @param a The first assignment
+ * @param b The second assignment
+ * @return do they have the same lights in the same clusters (in the same order)?
+ */
+bool __test_same(const clusterlist &a, const clusterlist &b)
+{
+    return a.grid == b.grid && a.indices == b.indices;
+}
+
+/**
+ * @brief The assignment against a brute force test of every cluster, the threaded assignment, the slices & the lights' range
+ */
+void test_clusters()
+{
+    test::random r;
+
+    // A 60 degree, 16:9 view
+    clustergrid g;
+    g.near = 0.1f;
+    g.far = 200.0f;
+    g.scale_x = 1.0f / tanf(30.0f * M_PI / 180.0f) / (16.0f / 9.0f);
+    g.scale_y = 1.0f / tanf(30.0f * M_PI / 180.0f);
+
+    // Lights in & around the view (some behind the camera, some past the far plane, some huge)
+    std::vector<clusterlight> lights(300);
+    for (auto &l : lights)
+    {
+        l.position = {r.range(-60.0f, 60.0f), r.range(-35.0f, 35.0f), r.range(-220.0f, 10.0f)};
+        l.radius = r.next() % 10 == 0 ? r.range(20.0f, 80.0f) : r.range(0.1f, 6.0f);
+    }
+
+    // Against every cluster's box: the assigned lights touch it (the tiles the lights project to are tighter than the boxes,
+    // so some touching lights are left out) & are in ascending order
+    clusterlist out = clusters::assign(g, lights);
+    uint clusters = g.x * g.y * g.z;
+    bool layout = out.grid.size() == clusters * 2, touching = layout;
+    size_t brute = 0;
+
+    for (uint k = 0; k < g.z && touching; k++)
+    {
+        for (uint j = 0; j < g.y && touching; j++)
+        {
+            for (uint i = 0; i < g.x && touching; i++)
+            {
+                vec3 min, max;
+                clusters::bounds(g, i, j, k, min, max);
+
+                for (uint l = 0; l < lights.size(); l++)
+                    brute += clusters::touches(lights[l].position, lights[l].radius, min, max);
+
+                uint c = (k * g.y + j) * g.x + i;
+                uint offset = out.grid[c * 2], count = out.grid[c * 2 + 1];
+                touching = offset + count <= out.indices.size();
+                for (uint x = offset; x < offset + count && touching; x++)
+                {
+                    const clusterlight &l = lights[out.indices[x]];
+                    touching = clusters::touches(l.position, l.radius, min, max) && (x == offset || out.indices[x - 1] < out.indices[x]);
+                }
+            }
+        }
+    }
+    CHECK(layout);
+    CHECK(touching);
+    CHECK(!out.indices.empty() && out.indices.size() <= brute);
+
+    // ... & every cluster a light reaches has it (points in the lights' spheres, away from the clusters' edges)
+    bool reached = layout;
+    for (uint l = 0; l < lights.size() && reached; l++)
+    {
+        for (int p = 0; p < 200 && reached; p++)
+        {
+            vec3 o = {r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f)};
+            if (o.x * o.x + o.y * o.y + o.z * o.z > 1.0f)
+                continue;
+
+            vec3 q = lights[l].position + o * lights[l].radius;
+            float depth = -q.z, x = (q.x * g.scale_x / depth + 1.0f) / 2.0f * g.x, y = (q.y * g.scale_y / depth + 1.0f) / 2.0f * g.y;
+            float s = logf(depth / g.near) / logf(g.far / g.near) * g.z;
+            if (depth <= g.near || depth >= g.far || x <= 0.0f || x >= g.x || y <= 0.0f || y >= g.y)
+                continue;
+            if (fabsf(x - roundf(x)) < 1e-3f || fabsf(y - roundf(y)) < 1e-3f || fabsf(s - roundf(s)) < 1e-3f)
+                continue;
+
+            uint c = (clusters::slice(g, depth) * g.y + (uint)y) * g.x + (uint)x;
+            auto first = out.indices.begin() + out.grid[c * 2], last = first + out.grid[c * 2 + 1];
+            reached = std::find(first, last, l) != last;
+        }
+    }
+    CHECK(reached);
+
+    // The clusters follow each other
+    bool packed = layout;
+    for (uint c = 1; c < clusters && packed; c++)
+        packed = out.grid[c * 2] == out.grid[c * 2 - 2] + out.grid[c * 2 - 1];
+    CHECK(packed && out.grid[clusters * 2 - 2] + out.grid[clusters * 2 - 1] == out.indices.size());
+
+    // The same with threads (the merge doesn't depend on the number of threads)
+    Workers pool;
+    CHECK(__test_same(clusters::assign(g, lights, &pool), out)); // (without setup(), the calling thread)
+
+    pool.setup(3);
+    bool threaded = true;
+    for (int i = 0; i < 20 && threaded; i++)
+        threaded = __test_same(clusters::assign(g, lights, &pool), out);
+    CHECK(threaded);
+
+    // More threads than slices
+    clustergrid thin = g;
+    thin.z = 2;
+    CHECK(__test_same(clusters::assign(thin, lights, &pool), clusters::assign(thin, lights)));
+
+    // Global lights are in every cluster (wherever they are)
+    std::vector<clusterlight> global(3);
+    global[1].global = true;
+    global[1].position = {0.0f, 0.0f, 1000.0f};
+    global[0].position = {0.0f, 0.0f, -1000.0f};
+    global[2].position = {0.0f, 0.0f, -1000.0f};
+
+    clusterlist sun = clusters::assign(g, global, &pool);
+    bool everywhere = sun.indices.size() == clusters;
+    for (uint c = 0; c < clusters && everywhere; c++)
+        everywhere = sun.grid[c * 2 + 1] == 1 && sun.indices[sun.grid[c * 2]] == 1;
+    CHECK(everywhere);
+    pool.stop();
+
+    // Slices: the ranges follow each other from near to far & a depth is in it's slice's range
+    bool ranges = true;
+    float previous = g.near;
+    for (uint k = 0; k < g.z; k++)
+    {
+        float zn, zf;
+        clusters::range(g, k, zn, zf);
+        ranges = ranges && test::near(zn, previous, previous * 1e-4f) && zf > zn;
+        previous = zf;
+    }
+    CHECK(ranges && test::near(previous, g.far, g.far * 1e-4f));
+
+    bool slices = true;
+    for (int i = 0; i < 1000; i++)
+    {
+        float depth = g.near * powf(g.far / g.near, r.range(0.0f, 1.0f));
+        uint k = clusters::slice(g, depth);
+
+        float zn, zf;
+        clusters::range(g, k, zn, zf);
+        slices = slices && k < g.z && depth >= zn * (1.0f - 1e-4f) && depth <= zf * (1.0f + 1e-4f);
+    }
+    CHECK(slices);
+    CHECK(clusters::slice(g, 0.0f) == 0 && clusters::slice(g, g.far * 2.0f) == g.z - 1);
+
+    // Range: the attenuation at the radius is the threshold
+    bool inverts = true;
+    for (int i = 0; i < 200; i++)
+    {
+        float c = r.range(0.5f, 1.0f), l = r.range(0.0f, 0.5f), q = i % 2 ? r.range(0.001f, 0.1f) : 0.0f, b = r.range(0.5f, 20.0f);
+        if (q == 0.0f && l == 0.0f)
+            l = 0.1f;
+
+        float d = clusters::radius(c, l, q, b);
+        inverts = inverts && d > 0.0f && test::near(b / (c + l * d + q * d * d), 1.0f / 256.0f, 1e-6f);
+    }
+    CHECK(inverts);
+    CHECK(test::near(clusters::radius(1.0f, 0.5f, 0.0f, 1.0f, 0.1f), 18.0f));
+    CHECK(clusters::radius(1.0f, 0.0f, 0.0f, 1.0f) < 0.0f);      // no falloff
+    CHECK(clusters::radius(1.0f, 0.1f, 0.01f, 0.001f) == 0.0f); // never brighter than the threshold
+}
@@ -0,0 +1,84 @@
+// Frustum Culling Tests
+#pragma once
+
+#include <vector>
+
+#include <engine/culling.h>
+
+#include "test.h"
+
+/**
+ * @brief The frustum planes, the box & sphere tests & the SIMD culler against the scalar box test
+ */
+void test_culling()
+{
+    test::random r;
+
+    // A camera at (0, 0, 10) looking at the origin (90 degrees, near 1, far 100)
+    mat4 vp = matrix::lookAt({0.0f, 0.0f, 10.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}) * matrix::perspective(90.0f, 1.0f, 1.0f, 100.0f);
+    frustum f = culling::extract(vp);
+
+    // The planes are normalized
+    bool normalized = true;
+    for (int i = 0; i < 6; i++)
+        normalized = normalized && test::near(f.planes[i][0] * f.planes[i][0] + f.planes[i][1] * f.planes[i][1] + f.planes[i][2] * f.planes[i][2], 1.0f);
+    CHECK(normalized);
+
+    // Spheres
+    CHECK(culling::sphere(f, {0.0f, 0.0f, 0.0f}, 0.5f));
+    CHECK(!culling::sphere(f, {0.0f, 0.0f, 20.0f}, 0.5f));  // behind the camera
+    CHECK(!culling::sphere(f, {0.0f, 0.0f, -95.0f}, 0.5f)); // past the far plane
+    CHECK(culling::sphere(f, {0.0f, 0.0f, 9.5f}, 1.0f));    // crosses the near plane (from behind)
+    CHECK(!culling::sphere(f, {30.0f, 0.0f, 0.0f}, 1.0f));  // right of the view (10 units away the view is 20 wide)
+    CHECK(culling::sphere(f, {10.5f, 0.0f, 0.0f}, 1.0f));   // touches the right plane
+
+    // Boxes
+    CHECK(culling::aabb(f, {-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}) == 1);
+    CHECK(culling::aabb(f, {9.0f, -1.0f, -1.0f}, {11.0f, 1.0f, 1.0f}) == 0);
+    CHECK(culling::aabb(f, {20.0f, -1.0f, -1.0f}, {22.0f, 1.0f, 1.0f}) == -1);
+    CHECK(culling::aabb(f, {-1.0f, -1.0f, 12.0f}, {1.0f, 1.0f, 14.0f}) == -1);
+    CHECK(culling::aabb(f, {-1000.0f, -1000.0f, -1000.0f}, {1000.0f, 1000.0f, 1000.0f}) == 0);
+
+    // The culler matches the scalar test, for scattered boxes & for clustered ones (whole blocks in or out)
+    for (int clustered = 0; clustered < 2; clustered++)
+    {
+        size_t n = 1000 + CULL_BLOCK / 2 + 3; // not a multiple of the block or the SIMD width
+        std::vector<vec3> mins(n), maxs(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            vec3 c;
+            if (clustered)
+            {
+                float x = (i / CULL_BLOCK) % 2 == 0 ? 0.0f : 300.0f; // every other block is far to the right
+                c = {x + r.range(-2.0f, 2.0f), r.range(-2.0f, 2.0f), r.range(-2.0f, 2.0f)};
+            }
+            else
+                c = {r.range(-60.0f, 60.0f), r.range(-60.0f, 60.0f), r.range(-120.0f, 20.0f)};
+
+            vec3 e = {r.range(0.1f, 3.0f), r.range(0.1f, 3.0f), r.range(0.1f, 3.0f)};
+            mins[i] = c - e;
+            maxs[i] = c + e;
+        }
+
+        Culler culler;
+        culler.resize(n);
+        for (size_t i = 0; i < n; i++)
+            culler.set(i, mins[i], maxs[i]);
+
+        std::vector<unsigned char> out;
+        culler.cull(f, out);
+
+        bool same = out.size() == n;
+        uint visible = 0;
+        for (size_t i = 0; same && i < n; i++)
+        {
+            same = out[i] == (culling::aabb(f, mins[i], maxs[i]) >= 0);
+            visible += out[i];
+        }
+        CHECK(same);
+        CHECK(culler.visible == visible && culler.visible + culler.culled == n);
+        CHECK(visible > 0 && visible < n);
+        if (clustered)
+            CHECK(culler.blocks_skipped > 0);
+    }
+}
@@ -0,0 +1,97 @@
+// Occlusion Culling Tests
+#pragma once
+
+#include <vector>
+
+#include <engine/occlusion.h>
+
+#include "test.h"
+
+/**
+ * @brief A screen-space quad (x, y in the occlusion buffer's pixels) at a depth, as two triangles
+ */
+std::vector<float> __test_quad(float x0, float y0, float x1, float y1, float z)
+{
+    return {x0, y0, z, x1, y0, z, x1, y1, z,
+            x0, y0, z, x1, y1, z, x0, y1, z};
+}
+
+/**
+ * @brief Hiding boxes behind occluders, the conservative coverage & the near plane
+ */
+void test_occlusion()
+{
+    // World x, y are the buffer's pixels, depths from -1 (near) to -101 (far), so a box's depth is (-z - 1) / 100
+    mat4 vp = matrix::ortho(0.0f, OCCLUSION_WIDTH, 0.0f, OCCLUSION_HEIGHT, 1.0f, 101.0f);
+    mat4 model = matrix::identity();
+
+    Occlusion o;
+
+    // A wall in the middle hides the boxes behind it, but not the ones in front of it or beside it
+    o.begin(vp);
+    o.rasterize(__test_quad(64.0f, 32.0f, 192.0f, 96.0f, -50.0f), model);
+    o.finish();
+
+    CHECK(o.occluders == 1);
+    CHECK(test::near(o.at(128, 64), 0.49f));
+    CHECK(o.at(10, 10) == 1.0f);
+
+    CHECK(!o.visible({100.0f, 50.0f, -80.0f}, {120.0f, 70.0f, -60.0f}));  // behind
+    CHECK(o.visible({100.0f, 50.0f, -40.0f}, {120.0f, 70.0f, -20.0f}));   // in front
+    CHECK(o.visible({100.0f, 50.0f, -60.0f}, {120.0f, 70.0f, -40.0f}));   // through it
+    CHECK(o.visible({10.0f, 10.0f, -80.0f}, {20.0f, 20.0f, -60.0f}));     // beside it
+    CHECK(o.visible({190.0f, 50.0f, -80.0f}, {200.0f, 70.0f, -60.0f}));   // sticks out
+    CHECK(o.visible({-50.0f, 50.0f, -80.0f}, {-40.0f, 70.0f, -60.0f}));   // off-screen
+    CHECK(o.tested == 6 && o.occluded == 1);
+
+    // test() is visible() without the counters
+    CHECK(!o.test({100.0f, 50.0f, -80.0f}, {120.0f, 70.0f, -60.0f}));
+    CHECK(o.tested == 6);
+
+    // The pixels at the wall's sides are sampled, but not covered by their neighbours
+    CHECK(o.at(64, 64) == 1.0f && o.at(65, 64) < 1.0f && o.at(190, 64) < 1.0f && o.at(191, 64) == 1.0f);
+
+    // A sliver covers 2 pixel centers, but no whole pixel, so it hides nothing
+    o.begin(vp);
+    o.rasterize(__test_quad(10.4f, 32.0f, 11.6f, 96.0f, -10.0f), model);
+    o.finish();
+
+    CHECK(o.at(10, 64) == 1.0f && o.at(11, 64) == 1.0f);
+    CHECK(o.visible({10.45f, 50.0f, -80.0f}, {11.55f, 70.0f, -60.0f}));
+
+    // A wider one covers the pixels with covered neighbours
+    o.begin(vp);
+    o.rasterize(__test_quad(8.9f, 32.0f, 13.1f, 96.0f, -10.0f), model);
+    o.finish();
+
+    CHECK(o.at(9, 64) == 1.0f && o.at(10, 64) < 1.0f && o.at(11, 64) < 1.0f && o.at(12, 64) == 1.0f);
+
+    // A tilted occluder covers the pixels with (at least) it's farthest depth over them
+    o.begin(vp);
+    o.rasterize({64.0f, 32.0f, -10.0f, 192.0f, 32.0f, -74.0f, 192.0f, 96.0f, -74.0f,
+                 64.0f, 32.0f, -10.0f, 192.0f, 96.0f, -74.0f, 64.0f, 96.0f, -10.0f},
+                model);
+    o.finish();
+
+    // z = -10 - (x - 64) / 2, so the depth grows along x: at the pixel's right side & at the right neighbour's center
+    float side = (0.5f * (129.0f - 64.0f) + 9.0f) / 100.0f;
+    float neighbour = (0.5f * (129.5f - 64.0f) + 9.0f) / 100.0f;
+    CHECK(o.at(128, 64) >= side && test::near(o.at(128, 64), neighbour));
+
+    // Occluders covering the screen cover it's edges
+    o.begin(vp);
+    o.rasterize(__test_quad(-10.0f, -10.0f, OCCLUSION_WIDTH + 10.0f, OCCLUSION_HEIGHT + 10.0f, -50.0f), model);
+    o.finish();
+
+    CHECK(o.at(0, 0) < 1.0f && o.at(OCCLUSION_WIDTH - 1, OCCLUSION_HEIGHT - 1) < 1.0f);
+    CHECK(!o.visible({-5.0f, -5.0f, -80.0f}, {3.0f, 3.0f, -60.0f}));
+
+    // Occluders crossing the near plane are skipped
+    mat4 persp = matrix::perspective(90.0f, 2.0f, 1.0f, 100.0f);
+    o.begin(persp);
+    o.rasterize({-50.0f, -50.0f, 5.0f, 50.0f, -50.0f, -20.0f, 0.0f, 50.0f, -20.0f}, model);
+    o.finish();
+
+    CHECK(o.at(OCCLUSION_WIDTH / 2, OCCLUSION_HEIGHT / 2) == 1.0f);
+    CHECK(o.visible({-1.0f, -1.0f, -60.0f}, {1.0f, 1.0f, -50.0f}));
+}
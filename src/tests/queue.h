@@ -0,0 +1,101 @@
+// Render Queue Tests
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <engine/queue.h>
+
+#include "test.h"
+
+/**
+ * @brief The radix sort against std::stable_sort & the sort keys' order
+ */
+void test_queue()
+{
+    test::random r;
+
+    // Sorted like a stable sort (random keys, few distinct keys & every byte used)
+    for (size_t n : {0, 1, 2, 7, 256, 5000})
+        for (int kind = 0; kind < 3; kind++)
+        {
+            RenderQueue q;
+            std::vector<drawitem> expected;
+            for (size_t i = 0; i < n; i++)
+            {
+                uint64_t key = r.next64();
+                if (kind == 1)
+                    key &= 0x0300000000000003ull;
+                else if (kind == 2)
+                    key = 0x0123456789ABCDEFull;
+
+                q.submit(key, (uint)i);
+                expected.push_back({key, (uint)i});
+            }
+
+            q.sort();
+            std::stable_sort(expected.begin(), expected.end(), [](const drawitem &a, const drawitem &b)
+                             { return a.key < b.key; });
+
+            bool same = q.size() == expected.size();
+            for (size_t i = 0; same && i < n; i++)
+                same = q[i].key == expected[i].key && q[i].index == expected[i].index;
+            CHECK(same);
+        }
+
+    // Sorting again keeps the order (the queue is reused every frame)
+    {
+        RenderQueue q;
+        for (uint i = 0; i < 1000; i++)
+            q.submit(r.next64() & 0xFFFF, i);
+        q.sort();
+        std::vector<uint> first;
+        for (size_t i = 0; i < q.size(); i++)
+            first.push_back(q[i].index);
+
+        q.sort();
+        bool same = true;
+        for (size_t i = 0; i < q.size(); i++)
+            same = same && q[i].index == first[i];
+        CHECK(same);
+
+        q.clear();
+        CHECK(q.size() == 0);
+    }
+
+    // Appended lists keep their order
+    {
+        drawlist a, b;
+        a.items = {{5, 0}, {5, 1}};
+        b.items = {{5, 2}, {1, 3}};
+
+        RenderQueue q;
+        q.append(a);
+        q.append(b);
+        q.sort();
+        CHECK(q.size() == 4);
+        CHECK(q[0].index == 3 && q[1].index == 0 && q[2].index == 1 && q[3].index == 2);
+    }
+
+    // The passes are in drawing order
+    uint64_t opaque = renderkey::opaque(0x3FF, 0x3FF, 0x3FFF, 0xFFF, 1.0f);
+    uint64_t transparent = renderkey::transparent(0, 0, 0, 1.0f);
+    CHECK(opaque < transparent);
+    CHECK(transparent < ((uint64_t)PASS_OVERLAY << 62));
+    CHECK(renderkey::pass(opaque) == PASS_OPAQUE);
+    CHECK(renderkey::pass(transparent) == PASS_TRANSPARENT);
+
+    // Opaque draws are grouped by state, then front-to-back
+    CHECK(renderkey::opaque(1, 1, 1, 1, 0.2f) < renderkey::opaque(1, 1, 1, 1, 0.8f));
+    CHECK(renderkey::opaque(1, 1, 1, 1, 0.9f) < renderkey::opaque(2, 0, 0, 0, 0.1f));
+    CHECK(renderkey::opaque(1, 1, 1, 1, 0.9f) < renderkey::opaque(1, 2, 0, 0, 0.1f));
+
+    // Transparent draws are back-to-front
+    CHECK(renderkey::transparent(9, 9, 9, 0.8f) < renderkey::transparent(0, 0, 0, 0.2f));
+
+    // Depths are clamped (& NaN is the nearest)
+    CHECK(renderkey::quantize(-1.0f, 16) == 0);
+    CHECK(renderkey::quantize(NAN, 16) == 0);
+    CHECK(renderkey::quantize(2.0f, 16) == 0xFFFF);
+    CHECK(renderkey::quantize(0.5f, 16) == 0x7FFF);
+}
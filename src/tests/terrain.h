@@ -0,0 +1,118 @@
+// Heightfield Tests
+#pragma once
+
+#include <map>
+#include <string>
+#include <math.h>
+
+#include <engine/terrain.h>
+#include <engine/physics.h>
+
+#include "test.h"
+
+/**
+ * @brief Make a heightfield from a function of the world-space position
+ *
+ * @param width The samples along x
+ * @param depth The samples along z
+ * @param f The height at (x, z)
+ * @return The heightfield (10 x 20 units from (-5, 0, 0))
+ */
+template <typename F>
+heightfield __test_heightfield(int width, int depth, F f)
+{
+    heightfield h;
+    h.width = width;
+    h.depth = depth;
+    h.position = {-5.0f, 0.0f, 0.0f};
+    h.size = {10.0f, 1.0f, 20.0f};
+
+    for (int j = 0; j < depth; j++)
+        for (int i = 0; i < width; i++)
+            h.heights.push_back(f(h.position.x + h.size.x * i / (width - 1), h.position.z + h.size.z * j / (depth - 1)));
+    return h;
+}
+
+/**
+ * @brief The heightfield's heights (at & between the samples, on the terrain's triangles), normals & ground queries
+ */
+void test_terrain()
+{
+    test::random r;
+
+    // The samples are hit exactly, a plane is interpolated exactly everywhere
+    heightfield plane = __test_heightfield(9, 17, [](float x, float z)
+                                           { return 2.0f + 0.5f * x - 0.25f * z; });
+
+    bool samples = true;
+    for (int j = 0; j < plane.depth; j++)
+        for (int i = 0; i < plane.width; i++)
+            samples = samples && plane.height(-5.0f + 10.0f * i / 8, 20.0f * j / 16) == plane.sample(i, j);
+    CHECK(samples);
+
+    bool exact = true, normals = true;
+    vec3 n = vector::normalize({-0.5f, 1.0f, 0.25f});
+    for (int i = 0; i < 500; i++)
+    {
+        float x = r.range(-5.0f, 5.0f), z = r.range(0.0f, 20.0f);
+        exact = exact && test::near(plane.height(x, z), 2.0f + 0.5f * x - 0.25f * z);
+
+        vec3 m = plane.normal(fminf(fmaxf(x, -3.0f), 3.0f), fminf(fmaxf(z, 2.0f), 18.0f)); // (away from the clamped edges)
+        normals = normals && test::near(m.x, n.x) && test::near(m.y, n.y) && test::near(m.z, n.z);
+    }
+    CHECK(exact);
+    CHECK(normals);
+
+    // The quads are split from (i + 1, j) to (i, j + 1): with only (i + 1, j + 1) raised, the first triangle stays flat
+    heightfield corner = __test_heightfield(2, 2, [](float x, float z)
+                                            { return x > 0.0f && z > 0.0f ? 1.0f : 0.0f; });
+    CHECK(corner.height(-5.0f + 10.0f * 0.3f, 20.0f * 0.6f) == 0.0f);
+    CHECK(test::near(corner.height(-5.0f + 10.0f * 0.7f, 20.0f * 0.6f), 0.3f));
+    CHECK(test::near(corner.height(-5.0f + 10.0f * 0.5f, 20.0f * 0.5f), 0.0f));
+
+    // Outside the edges are extended, the samples are clamped
+    heightfield bumps = __test_heightfield(33, 33, [](float x, float z)
+                                           { return sinf(x) * cosf(z * 0.5f); });
+    CHECK(bumps.inside(0.0f, 10.0f) && bumps.inside(-5.0f, 20.0f));
+    CHECK(!bumps.inside(-5.5f, 10.0f) && !bumps.inside(0.0f, 20.5f));
+    CHECK(bumps.height(-50.0f, -50.0f) == bumps.sample(0, 0) && bumps.height(50.0f, 50.0f) == bumps.sample(32, 32));
+    CHECK(bumps.height(-50.0f, 10.0f) == bumps.height(-5.0f, 10.0f));
+    CHECK(bumps.sample(-3, 40) == bumps.sample(0, 32));
+
+    // Between the samples the height stays between the quad's corners
+    bool bounded = true;
+    for (int i = 0; i < 500; i++)
+    {
+        float x = r.range(-5.0f, 5.0f), z = r.range(0.0f, 20.0f);
+        int si = std::min((int)((x + 5.0f) / 10.0f * 32), 31), sj = std::min((int)(z / 20.0f * 32), 31);
+        float lo = fminf(fminf(bumps.sample(si, sj), bumps.sample(si + 1, sj)), fminf(bumps.sample(si, sj + 1), bumps.sample(si + 1, sj + 1)));
+        float hi = fmaxf(fmaxf(bumps.sample(si, sj), bumps.sample(si + 1, sj)), fmaxf(bumps.sample(si, sj + 1), bumps.sample(si + 1, sj + 1)));
+        float h = bumps.height(x, z);
+        bounded = bounded && h >= lo - 1e-5f && h <= hi + 1e-5f;
+    }
+    CHECK(bounded);
+
+    // Ground queries
+    float d = 0.0f;
+    float ground = bumps.height(1.0f, 3.0f);
+    CHECK(bumps.below({1.0f, ground - 0.5f, 3.0f}, &d) && test::near(d, 0.5f));
+    CHECK(!bumps.below({1.0f, ground + 0.25f, 3.0f}, &d) && test::near(d, -0.25f));
+
+    // Without a grid the ground is flat
+    heightfield empty;
+    empty.position = {0.0f, 3.0f, 0.0f};
+    CHECK(empty.height(1.0f, 1.0f) == 3.0f && empty.below({1.0f, 2.0f, 1.0f}));
+
+    // The physics' ground test (any vertex of the collider under the ground)
+    std::map<std::string, object> objs;
+    Physics physics;
+    physics.init(&objs, false);
+
+    object &o = objs["box"];
+    o.c.vertices = {0.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f};
+    o.position = {1.0f, ground - 0.1f, 3.0f};
+    CHECK(physics.collide("box", bumps));
+
+    o.position.y = ground + 10.0f;
+    CHECK(!physics.collide("box", bumps));
+}
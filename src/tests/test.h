@@ -0,0 +1,79 @@
+// Unit Test Helpers for the Game Engine
+#pragma once
+
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <tools/types.h>
+
+/**
+ * @brief Test counters & checks (see src/test.cpp)
+ */
+namespace test
+{
+    uint passed = 0; // checks that held
+    uint failed = 0; // checks that didn't
+
+    /**
+     * @brief Count a check (& print it if it failed)
+     *
+     * @param ok did it hold?
+     * @param what The checked expression
+     * @param file The check's file
+     * @param line The check's line
+     */
+    void check(bool ok, const char *what, const char *file, int line)
+    {
+        if (ok)
+        {
+            passed++;
+            return;
+        }
+
+        failed++;
+        printf("  FAILED %s:%d: %s\n", file, line, what);
+    }
+
+    /**
+     * @brief Are two floats equal (within a tolerance)?
+     *
+     * @param a The first float
+     * @param b The second float
+     * @param tolerance The largest difference
+     */
+    bool near(float a, float b, float tolerance = 1e-4f)
+    {
+        return fabsf(a - b) <= tolerance;
+    }
+
+    /**
+     * @brief A deterministic random number generator (xorshift32)
+     */
+    struct random
+    {
+        uint32_t state = 0x12345678;
+
+        uint32_t next()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        uint64_t next64()
+        {
+            return ((uint64_t)next() << 32) | next();
+        }
+
+        // Between min & max
+        float range(float min, float max)
+        {
+            return min + (max - min) * (float)(next() & 0xFFFFFF) / (float)0xFFFFFF;
+        }
+    };
+};
+
+// Check an expression (the test goes on if it fails)
+#define CHECK(x) test::check((x), #x, __FILE__, __LINE__)
@@ -0,0 +1,112 @@
+// Worker Thread Tests
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#include <engine/workers.h>
+
+#include "test.h"
+
+/**
+ * @brief Run a job & check that the ranges are contiguous, ascending by worker & cover every item once
+ *
+ * @param pool The pool
+ * @param n The number of items
+ * @param grain The smallest range
+ * @param used The number of ranges that were run
+ * @return The ranges were right
+ */
+bool __test_ranges(Workers &pool, size_t n, size_t grain, uint &used)
+{
+    std::vector<size_t> firsts(pool.size(), (size_t)-1), lasts(pool.size(), 0);
+    std::vector<std::atomic<int>> hits(n);
+    std::atomic<bool> valid(true);
+
+    pool.run(n, [&](size_t first, size_t last, uint worker)
+             {
+                 if (worker >= pool.size() || first > last || last > n)
+                 {
+                     valid = false;
+                     return;
+                 }
+                 firsts[worker] = first;
+                 lasts[worker] = last;
+                 for (size_t i = first; i < last; i++)
+                     hits[i]++; }, grain);
+
+    bool right = valid;
+    for (size_t i = 0; i < n; i++)
+        right = right && hits[i] == 1;
+
+    // The workers that ran follow each other (0 first) & the others didn't run
+    size_t next = 0;
+    used = 0;
+    for (uint w = 0; w < pool.size(); w++)
+    {
+        if (firsts[w] == (size_t)-1)
+            continue;
+        right = right && firsts[w] == next && w == used;
+        next = lasts[w];
+        used++;
+    }
+    return right && next == n;
+}
+
+/**
+ * @brief The pool's ranges, the grain & repeated runs (with threads & on the calling thread only)
+ */
+void test_workers()
+{
+    Workers pool;
+    uint used = 0;
+
+    // Without setup() everything runs on the calling thread
+    CHECK(pool.size() == 1);
+    CHECK(__test_ranges(pool, 1000, 1, used) && used == 1);
+
+    pool.setup(3);
+    CHECK(pool.size() == 4);
+
+    // Every thread gets a range, in order
+    CHECK(__test_ranges(pool, 1000, 1, used) && used == 4);
+    CHECK(__test_ranges(pool, 7, 1, used) && used == 4);
+    CHECK(__test_ranges(pool, 3, 1, used) && used == 3); // fewer items than threads
+
+    // The grain limits the ranges
+    CHECK(__test_ranges(pool, 1000, 400, used) && used == 3);
+    CHECK(__test_ranges(pool, 1000, WORKER_GRAIN, used) && used == 1);
+    CHECK(__test_ranges(pool, 0, 1, used) && used == 0);
+
+    // Repeated runs (the threads wake up for every one)
+    bool repeated = true;
+    for (int i = 0; i < 200 && repeated; i++)
+        repeated = __test_ranges(pool, 100 + i, 1, used) && used == 4;
+    CHECK(repeated);
+
+    // Per-worker outputs merged in worker order are the same as a serial loop
+    std::vector<std::vector<uint>> outputs(pool.size());
+    pool.run(10000, [&](size_t first, size_t last, uint worker)
+             {
+                 for (size_t i = first; i < last; i++)
+                     if (i % 7 == 3)
+                         outputs[worker].push_back((uint)i); }, 1);
+
+    std::vector<uint> merged;
+    for (auto &o : outputs)
+        merged.insert(merged.end(), o.begin(), o.end());
+
+    bool serial = merged.size() == 10000 / 7 + 1;
+    for (size_t i = 0; serial && i < merged.size(); i++)
+        serial = merged[i] == i * 7 + 3;
+    CHECK(serial);
+
+    // After stop() the calling thread does the work
+    pool.stop();
+    CHECK(pool.size() == 1);
+    CHECK(__test_ranges(pool, 1000, 1, used) && used == 1);
+
+    // & the pool can be started again
+    pool.setup(2);
+    CHECK(pool.size() == 3 && __test_ranges(pool, 1000, 1, used) && used == 3);
+}